@@ -0,0 +1,153 @@
+/****************************************************************
+ * block_assembly
+ *
+ * Checks and times the default residual_evaluation of PhysicsBase,
+ * which assembles the residual with the library's BlockAssembler,
+ * for a diffusion physics that only writes flux, boundary_flux,
+ * lhs and source, e.g.
+ *
+ *   mpirun -np 8 ./block_assembly ../meshing/meshes/cassion 200
+ *
+ * The residual is evaluated evaluations times (100 by default) by
+ *
+ *  block : PhysicsBase::residual_evaluation
+ *  loop  : a loop over the CV faces that adds the flux through
+ *          each to the control volumes on either side, as a physics
+ *          would write it by hand
+ *
+ * and the largest difference between the two, relative to the
+ * largest residual, is printed with the mean time per evaluation
+ * on the slowest domain.  The solution is set at every node of
+ * the domain, so no halo exchange is needed.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <fvm/physics_base.h>
+#include <mpi/mpicomm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef lin::DefaultCoordinator<double> Coord;
+
+// linear diffusion with a two point flux, a source that varies over the
+// domain and outflow through the boundary
+class Diffusion : public fvm::PhysicsBase<Diffusion, double, Coord> {
+public:
+    void init(double& t, const mesh::Mesh& m, TVecDevice& sol, TVecDevice& deriv) {
+        for (int i = 0; i < m.nodes(); ++i) {
+            const mesh::Point& p = m.node(i).point();
+            sol[i] = std::sin(p.x) + p.y*p.z;
+            deriv[i] = std::cos(p.y);
+        }
+    }
+
+    double source(double t, const mesh::Volume& volume, const TVecDevice& sol) {
+        return volume.centroid().x;
+    }
+
+    double flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) {
+        const mesh::Node& front = cvf.front();
+        const mesh::Node& back = cvf.back();
+        return -(sol[front.id()] - sol[back.id()]) / util::distance(front.point(), back.point());
+    }
+
+    double boundary_flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) {
+        return sol[cvf.back().id()];
+    }
+};
+
+// the residual of Diffusion, assembled by hand
+void loop_residual(double t, Diffusion& p, const mesh::Mesh& m,
+                   const Diffusion::TVecDevice& sol, const Diffusion::TVecDevice& deriv,
+                   Diffusion::TVecDevice& res) {
+    int N = m.local_nodes();
+    for (int i = 0; i < N; ++i)
+        res[i] = p.source(t, m.volume(i), sol) - p.lhs(t, m.volume(i), sol, deriv);
+    for (int f = 0; f < m.interior_cvfaces(); ++f) {
+        const mesh::CVFace& cvf = m.cvface(f);
+        double q = p.flux(t, cvf, sol) * cvf.area();
+        int back = cvf.back().id();
+        int front = cvf.front().id();
+        if (back < N)
+            res[back] -= q / m.volume(back).vol();
+        if (front < N)
+            res[front] += q / m.volume(front).vol();
+    }
+    for (int f = m.interior_cvfaces(); f < m.cvfaces(); ++f) {
+        const mesh::CVFace& cvf = m.cvface(f);
+        int back = cvf.back().id();
+        if (back < N)
+            res[back] -= p.boundary_flux(t, cvf, sol) * cvf.area() / m.volume(back).vol();
+    }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [evaluations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int evaluations = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    mesh::Mesh m(meshname, mpicomm);
+    Diffusion p;
+    double t = 0.;
+    Diffusion::TVecDevice sol(m.nodes()), deriv(m.nodes()), temp(m.local_nodes());
+    Diffusion::TVecDevice block(m.local_nodes()), loop(m.local_nodes());
+    p.initialise(t, m, sol, deriv, temp, Diffusion::Callback());
+
+    MPI_Comm comm = mpicomm->communicator();
+    double times[2];
+    for (int method = 0; method < 2; ++method) {
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int e = 0; e < evaluations; ++e) {
+            if (method == 0)
+                p.residual_evaluation(t, m, sol, deriv, block);
+            else
+                loop_residual(t, p, m, sol, deriv, loop);
+        }
+        double elapsed = MPI_Wtime() - start;
+        MPI_Reduce(&elapsed, &times[method], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    }
+
+    double diff[2] = {0., 0.};
+    for (int i = 0; i < m.local_nodes(); ++i) {
+        diff[0] = std::max(diff[0], std::fabs(block[i] - loop[i]));
+        diff[1] = std::max(diff[1], std::fabs(loop[i]));
+    }
+    double max_diff[2];
+    MPI_Reduce(diff, max_diff, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    if (mpicomm->rank() == 0) {
+        double relative = max_diff[1] > 0. ? max_diff[0] / max_diff[1] : max_diff[0];
+        std::cout << "mesh " << meshname << " on " << mpicomm->size() << " domains, "
+                  << evaluations << " evaluations" << std::endl
+                  << std::setw(12) << "method"
+                  << std::setw(16) << "residual (ms)" << std::endl;
+        const char* names[] = {"block", "loop"};
+        for (int method = 0; method < 2; ++method)
+            std::cout << std::setw(12) << names[method]
+                      << std::setw(16) << std::setprecision(4)
+                      << 1e3*times[method]/evaluations << std::endl;
+        std::cout << "largest relative difference " << relative << std::endl;
+        if (relative > 1e-12) {
+            std::cerr << "ERROR : the block residual differs from the loop" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/****************************************************************
+ * box_mesh
+ *
+ * Generates a box mesh in memory with mesh::BoxMesh, for weak and
+ * strong scaling studies of mesh construction that need no mesh
+ * files, e.g.
+ *
+ *   mpirun -np 8 ./box_mesh 4 128          (strong: 128^3 cells)
+ *   mpirun -np 8 ./box_mesh 4 64 weak      (weak: 64^3 cells per domain)
+ *
+ * The element type is numbered as in the mesh files: 2 triangle,
+ * 3 quadrilateral, 4 tetrahedron, 5 hexahedron, 6 prism.  For weak
+ * scaling the box is stretched along its last axis, so that every
+ * domain has the same number of cells.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <mpi/mpicomm.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 3) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " type cells [weak]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    int type = std::atoi(argv[1]);
+    int n = std::atoi(argv[2]);
+    bool weak = argc > 3 && std::string(argv[3]) == "weak";
+
+    // the last axis is stretched for weak scaling
+    int domains = mpicomm->size();
+    int stretch = weak ? domains : 1;
+    mesh::BoxMesh box = type <= 3 ? mesh::BoxMesh(type, n, n*stretch)
+                                  : mesh::BoxMesh(type, n, n, n*stretch);
+    if (type <= 3)
+        box.set_extent(mesh::Point(0., 0., 0.), mesh::Point(1., stretch, 0.));
+    else
+        box.set_extent(mesh::Point(0., 0., 0.), mesh::Point(1., 1., stretch));
+
+    mpicomm->barrier();
+    double start = MPI_Wtime();
+    mesh::Mesh m(box, mpicomm);
+    double t = MPI_Wtime() - start;
+
+    // the slowest domain determines the construction time
+    double tmax = 0.0;
+    MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, mpicomm->communicator());
+    long long external = m.external_nodes();
+    long long total_external = 0, max_external = 0;
+    MPI_Reduce(&external, &total_external, 1, MPI_LONG_LONG, MPI_SUM, 0, mpicomm->communicator());
+    MPI_Reduce(&external, &max_external, 1, MPI_LONG_LONG, MPI_MAX, 0, mpicomm->communicator());
+
+    if (mpicomm->rank() == 0)
+        std::cout << box.name() << " on " << domains << " domains" << std::endl
+                  << "  cells            " << std::setprecision(12) << box.cells() << std::endl
+                  << "  global nodes     " << m.global_nodes() << std::endl
+                  << "  elements         " << box.cells()*box.elements_per_cell() << std::endl
+                  << "  external nodes   " << total_external << " total, "
+                  << max_external << " on the busiest domain" << std::endl
+                  << "  construction (s) " << std::setprecision(4) << tmax << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/****************************************************************
+ * communicators
+ *
+ * Checks and times the node value communicators on the parallel
+ * mesh files meshname_<n>_<i>.pmesh (or .bpmesh), e.g.
+ *
+ *   mpirun -np 8 ./communicators ../meshing/meshes/cassion 200
+ *
+ * Each communicator is run repeats times (100 by default) on a
+ * vector holding a function of the global node id at each local
+ * node, and the results are checked against that function:
+ *
+ *  broadcast : BroadcastCommunicator, an MPI_Allgatherv of the whole
+ *              global vector to fill the external nodes
+ *  halo      : HaloCommunicator, which sends each neighbour only the
+ *              values at its external nodes
+ *  gather    : GatherCommunicator, gathering every node to the root
+ *  subset    : GatherCommunicator, gathering every third global node,
+ *              last first, to the root
+ *
+ * The time is the mean per call on the slowest domain.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <fvm/impl/communicators/broadcast_communicator.h>
+#include <fvm/impl/communicators/gather_communicator.h>
+#include <fvm/impl/communicators/halo_communicator.h>
+#include <mpi/mpicomm.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// the value checked at the node with global id g
+double node_value(int g) {
+    return 0.5*g + 1.;
+}
+
+// fills the local nodes, and marks the external nodes as not yet received
+void fill(const mesh::Mesh& m, std::vector<double>& values) {
+    values.assign(m.nodes(), -1.);
+    for (int i = 0; i < m.local_nodes(); ++i)
+        values[i] = node_value(m.global_node_id(i));
+}
+
+// number of nodes whose value is not node_value of their global id
+int halo_errors(const mesh::Mesh& m, const std::vector<double>& values) {
+    int errors = 0;
+    for (int i = 0; i < m.nodes(); ++i)
+        if (values[i] != node_value(m.global_node_id(i)))
+            ++errors;
+    return errors;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [repeats]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    mesh::Mesh m(meshname, mpicomm);
+    MPI_Comm comm = mpicomm->communicator();
+    bool is_root = mpicomm->rank() == 0;
+
+    fvm::BroadcastCommunicator<double> broadcast(m);
+    fvm::HaloCommunicator<double> halo(m);
+    fvm::GatherCommunicator<double> gather(m);
+    std::vector<int> subset_nodes;
+    if (is_root)
+        for (int g = m.global_nodes()-1; g >= 0; g -= 3)
+            subset_nodes.push_back(g);
+    fvm::GatherCommunicator<double> subset(m, subset_nodes);
+
+    const int methods = 4;
+    const char* names[methods] = {"broadcast", "halo", "gather", "subset"};
+    double times[methods];
+    int errors[methods];
+    std::vector<double> values, result;
+    for (int method = 0; method < methods; ++method) {
+        fill(m, values);
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int r = 0; r < repeats; ++r) {
+            if (method == 0)
+                broadcast.communicate(&values[0]);
+            else if (method == 1)
+                halo.communicate(&values[0]);
+            else if (method == 2)
+                gather.gather(&values[0], result);
+            else
+                subset.gather(&values[0], result);
+        }
+        double elapsed = MPI_Wtime() - start;
+        MPI_Reduce(&elapsed, &times[method], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        int error = 0;
+        if (method < 2)
+            error = halo_errors(m, values);
+        else if (method == 2 && is_root) {
+            error = int(result.size()) != m.global_nodes();
+            for (int g = 0; !error && g < m.global_nodes(); ++g)
+                error += result[g] != node_value(g);
+        } else if (method == 3 && is_root) {
+            error = result.size() != subset_nodes.size();
+            for (int k = 0; !error && k < int(subset_nodes.size()); ++k)
+                error += result[k] != node_value(subset_nodes[k]);
+        }
+        MPI_Reduce(&error, &errors[method], 1, MPI_INT, MPI_SUM, 0, comm);
+    }
+
+    if (is_root) {
+        std::cout << "mesh " << meshname << " on " << mpicomm->size() << " domains, "
+                  << repeats << " repeats" << std::endl
+                  << std::setw(12) << "method"
+                  << std::setw(16) << "time (us)"
+                  << std::setw(10) << "errors" << std::endl;
+        int total = 0;
+        for (int method = 0; method < methods; ++method) {
+            std::cout << std::setw(12) << names[method]
+                      << std::setw(16) << std::setprecision(4)
+                      << 1e6*times[method]/repeats
+                      << std::setw(10) << errors[method] << std::endl;
+            total += errors[method];
+        }
+        if (total) {
+            std::cerr << "ERROR : communicated values differ from the global node ids" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+/****************************************************************
+ * halo_exchange
+ *
+ * Measures the latency of the node halo exchange on the parallel
+ * mesh files meshname_<n>_<i>.pmesh (or .bpmesh), e.g.
+ *
+ *   mpirun -np 8 ./halo_exchange ../meshing/meshes/cassion 2000 2
+ *
+ * The halos of vectors vectors (2 by default, as for u and up in
+ * the solver) are exchanged exchanges times (1000 by default) with
+ *
+ *  isend      : a fresh MPI_Isend/MPI_Irecv for each neighbour and
+ *               vector in every exchange, as mpi::Communicator did
+ *               before its requests were persistent
+ *  persistent : mpi::Communicator, which makes its requests once when
+ *               a vector is added and starts them with MPI_Startall
+ *  typed      : persistent, sending MPI_Type_indexed types straight
+ *               from the vectors
+ *  packed     : persistent, packing the halo into contiguous buffers
+ *               (persistent uses whichever of the two the Communicator
+ *               timed as faster when it was made)
+ *  fused      : mpi::Communicator with the vectors in one group, packed
+ *               into a single message to each neighbour
+ *  neighbour  : persistent, with the exchange_neighbourhood backend, one
+ *               MPI_Ineighbor_alltoallw per vector on a graph communicator,
+ *               always packed
+ *  nfused     : fused, with the exchange_neighbourhood backend, one
+ *               MPI_Ineighbor_alltoallv per group
+ *  shared     : persistent, with the exchange_shared_memory backend, in
+ *               which neighbours on the node read the halo values from
+ *               MPI-3 shared windows
+ *  sfused     : fused, with the exchange_shared_memory backend
+ *
+ * isend and typed send the same MPI_Type_indexed types straight from
+ * the vectors, so their difference is the cost of setting up the
+ * requests; fused sends one message per neighbour instead of one per
+ * neighbour and vector.
+ * The time is the mean per exchange on the slowest domain.  The halo
+ * values are checked against the global node ids after each method.
+ * With FVM_COMM_PROFILE set the communication profile of persistent
+ * is printed, and written to halo_exchange.csv.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <fvm/impl/communicators/communicator.h>
+#include <mpi/mpicomm.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef lin::DefaultCoordinator<double> Coord;
+typedef lin::Vector<double, Coord> TVec;
+
+// the halo exchange as done by a fresh request for each message
+class IsendExchange {
+public:
+    IsendExchange(const mesh::Pattern& pattern, mpi::MPICommPtr comm)
+        : pattern_(pattern), comm_(comm->duplicate("ISEND")) {
+        for (int i = 0; i < pattern.num_neighbours(); ++i) {
+            int n = pattern.neighbour(i);
+            send_type_.push_back(indexed(pattern.send_index(n)));
+            recv_type_.push_back(indexed(pattern.recv_index(n)));
+        }
+    }
+
+    ~IsendExchange() {
+        for (int i = 0; i < int(send_type_.size()); ++i) {
+            MPI_Type_free(&send_type_[i]);
+            MPI_Type_free(&recv_type_[i]);
+        }
+    }
+
+    void exchange(std::vector<TVec>& vectors) {
+        int neighbours = pattern_.num_neighbours();
+        int messages = neighbours*vectors.size();
+        std::vector<MPI_Request> send_requests(messages), recv_requests(messages);
+        std::vector<MPI_Status> status(messages);
+        for (int v = 0; v < int(vectors.size()); ++v)
+            for (int i = 0; i < neighbours; ++i) {
+                int n = pattern_.neighbour(i);
+                int k = v*neighbours + i;
+                recv_requests[k] = comm_->Irecv(vectors[v].data(), n, v+1, recv_type_[i]);
+                send_requests[k] = comm_->Isend(vectors[v].data(), n, v+1, send_type_[i]);
+            }
+        comm_->Waitall(send_requests, status);
+        comm_->Waitall(recv_requests, status);
+    }
+
+private:
+    MPI_Datatype indexed(const std::vector<int>& index) {
+        std::vector<int> lengths(index.size(), 1);
+        std::vector<int> displacements(index);
+        MPI_Datatype type;
+        MPI_Type_indexed(index.size(),
+                         lengths.empty() ? 0 : &lengths[0],
+                         displacements.empty() ? 0 : &displacements[0],
+                         MPI_DOUBLE, &type);
+        MPI_Type_commit(&type);
+        return type;
+    }
+
+    const mesh::Pattern& pattern_;
+    mpi::MPICommPtr comm_;
+    std::vector<MPI_Datatype> send_type_;
+    std::vector<MPI_Datatype> recv_type_;
+};
+
+// set the local values to the global node ids and clear the halo
+void fill(const mesh::Mesh& m, std::vector<TVec>& vectors) {
+    for (int v = 0; v < int(vectors.size()); ++v)
+        for (int i = 0; i < m.nodes(); ++i)
+            vectors[v][i] = i < m.local_nodes() ? m.global_node_id(i) + v : -1.;
+}
+
+// number of halo values that differ from the global node ids
+int errors(const mesh::Mesh& m, const std::vector<TVec>& vectors) {
+    int bad = 0;
+    for (int v = 0; v < int(vectors.size()); ++v)
+        for (int i = m.local_nodes(); i < m.nodes(); ++i)
+            if (vectors[v][i] != m.global_node_id(i) + v)
+                ++bad;
+    return bad;
+}
+
+// the time per exchange on the slowest domain, and the total errors
+void report(const std::string& method, double t, int exchanges, int bad,
+            mpi::MPICommPtr comm) {
+    double tmax = 0.0;
+    int total = 0;
+    MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, comm->communicator());
+    MPI_Reduce(&bad, &total, 1, MPI_INT, MPI_SUM, 0, comm->communicator());
+    if (comm->rank() == 0)
+        std::cout << std::setw(12) << method
+                  << std::setw(16) << std::setprecision(4) << 1e6*tmax/exchanges
+                  << std::setw(10) << total << std::endl;
+}
+
+const mpi::exchange_backend backends[] = {
+    mpi::exchange_point_to_point, mpi::exchange_neighbourhood, mpi::exchange_shared_memory};
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [exchanges] [vectors]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int exchanges = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int nvectors = argc > 3 ? std::atoi(argv[3]) : 2;
+
+    mesh::Mesh m(meshname, mpicomm);
+    const mesh::Pattern& pattern = m.node_pattern();
+
+    int neighbours = pattern.num_neighbours(), max_neighbours = 0;
+    MPI_Reduce(&neighbours, &max_neighbours, 1, MPI_INT, MPI_MAX, 0, mpicomm->communicator());
+    if (mpicomm->rank() == 0)
+        std::cout << "mesh " << meshname << " on " << mpicomm->size()
+                  << " domains (at most " << max_neighbours << " neighbours), "
+                  << exchanges << " exchanges of " << nvectors << " vectors" << std::endl
+                  << std::setw(12) << "method"
+                  << std::setw(16) << "exchange (us)"
+                  << std::setw(10) << "errors" << std::endl;
+
+    std::vector<TVec> vectors;
+    for (int v = 0; v < nvectors; ++v)
+        vectors.push_back(TVec(m.nodes()));
+
+    // fresh requests for every exchange
+    {
+        IsendExchange isend(pattern, mpicomm);
+        fill(m, vectors);
+        isend.exchange(vectors);
+        int bad = errors(m, vectors);
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int i = 0; i < exchanges; ++i)
+            isend.exchange(vectors);
+        report("isend", MPI_Wtime() - start, exchanges, bad, mpicomm);
+    }
+
+    // persistent requests, a neighbourhood collective and shared memory,
+    // then persistent requests with and without packing
+    for (int b = 0; b < 5; ++b) {
+        mpi::Communicator<Coord, double> comm("HALO", pattern);
+        comm.set_backend(backends[b < 3 ? b : 0]);
+        if (b >= 3)
+            comm.set_host_packing(b == 4);
+        std::vector<int> tags;
+        for (int v = 0; v < nvectors; ++v)
+            tags.push_back(comm.vec_add(vectors[v]));
+        fill(m, vectors);
+        for (int v = 0; v < nvectors; ++v)
+            comm.send(tags[v]);
+        comm.recv_all();
+        int bad = errors(m, vectors);
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int i = 0; i < exchanges; ++i) {
+            for (int v = 0; v < nvectors; ++v)
+                comm.send(tags[v]);
+            comm.recv_all();
+        }
+        const char* names[] = {"persistent", "neighbour", "shared", "typed", "packed"};
+        report(names[b], MPI_Wtime() - start, exchanges, bad, mpicomm);
+        if (b == 0)
+            comm.report_profile(std::cout, "halo_exchange.csv");
+    }
+
+    // one message per neighbour for all of the vectors, with each backend
+    for (int b = 0; b < 3; ++b) {
+        mpi::Communicator<Coord, double> comm("HALO", pattern);
+        comm.set_backend(backends[b]);
+        std::vector<int> tags;
+        for (int v = 0; v < nvectors; ++v)
+            tags.push_back(comm.vec_add(vectors[v]));
+        int group = comm.group_add(tags);
+        fill(m, vectors);
+        comm.send(group);
+        comm.recv(group);
+        int bad = errors(m, vectors);
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int i = 0; i < exchanges; ++i) {
+            comm.send(group);
+            comm.recv(group);
+        }
+        const char* names[] = {"fused", "nfused", "sfused"};
+        report(names[b], MPI_Wtime() - start, exchanges, bad, mpicomm);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/****************************************************************
+ * mesh_construction
+ *
+ * Times the construction of a mesh::Mesh from the parallel mesh
+ * files meshname_<n>_<i>.pmesh (or .bpmesh), for comparing mesh
+ * construction changes on the meshes in meshing/meshes, e.g.
+ *
+ *   mpirun -np 4 ./mesh_construction ../meshing/meshes/cassion 5
+ *
+ * Snapshots are disabled (leave FVM_MESH_SNAPSHOT unset), so that every
+ * repeat does all of the work.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <mpi/mpicomm.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [repeats]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    double best = 0.0, total = 0.0;
+    int nodes = 0, edges = 0, elements = 0, cvfaces = 0;
+    for (int i = 0; i < repeats; ++i) {
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        mesh::Mesh m(meshname, mpicomm, false);
+        double t = MPI_Wtime() - start;
+
+        // the slowest domain determines the construction time
+        double tmax = 0.0;
+        MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, mpicomm->communicator());
+        best = (i == 0 || tmax < best) ? tmax : best;
+        total += tmax;
+
+        nodes = m.local_nodes();
+        edges = m.edges();
+        elements = m.elements();
+        cvfaces = m.cvfaces();
+    }
+
+    int local[4] = {nodes, edges, elements, cvfaces};
+    int global[4];
+    MPI_Reduce(local, global, 4, MPI_INT, MPI_SUM, 0, mpicomm->communicator());
+    if (mpicomm->rank() == 0) {
+        std::cout << "mesh " << meshname << " on " << mpicomm->size() << " domains" << std::endl;
+        std::cout << "  nodes " << global[0] << ", edges " << global[1]
+                  << ", elements " << global[2] << ", CV faces " << global[3]
+                  << " (edges, elements and CV faces include overlap)" << std::endl;
+        std::cout << std::setprecision(4)
+                  << "  construction time : best " << best
+                  << " s, mean " << total/repeats
+                  << " s over " << repeats << " repeats" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/****************************************************************
+ * node_ordering
+ *
+ * Compares the node orderings supported by mesh::Mesh on the
+ * parallel mesh files meshname_<n>_<i>.pmesh (or .bpmesh), e.g.
+ *
+ *   mpirun -np 4 ./node_ordering ../meshing/meshes/cassion 50
+ *
+ * For each ordering the mesh is constructed (without snapshots),
+ * then three things are measured:
+ *
+ *  residual : the time for a residual-like sweep over the interior
+ *             CV faces, which gathers values from the nodes of each
+ *             CV face's element and scatters fluxes back to the
+ *             nodes, as the physics residual evaluations do
+ *  coloured : the same sweep on the OpenMP threads, a CV face
+ *             colour at a time (see Mesh::cvface_colour), and the
+ *             most colours of a domain
+ *  fill     : the bandwidth and profile (envelope) of the local node
+ *             adjacency matrix.  The profile is the number of entries
+ *             in a skyline factorisation of the matrix, and bounds
+ *             the fill of the banded/incomplete factorisations used
+ *             by the preconditioner.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <mpi/mpicomm.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* ordering_name(mesh::node_ordering ordering) {
+    switch (ordering) {
+        case mesh::ordering_rcm:     return "rcm";
+        case mesh::ordering_hilbert: return "hilbert";
+        case mesh::ordering_morton:  return "morton";
+        default:                     return "none";
+    }
+}
+
+// the flux through the ith interior CV face
+double cvface_flux(const mesh::Mesh& m, const std::vector<double>& u, int i) {
+    const std::vector<int>& front = m.cvface_front_id();
+    const std::vector<int>& back = m.cvface_back_id();
+
+    // gather the element values, as for a shape function gradient
+    const mesh::Element& e = m.element(m.cvface_element_id()[i]);
+    double ue = 0.0;
+    for (int j = 0; j < e.nodes(); ++j)
+        ue += u[e.node_id(j)];
+    ue /= e.nodes();
+
+    return m.cvface_area()[i] * (u[back[i]] - u[front[i]] + ue);
+}
+
+// one residual-like sweep over the interior CV faces
+void residual(const mesh::Mesh& m, const std::vector<double>& u,
+              std::vector<double>& res) {
+    const std::vector<int>& front = m.cvface_front_id();
+    const std::vector<int>& back = m.cvface_back_id();
+    const std::vector<double>& vol = m.volume_vol();
+
+    std::fill(res.begin(), res.end(), 0.0);
+    for (int i = 0; i < m.interior_cvfaces(); ++i) {
+        // scatter the flux to the two nodes
+        double flux = cvface_flux(m, u, i);
+        res[front[i]] -= flux;
+        res[back[i]] += flux;
+    }
+    for (int i = 0; i < m.local_nodes(); ++i)
+        res[i] /= vol[i];
+}
+
+// the same sweep over the threads, one CV face colour at a time, so that the
+// threads scatter to different nodes
+void coloured_residual(const mesh::Mesh& m, const std::vector<double>& u,
+                       std::vector<double>& res) {
+    const std::vector<int>& front = m.cvface_front_id();
+    const std::vector<int>& back = m.cvface_back_id();
+    const std::vector<double>& vol = m.volume_vol();
+
+    std::fill(res.begin(), res.end(), 0.0);
+    #pragma omp parallel
+    {
+        for (int c = 0; c < m.cvface_colours(); ++c) {
+            mesh::IndexRange colour = m.cvface_colour(c);
+            #pragma omp for schedule(static)
+            for (int k = 0; k < colour.size(); ++k) {
+                int i = colour[k];
+                if (i >= m.interior_cvfaces())
+                    continue;
+                double flux = cvface_flux(m, u, i);
+                res[front[i]] -= flux;
+                res[back[i]] += flux;
+            }
+        }
+        #pragma omp for schedule(static)
+        for (int i = 0; i < m.local_nodes(); ++i)
+            res[i] /= vol[i];
+    }
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [sweeps]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int sweeps = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    const mesh::node_ordering orderings[] = {
+        mesh::ordering_rcm, mesh::ordering_hilbert,
+        mesh::ordering_morton, mesh::ordering_none
+    };
+
+    if (mpicomm->rank() == 0)
+        std::cout << "mesh " << meshname << " on " << mpicomm->size()
+                  << " domains, " << sweeps << " residual sweeps" << std::endl
+                  << std::setw(10) << "ordering"
+                  << std::setw(14) << "residual (s)"
+                  << std::setw(14) << "coloured (s)"
+                  << std::setw(10) << "colours"
+                  << std::setw(12) << "bandwidth"
+                  << std::setw(14) << "profile" << std::endl;
+
+    for (int k = 0; k < 4; ++k) {
+        mesh::Mesh m(meshname, mpicomm, false, orderings[k]);
+
+        // bandwidth and profile of the local node adjacency matrix
+        std::vector<int> first(m.local_nodes());
+        for (int i = 0; i < m.local_nodes(); ++i)
+            first[i] = i;
+        for (int i = 0; i < m.edges(); ++i) {
+            int a = m.edge(i).front().id();
+            int b = m.edge(i).back().id();
+            if (a < m.local_nodes() && b < m.local_nodes())
+                first[std::max(a, b)] = std::min(first[std::max(a, b)], std::min(a, b));
+        }
+        long long fill[2] = {0, 0}; // bandwidth, profile
+        for (int i = 0; i < m.local_nodes(); ++i) {
+            fill[0] = std::max<long long>(fill[0], i - first[i]);
+            fill[1] += i - first[i] + 1;
+        }
+
+        // time the residual sweeps
+        std::vector<double> u(m.nodes()), res(m.nodes());
+        for (int i = 0; i < m.nodes(); ++i)
+            u[i] = m.node(i).point().x + m.node(i).point().y;
+        residual(m, u, res);
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int i = 0; i < sweeps; ++i)
+            residual(m, u, res);
+        double t = MPI_Wtime() - start;
+
+        coloured_residual(m, u, res);
+        mpicomm->barrier();
+        start = MPI_Wtime();
+        for (int i = 0; i < sweeps; ++i)
+            coloured_residual(m, u, res);
+        double tc = MPI_Wtime() - start;
+
+        // the slowest domain determines the time
+        double tmax = 0.0, tcmax = 0.0;
+        MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, mpicomm->communicator());
+        MPI_Reduce(&tc, &tcmax, 1, MPI_DOUBLE, MPI_MAX, 0, mpicomm->communicator());
+        int colours = m.cvface_colours(), max_colours = 0;
+        MPI_Reduce(&colours, &max_colours, 1, MPI_INT, MPI_MAX, 0, mpicomm->communicator());
+        long long bandwidth = 0, profile = 0;
+        MPI_Reduce(&fill[0], &bandwidth, 1, MPI_LONG_LONG, MPI_MAX, 0, mpicomm->communicator());
+        MPI_Reduce(&fill[1], &profile, 1, MPI_LONG_LONG, MPI_SUM, 0, mpicomm->communicator());
+        if (mpicomm->rank() == 0)
+            std::cout << std::setw(10) << ordering_name(orderings[k])
+                      << std::setw(14) << std::setprecision(4) << tmax
+                      << std::setw(14) << std::setprecision(4) << tcmax
+                      << std::setw(10) << max_colours
+                      << std::setw(12) << bandwidth
+                      << std::setw(14) << profile << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
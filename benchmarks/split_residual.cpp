@@ -0,0 +1,236 @@
+/****************************************************************
+ * split_residual
+ *
+ * Checks and times the split residual evaluation of SolverBase,
+ * in which the exchange of the external node values overlaps the
+ * halo-independent part of the evaluation, e.g.
+ *
+ *   mpirun -np 8 ./split_residual ../meshing/meshes/cassion 200
+ *
+ * The physics is a nonlinear diffusion whose preprocess_evaluation
+ * computes a storage coefficient at each local node and the flux
+ * through each CV face, and whose interior phase does this only for
+ * the nodes [0, halo_independent_nodes()) and the CV faces
+ * [0, halo_independent_cvfaces()).  The residual is evaluated
+ * evaluations times (100 by default) by
+ *
+ *  split   : compute_residual(res, true), which sends the halo,
+ *            runs the interior phase, receives the halo and then
+ *            runs the halo phase and the residual evaluation
+ *  unsplit : the halo is exchanged first, then compute_residual(res,
+ *            false) runs the whole preprocess_evaluation
+ *
+ * Before each evaluation the values at the external nodes are
+ * overwritten, so that an interior phase that used them would give
+ * a different residual.  The largest difference between the two
+ * residuals, relative to the largest residual, is printed with the
+ * mean time per evaluation on the slowest domain.
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <fvm/physics_base.h>
+#include <fvm/solver.h>
+#include <mpi/mpicomm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef lin::DefaultCoordinator<double> Coord;
+
+struct Head {
+    double h;
+    static const int variables = 1;
+    static const int differential_variables = 1;
+};
+
+// diffusion with a conductivity and a storage coefficient that depend on the
+// solution, evaluated for each CV face and local node before the residual
+class Nonlinear : public fvm::PhysicsBase<Nonlinear, Head, Coord> {
+public:
+    typedef TVecDevice TVec;
+
+    void init(double& t, const mesh::Mesh& m, TVecDevice& sol, TVecDevice& deriv) {
+        storage_.resize(m.local_nodes());
+        flux_.resize(m.cvfaces());
+        for (int i = 0; i < m.nodes(); ++i) {
+            const mesh::Point& p = m.node(i).point();
+            sol[i] = std::sin(p.x) + p.y*p.z;
+            deriv[i] = std::cos(p.y);
+        }
+    }
+
+    void preprocess_evaluation(double t, const mesh::Mesh& m,
+                               const TVecDevice& sol, const TVecDevice& deriv) {
+        evaluate_nodes(m, sol, 0, m.local_nodes());
+        evaluate_cvfaces(m, sol, 0, m.cvfaces());
+    }
+
+    // only the values at the local nodes are used
+    void preprocess_evaluation_interior(double t, const mesh::Mesh& m,
+                                        const TVecDevice& sol, const TVecDevice& deriv) {
+        evaluate_nodes(m, sol, 0, m.halo_independent_nodes());
+        evaluate_cvfaces(m, sol, 0, m.halo_independent_cvfaces());
+    }
+
+    void preprocess_evaluation_halo(double t, const mesh::Mesh& m,
+                                    const TVecDevice& sol, const TVecDevice& deriv) {
+        evaluate_nodes(m, sol, m.halo_independent_nodes(), m.local_nodes());
+        evaluate_cvfaces(m, sol, m.halo_independent_cvfaces(), m.cvfaces());
+    }
+
+    Head lhs(double t, const mesh::Volume& volume,
+             const TVecDevice& sol, const TVecDevice& deriv) const {
+        Head result;
+        result.h = storage_[volume.id()] * deriv[volume.id()];
+        return result;
+    }
+
+    Head source(double t, const mesh::Volume& volume, const TVecDevice& sol) const {
+        Head result;
+        result.h = volume.centroid().x;
+        return result;
+    }
+
+    Head flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) const {
+        Head result;
+        result.h = flux_[cvf.id()];
+        return result;
+    }
+
+    Head boundary_flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) const {
+        return flux(t, cvf, sol);
+    }
+
+private:
+    std::vector<double> storage_;
+    std::vector<double> flux_;
+
+    void evaluate_nodes(const mesh::Mesh& m, const TVecDevice& sol, int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            storage_[i] = 1. + sol[i]*sol[i];
+    }
+
+    // two point fluxes with the conductivity at the mean of the values on
+    // either side, and outflow through the boundary
+    void evaluate_cvfaces(const mesh::Mesh& m, const TVecDevice& sol, int begin, int end) {
+        for (int f = begin; f < end; ++f) {
+            const mesh::CVFace& cvf = m.cvface(f);
+            const mesh::Node& back = cvf.back();
+            if (f >= m.interior_cvfaces()) {
+                flux_[f] = sol[back.id()];
+                continue;
+            }
+            const mesh::Node& front = cvf.front();
+            double mean = 0.5*(sol[front.id()] + sol[back.id()]);
+            double k = 1. / (1. + mean*mean);
+            flux_[f] = -k * (sol[front.id()] - sol[back.id()])
+                     / util::distance(front.point(), back.point());
+        }
+    }
+};
+
+// exposes the two ways SolverBase can evaluate a residual
+class SplitSolver : public fvm::SolverBase<Nonlinear> {
+public:
+    SplitSolver(const mesh::Mesh& m, Nonlinear& p)
+        : fvm::SolverBase<Nonlinear>(m, p, 0.) {}
+
+    void split_residual(TVecDevice& res) {
+        overwrite_halo();
+        compute_residual(res, true);
+    }
+
+    void unsplit_residual(TVecDevice& res) {
+        overwrite_halo();
+        node_comm_.send(uup_comm_tag_);
+        node_comm_.recv(uup_comm_tag_);
+        compute_residual(res, false);
+    }
+
+private:
+    // values that no correct evaluation can see
+    void overwrite_halo() {
+        for (int i = m.local_nodes(); i < m.nodes(); ++i) {
+            u[i] = 1e30;
+            up[i] = -1e30;
+        }
+    }
+};
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    mpi::Process process(argc, argv);
+    mpi::MPICommPtr mpicomm(new mpi::MPIComm(MPI_COMM_WORLD, "BENCH"));
+
+    if (argc < 2) {
+        if (mpicomm->rank() == 0)
+            std::cerr << "usage : " << argv[0] << " meshname [evaluations]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int evaluations = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    mesh::Mesh m(meshname, mpicomm);
+    Nonlinear p;
+    SplitSolver solver(m, p);
+    Nonlinear::TVecDevice split(m.local_nodes()), unsplit(m.local_nodes());
+
+    MPI_Comm comm = mpicomm->communicator();
+    double times[2];
+    for (int method = 0; method < 2; ++method) {
+        mpicomm->barrier();
+        double start = MPI_Wtime();
+        for (int e = 0; e < evaluations; ++e) {
+            if (method == 0)
+                solver.split_residual(split);
+            else
+                solver.unsplit_residual(unsplit);
+        }
+        double elapsed = MPI_Wtime() - start;
+        MPI_Reduce(&elapsed, &times[method], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    }
+
+    double diff[2] = {0., 0.};
+    for (int i = 0; i < m.local_nodes(); ++i) {
+        diff[0] = std::max(diff[0], std::fabs(split[i] - unsplit[i]));
+        diff[1] = std::max(diff[1], std::fabs(unsplit[i]));
+    }
+    double max_diff[2];
+    MPI_Reduce(diff, max_diff, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    // fraction of the work done while the exchange is in flight
+    int counts[4] = {m.halo_independent_nodes(), m.local_nodes(),
+                     m.halo_independent_cvfaces(), m.cvfaces()};
+    int totals[4];
+    MPI_Reduce(counts, totals, 4, MPI_INT, MPI_SUM, 0, comm);
+
+    if (mpicomm->rank() == 0) {
+        double relative = max_diff[1] > 0. ? max_diff[0] / max_diff[1] : max_diff[0];
+        std::cout << "mesh " << meshname << " on " << mpicomm->size() << " domains, "
+                  << evaluations << " evaluations" << std::endl
+                  << "interior phase: " << totals[0] << " of " << totals[1]
+                  << " nodes, " << totals[2] << " of " << totals[3]
+                  << " CV faces" << std::endl
+                  << std::setw(12) << "method"
+                  << std::setw(16) << "residual (ms)" << std::endl;
+        const char* names[] = {"split", "unsplit"};
+        for (int method = 0; method < 2; ++method)
+            std::cout << std::setw(12) << names[method]
+                      << std::setw(16) << std::setprecision(4)
+                      << 1e3*times[method]/evaluations << std::endl;
+        std::cout << "largest relative difference " << relative << std::endl;
+        // !(relative <= tol) also catches a residual that is not a number
+        if (!(relative <= 1e-12)) {
+            std::cerr << "ERROR : the split residual differs from the unsplit" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/****************************************************************
+ * thread_halo
+ *
+ * Runs a decomposition of a global mesh in one process, with each
+ * domain on its own thread, and measures the latency of the node
+ * halo exchange between the domains with mpi::ThreadCommunicator,
+ * e.g.
+ *
+ *   ./thread_halo ../meshing/meshes/cassion 16 2000 2
+ *
+ * The global mesh meshname.mesh (or meshname.msh) is partitioned
+ * into domains domains by recursive coordinate bisection, as by
+ * the partition tool, and the halos of each domain are numbered as
+ * split numbers them, so no MPI runtime or .pmesh files are needed.
+ * The halos of vectors vectors (2 by default) are exchanged
+ * exchanges times (1000 by default).  The time is the mean per
+ * exchange on the slowest domain, which can be compared with the
+ * persistent row of halo_exchange on the .pmesh files of the same
+ * number of domains.  The halo values are checked against the
+ * global node ids.
+ *
+ * usage : thread_halo meshname domains [exchanges] [vectors]
+ ***************************************************************/
+#include <fvm/impl/mesh/global_mesh.h>
+#include <fvm/impl/mesh/partition.h>
+#include <fvm/impl/communicators/thread_communicator.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef lin::DefaultCoordinator<double> Coord;
+typedef lin::Vector<double, Coord> TVec;
+
+// set the local values to the global node ids and clear the halo
+void fill(const mesh::DomainHalo& d, std::vector<TVec>& vectors) {
+    for (int v = 0; v < int(vectors.size()); ++v)
+        for (int i = 0; i < int(d.nodes.size()); ++i)
+            vectors[v][i] = i < d.local_nodes ? d.nodes[i] + v : -1.;
+}
+
+// number of halo values that differ from the global node ids
+int errors(const mesh::DomainHalo& d, const std::vector<TVec>& vectors) {
+    int bad = 0;
+    for (int v = 0; v < int(vectors.size()); ++v)
+        for (int i = d.local_nodes; i < int(d.nodes.size()); ++i)
+            if (vectors[v][i] != d.nodes[i] + v)
+                ++bad;
+    return bad;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3 || std::atoi(argv[2]) < 1) {
+        std::cerr << "usage : " << argv[0] << " meshname domains [exchanges] [vectors]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int domains = std::atoi(argv[2]);
+    int exchanges = argc > 3 ? std::atoi(argv[3]) : 1000;
+    int nvectors = argc > 4 ? std::atoi(argv[4]) : 2;
+
+    std::vector<mesh::DomainHalo> halos;
+    try {
+        std::string filename = meshname + ".mesh";
+        if (!std::ifstream(filename.c_str()))
+            filename = meshname + ".msh";
+        mesh::GlobalMesh m(filename);
+
+        std::vector<mesh::Point> points(m.nodes());
+        for (int i = 0; i < m.nodes(); ++i)
+            points[i] = m.point(i);
+        std::vector<int> part(m.nodes());
+        mesh::rcb_partition(points, m.dim(), std::vector<double>(), domains, false, part);
+
+        mesh::Connectivity graph;
+        mesh::node_graph(m, graph);
+        mesh::domain_halos(graph, part, domains, halos);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR : " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<mesh::Pattern> patterns(domains);
+    int max_neighbours = 0;
+    for (int p = 0; p < domains; ++p) {
+        mesh::DomainHalo& d = halos[p];
+        for (int i = 0; i < int(d.neighbours.size()); ++i)
+            patterns[p].add_neighbour(d.neighbours[i], d.send[i], d.recv[i]);
+        max_neighbours = std::max(max_neighbours, int(d.neighbours.size()));
+    }
+    mpi::ThreadDomains threads(patterns);
+
+    std::cout << "mesh " << meshname << " on " << domains
+              << " thread domains (at most " << max_neighbours << " neighbours), "
+              << exchanges << " exchanges of " << nvectors << " vectors" << std::endl
+              << std::setw(12) << "method"
+              << std::setw(16) << "exchange (us)"
+              << std::setw(10) << "errors" << std::endl;
+
+    // every domain must have its own thread, or the exchanges never end
+    std::vector<double> times(domains);
+    std::vector<int> bad(domains);
+    int started = 0;
+    omp_set_dynamic(0);
+    #pragma omp parallel num_threads(domains)
+    {
+        int p = omp_get_thread_num();
+        #pragma omp single
+        started = omp_get_num_threads();
+        if (started == domains) {
+            const mesh::DomainHalo& d = halos[p];
+            mpi::ThreadCommunicator<Coord, double> comm(threads, p);
+
+            std::vector<TVec> vectors;
+            for (int v = 0; v < nvectors; ++v)
+                vectors.push_back(TVec(d.nodes.size()));
+            std::vector<int> tags;
+            for (int v = 0; v < nvectors; ++v)
+                tags.push_back(comm.vec_add(vectors[v]));
+
+            fill(d, vectors);
+            for (int v = 0; v < nvectors; ++v)
+                comm.send(tags[v]);
+            comm.recv_all();
+            bad[p] = errors(d, vectors);
+
+            #pragma omp barrier
+            double start = omp_get_wtime();
+            for (int i = 0; i < exchanges; ++i) {
+                for (int v = 0; v < nvectors; ++v)
+                    comm.send(tags[v]);
+                comm.recv_all();
+            }
+            times[p] = omp_get_wtime() - start;
+        }
+    }
+    if (started != domains) {
+        std::cerr << "ERROR : only " << started << " threads for " << domains << " domains" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int total = 0;
+    for (int p = 0; p < domains; ++p)
+        total += bad[p];
+    std::cout << std::setw(12) << "threads"
+              << std::setw(16) << std::setprecision(4)
+              << 1e6*(*std::max_element(times.begin(), times.end()))/exchanges
+              << std::setw(10) << total << std::endl;
+    return EXIT_SUCCESS;
+}
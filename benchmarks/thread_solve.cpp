@@ -0,0 +1,306 @@
+/****************************************************************
+ * thread_solve
+ *
+ * Solves a diffusion problem on a decomposition of a global mesh in
+ * one process, with each domain on its own thread, and checks the
+ * solution against that of one domain, e.g.
+ *
+ *   ./thread_solve ../meshing/meshes/cassion 16 200
+ *
+ * The global mesh meshname.mesh (or meshname.msh) is partitioned
+ * into domains domains by recursive coordinate bisection, and each
+ * thread makes the mesh of its domain from a mesh::ThreadPartition.
+ * Each domain has an fvm::Solver whose halos are exchanged by an
+ * mpi::ThreadCommunicator, and which takes steps (100 by default)
+ * of explicit Euler of a fixed size, so no MPI runtime is needed.
+ * The same steps are taken on one domain, and the largest
+ * difference between the two solutions at the nodes of the global
+ * mesh, relative to the largest value, is printed with the time per
+ * step of one domain and of the slowest of the domains.
+ *
+ * usage : thread_solve meshname domains [steps]
+ ***************************************************************/
+#include <fvm/mesh.h>
+#include <fvm/physics_base.h>
+#include <fvm/solver.h>
+#include <fvm/impl/communicators/thread_communicator.h>
+#include <fvm/impl/mesh/global_mesh.h>
+#include <fvm/impl/mesh/partition.h>
+#include <fvm/impl/mesh/thread_partition.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef lin::DefaultCoordinator<double> Coord;
+
+struct Head {
+    double h;
+    static const int variables = 1;
+    static const int differential_variables = 1;
+};
+
+// linear diffusion with a two point flux, a source that varies over the
+// domain and outflow through the boundary
+class Diffusion : public fvm::PhysicsBase<Diffusion, Head, Coord> {
+public:
+    typedef TVecDevice TVec;
+
+    void init(double& t, const mesh::Mesh& m, TVecDevice& sol, TVecDevice& deriv) {
+        for (int i = 0; i < m.nodes(); ++i) {
+            const mesh::Point& p = m.node(i).point();
+            sol[i] = std::sin(p.x) + p.y*p.z;
+        }
+    }
+
+    Head lhs(double t, const mesh::Volume& volume,
+             const TVecDevice& sol, const TVecDevice& deriv) const {
+        Head result;
+        result.h = deriv[volume.id()];
+        return result;
+    }
+
+    Head source(double t, const mesh::Volume& volume, const TVecDevice& sol) const {
+        Head result;
+        result.h = volume.centroid().x;
+        return result;
+    }
+
+    Head flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) const {
+        const mesh::Node& front = cvf.front();
+        const mesh::Node& back = cvf.back();
+        Head result;
+        result.h = -(sol[front.id()] - sol[back.id()]) / util::distance(front.point(), back.point());
+        return result;
+    }
+
+    Head boundary_flux(double t, const mesh::CVFace& cvf, const TVecDevice& sol) const {
+        Head result;
+        result.h = sol[cvf.back().id()];
+        return result;
+    }
+};
+
+// Explicit Euler steps of a fixed size.  The lhs of Diffusion is the
+// derivative, so the residual with a zero derivative is the derivative.
+// No norms are taken, so the domains need no reductions.
+class ForwardEuler {
+public:
+    typedef Diffusion::TVecDevice TVecDevice;
+    typedef fvm::Callback<Diffusion> Callback;
+
+    ForwardEuler(const mesh::Mesh& m, double dt)
+        : m(m), dt_(dt), t_(0), u_(0), up_(0) {}
+
+    void initialise(double& t, TVecDevice& u, TVecDevice& up, Callback compute_residual) {
+        t_ = &t;
+        u_ = &u;
+        up_ = &up;
+        compute_residual_ = compute_residual;
+        res_ = TVecDevice(m.local_nodes());
+    }
+
+    void reinitialise() {}
+
+    void advance() {
+        TVecDevice& u = *u_;
+        TVecDevice& up = *up_;
+        for (int i = 0; i < m.nodes(); ++i)
+            up[i] = 0.;
+        compute_residual_(res_, true);
+        for (int i = 0; i < m.local_nodes(); ++i)
+            u[i] += dt_ * res_[i];
+        *t_ += dt_;
+    }
+
+    void advance(double next_time) {
+        while (*t_ + 0.5*dt_ < next_time)
+            advance();
+    }
+
+private:
+    const mesh::Mesh& m;
+    double dt_;
+    double* t_;
+    TVecDevice* u_;
+    TVecDevice* up_;
+    TVecDevice res_;
+    Callback compute_residual_;
+};
+
+typedef mpi::ThreadCommunicator<Coord, Head> NodeComm;
+typedef fvm::Solver<Diffusion, ForwardEuler, NodeComm> Solver;
+
+// a stable step for explicit Euler on m: the outflow and the flux through
+// the CV faces of a control volume may not take more than half its value
+double stable_step(const mesh::Mesh& m) {
+    std::vector<double> rate(m.nodes(), 0.);
+    for (int f = 0; f < m.cvfaces(); ++f) {
+        const mesh::CVFace& cvf = m.cvface(f);
+        if (f >= m.interior_cvfaces()) {
+            rate[cvf.back().id()] += cvf.area();
+            continue;
+        }
+        double k = cvf.area() / util::distance(cvf.front().point(), cvf.back().point());
+        rate[cvf.front().id()] += k;
+        rate[cvf.back().id()] += k;
+    }
+    double dt = 1.;
+    for (int i = 0; i < m.local_nodes(); ++i)
+        if (rate[i] > 0.)
+            dt = std::min(dt, 0.5 * m.volume(i).vol() / rate[i]);
+    return dt;
+}
+
+// Takes steps steps of size dt on each domain of partition, with a thread
+// for each, and sets u to the solution at each node of the global mesh.
+// Returns the time per step of the slowest domain, or a negative time if
+// there are not enough threads.  dt is found on the first domain if it is 0.
+double solve(mesh::ThreadPartition& partition, int steps, double& dt,
+             std::vector<double>& u, std::vector<std::string>& errors) {
+    int domains = partition.domains();
+    std::vector<boost::shared_ptr<mesh::Mesh> > meshes(domains);
+    std::vector<double> times(domains, 0.);
+    u.assign(partition.mesh().nodes(), 0.);
+    errors.assign(domains, std::string());
+
+    // every domain must have its own thread, or making the meshes and
+    // exchanging the halos never end
+    int started = 0;
+    omp_set_dynamic(0);
+    #pragma omp parallel num_threads(domains)
+    {
+        int p = omp_get_thread_num();
+        #pragma omp single
+        started = omp_get_num_threads();
+        if (started == domains) {
+            try {
+                meshes[p].reset(new mesh::Mesh(partition, p));
+            } catch (const std::exception& e) {
+                errors[p] = e.what();
+            }
+        }
+    }
+    if (started != domains)
+        return -1.;
+    for (int p = 0; p < domains; ++p)
+        if (!errors[p].empty())
+            return 0.;
+
+    std::vector<mesh::Pattern> patterns(domains);
+    for (int p = 0; p < domains; ++p)
+        patterns[p] = meshes[p]->node_pattern();
+    mpi::ThreadDomains threads(patterns);
+    if (dt == 0.)
+        dt = stable_step(*meshes[0]);
+
+    #pragma omp parallel num_threads(domains)
+    {
+        int p = omp_get_thread_num();
+        const mesh::Mesh& m = *meshes[p];
+        NodeComm comm(threads, p);
+        Diffusion physics;
+        ForwardEuler integrator(m, dt);
+        Solver solver(m, physics, integrator, 0., comm);
+
+        #pragma omp barrier
+        double start = omp_get_wtime();
+        for (int s = 0; s < steps; ++s)
+            solver.advance();
+        times[p] = omp_get_wtime() - start;
+
+        std::vector<double> u_local, up_local;
+        solver.state(u_local, up_local);
+        for (int i = 0; i < m.local_nodes(); ++i)
+            u[m.node_source_id(i)] = u_local[i];
+    }
+    return *std::max_element(times.begin(), times.end()) / steps;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3 || std::atoi(argv[2]) < 1) {
+        std::cerr << "usage : " << argv[0] << " meshname domains [steps]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int domains = std::atoi(argv[2]);
+    int steps = argc > 3 ? std::atoi(argv[3]) : 100;
+
+    boost::shared_ptr<mesh::GlobalMesh> global;
+    std::vector<int> part;
+    try {
+        std::string filename = meshname + ".mesh";
+        if (!std::ifstream(filename.c_str()))
+            filename = meshname + ".msh";
+        global.reset(new mesh::GlobalMesh(filename));
+
+        std::vector<mesh::Point> points(global->nodes());
+        for (int i = 0; i < global->nodes(); ++i)
+            points[i] = global->point(i);
+        mesh::rcb_partition(points, global->dim(), std::vector<double>(), domains, false, part);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR : " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the same steps on one domain, then on the thread domains
+    mesh::ThreadPartition whole(*global, std::vector<int>(global->nodes(), 0), 1);
+    mesh::ThreadPartition partition(*global, part, domains);
+    const int methods = 2;
+    mesh::ThreadPartition* partitions[methods] = {&whole, &partition};
+    const char* names[methods] = {"one domain", "threads"};
+    double dt = 0.;
+    double times[methods];
+    std::vector<double> u[methods];
+    for (int method = 0; method < methods; ++method) {
+        std::vector<std::string> errors;
+        times[method] = solve(*partitions[method], steps, dt, u[method], errors);
+        if (times[method] < 0.) {
+            std::cerr << "ERROR : not enough threads for " << partitions[method]->domains()
+                      << " domains" << std::endl;
+            return EXIT_FAILURE;
+        }
+        for (int p = 0; p < int(errors.size()); ++p) {
+            if (!errors[p].empty()) {
+                std::cerr << "ERROR : domain " << p << " : " << errors[p] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    double diff = 0., largest = 0.;
+    for (int i = 0; i < global->nodes(); ++i) {
+        diff = std::max(diff, std::fabs(u[1][i] - u[0][i]));
+        largest = std::max(largest, std::fabs(u[0][i]));
+    }
+    double relative = largest > 0. ? diff / largest : diff;
+
+    std::cout << "mesh " << meshname << " on " << domains << " thread domains, "
+              << steps << " steps of " << dt << std::endl
+              << std::setw(12) << "method"
+              << std::setw(16) << "step (ms)" << std::endl;
+    for (int method = 0; method < methods; ++method)
+        std::cout << std::setw(12) << names[method]
+                  << std::setw(16) << std::setprecision(4)
+                  << 1e3*times[method] << std::endl;
+    std::cout << "largest relative difference " << relative << std::endl;
+    // !(relative <= tol) also catches a solution that is not a number
+    if (!(relative <= 1e-10)) {
+        std::cerr << "ERROR : the thread domains differ from one domain" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -277,6 +277,7 @@ namespace fvmpor {
 
         // spatial weightings
         CV_up.resize(m.local_nodes());
+        CV_up_edge.resize(m.local_nodes());
         CV_flux.resize(m.nodes()); 
         CV_flux_comm_tag = node_comm_.vec_add(CV_flux.data());
 
@@ -349,6 +350,8 @@ namespace fvmpor {
         std::vector<std::map<int,int> > nodes_idx;
         nodes_idx.resize(num_zones);
         // compile index and weight information mapping node information to scv information
+        // each node is in the index of a zone at most once, so the scvs of a zone can be
+        // added to the CV-averaged vectors on many threads (see process_volumes_psk)
         //for(int i=0; i<m.local_nodes(); i++){
         for(int i=0; i<m.nodes(); i++){
             const mesh::Volume& cv = m.volume(i);
@@ -388,7 +391,7 @@ namespace fvmpor {
         faceEdge_map_front.resize(num_zones);
         faceEdge_map_back.resize(num_zones);
         for( int i=0; i<m.edges(); i++ ){
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(i);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(i);
             int fid = m.edge(i).front().id();
             int bid = m.edge(i).back().id();
             for(int j=0; j<edge_cvfaces.size(); j++){
@@ -475,7 +478,7 @@ namespace fvmpor {
         for( int e=0; e<m.edges(); e++ ){
             double rho_edge = rho_vec[edge_node_back_[e]]*edge_weight_back_[e] + rho_vec[edge_node_front_[e]]*edge_weight_front_[e];
 
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(e);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(e);
             for(int j=0; j<edge_cvfaces.size(); j++){
                 int face = edge_cvfaces[j];
                 rho_faces_lim[ face ] = rho_edge;
@@ -633,22 +636,39 @@ namespace fvmpor {
                 for(int i=0; i<m.local_nodes(); i++){
                     CV_flux[i] = 0.;
                     CV_up[i] = -1.;
+                    CV_up_edge[i] = -1;
                 }
-                // set the flux into each boundary node to be that from over the boundary
-                for(int i=m.interior_cvfaces(); i<m.cvfaces(); i++){
-                    int n=m.cvface(i).back().id();
-                    CV_flux[n] -= qdotn_faces[i];
+                // set the flux into each boundary node to be that from over the boundary,
+                // one CV face colour at a time so that the threads update different nodes
+                for(int c=0; c<m.cvface_colours(); c++){
+                    mesh::IndexRange colour = m.cvface_colour(c);
+                    int first = std::lower_bound(colour.begin(), colour.end(), m.interior_cvfaces()) - colour.begin();
+                    #pragma omp parallel for schedule(static)
+                    for(int k=first; k<colour.size(); k++){
+                        int i = colour[k];
+                        int n=m.cvface(i).back().id();
+                        CV_flux[n] -= qdotn_faces[i];
+                    }
                 }
 
-                // now find max flux into each CV
-                for(int i=0; i<m.edges(); i++){
-                    if( edge_node_front_[i]<m.local_nodes() || edge_node_back_[i]<m.local_nodes() ){
-                        int CV = edge_down[i];
-                        if( CV<m.local_nodes() ){
-                            double fl = fabs(edge_flux[i]);
-                            if( fl>CV_flux[CV] ){
-                                CV_flux[CV] = fl;
-                                CV_up[CV] = edge_up[i];
+                // now find max flux into each CV, one edge colour at a
+                // time so that the threads update different CVs.  Ties go
+                // to the edge with the lowest id, as they would in a loop
+                // over the edges in order, whatever the colour of each.
+                for(int c=0; c<m.edge_colours(); c++){
+                    mesh::IndexRange colour = m.edge_colour(c);
+                    #pragma omp parallel for schedule(static)
+                    for(int k=0; k<colour.size(); k++){
+                        int i = colour[k];
+                        if( edge_node_front_[i]<m.local_nodes() || edge_node_back_[i]<m.local_nodes() ){
+                            int CV = edge_down[i];
+                            if( CV<m.local_nodes() ){
+                                double fl = fabs(edge_flux[i]);
+                                if( fl>CV_flux[CV] || (fl==CV_flux[CV] && CV_up_edge[CV]>i) ){
+                                    CV_flux[CV] = fl;
+                                    CV_up[CV] = edge_up[i];
+                                    CV_up_edge[CV] = i;
+                                }
                             }
                         }
                     }
@@ -733,15 +753,15 @@ namespace fvmpor {
             theta_scv[zone] = phi_scv[zone];
             theta_scv[zone] *= Sw_scv[zone];
 
-            // copy into global vector
-            phi_vec.permute_add_weighted_inverse(phi_scv[zone], index_scv[zone], weight_scv[zone]);
-            dphi_vec.permute_add_weighted_inverse(dphi_scv[zone], index_scv[zone], weight_scv[zone]);
-            Sw_vec.permute_add_weighted_inverse(Sw_scv[zone], index_scv[zone], weight_scv[zone]);
-            dSw_vec.permute_add_weighted_inverse(dSw_scv[zone], index_scv[zone], weight_scv[zone]);
-            theta_vec.permute_add_weighted_inverse(theta_scv[zone], index_scv[zone], weight_scv[zone]);
+            // copy into global vector, a zone has each node and CV face at most once
+            phi_vec.permute_add_weighted_inverse_distinct(phi_scv[zone], index_scv[zone], weight_scv[zone]);
+            dphi_vec.permute_add_weighted_inverse_distinct(dphi_scv[zone], index_scv[zone], weight_scv[zone]);
+            Sw_vec.permute_add_weighted_inverse_distinct(Sw_scv[zone], index_scv[zone], weight_scv[zone]);
+            dSw_vec.permute_add_weighted_inverse_distinct(dSw_scv[zone], index_scv[zone], weight_scv[zone]);
+            theta_vec.permute_add_weighted_inverse_distinct(theta_scv[zone], index_scv[zone], weight_scv[zone]);
 
-            krw_faces_lim.permute_add_weighted_pqr(krw_scv[zone], q_front_[zone], n_front_[zone], p_front_[zone], edge_weight_front_);
-            krw_faces_lim.permute_add_weighted_pqr(krw_scv[zone], q_back_[zone],  n_back_[zone],  p_back_[zone],  edge_weight_back_);
+            krw_faces_lim.permute_add_weighted_pqr_distinct(krw_scv[zone], q_front_[zone], n_front_[zone], p_front_[zone], edge_weight_front_);
+            krw_faces_lim.permute_add_weighted_pqr_distinct(krw_scv[zone], q_back_[zone],  n_back_[zone],  p_back_[zone],  edge_weight_back_);
         }
         // find the CV-averaged density - this is much simpler because density is not dependant on material properties
         // of the porous medium
@@ -856,7 +876,7 @@ namespace fvmpor {
         weights_fl.resize(ja_length);
 
         for(int i=0; i<m.edges(); i++){
-            const std::vector<int>& faces = m.edge_cvface(i);
+            mesh::IndexRange faces = m.edge_cvface(i);
 
             // determine the total surface area of the faces attached to edge i
             double total_area = 0.;
@@ -20,15 +20,18 @@
 #include <fvm/physics_base.h>
 
 #include <util/intvector.h>
+#include <util/cost_recorder.h>
 #include <util/interpolation.h>
 #include <util/dimvector.h>
 
 #include <mkl_spblas.h>
 #include <mkl_service.h>
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
 
 namespace fvmpor {
 
@@ -73,6 +76,9 @@ protected:
     // communicator for global communication of doubles on the nodes
     mpi::Communicator<double> node_comm_;
 
+    // measured cost of each node during a calibration window
+    util::CostRecorder cost_;
+
     // physical definitions
     int dimension;
     std::vector<PhysicalZone> physical_zones_;
@@ -86,6 +92,7 @@ protected:
     // spatial weighting
     SpatialWeightType spatial_weighting;
     IntVector CV_up; // DEVICE
+    IntVector CV_up_edge; // DEVICE
     TVec CV_flux; // DEVICE
     int CV_flux_comm_tag;
     IntVector edge_up; // DEVICE
@@ -167,6 +174,38 @@ public:
     VarSatPhysics() : num_calls(0) {};
     int calls() const { return num_calls; }
 
+    // measure the cost of each node over the next evaluations residual
+    // evaluations: unsaturated zones, multi-zone volumes and Dirichlet/seepage
+    // nodes cost more than the rest
+    void calibrate_cost(const mesh::Mesh& m, int evaluations) {
+        this->cost_.calibrate(m.local_nodes(), evaluations);
+    }
+    int cost_evaluations() const { return this->cost_.evaluations(); }
+    // save the measured cost as node weights for partitioning the next run
+    // (see mesh::Mesh::save_node_weights), collective
+    void save_cost(const mesh::Mesh& m, const std::string& filename) const {
+        m.save_node_weights(filename, this->cost_.cost());
+    }
+    // mean cost of each local node per evaluation in the calibration window
+    std::vector<double> node_cost() const { return this->cost_.cost(); }
+
+    // the state of the physics at the local nodes that is not part of the
+    // solution, i.e. whether each seepage node is currently treated as
+    // Dirichlet, so that it can move with the solution when the mesh is
+    // repartitioned
+    void node_state(const mesh::Mesh& m, std::vector<double>& state) const {
+        state.assign(m.local_nodes(), 0.);
+        for( int i=0; i<m.local_nodes(); i++ )
+            state[i] = is_dirichlet_h_vec[i];
+    }
+    void set_node_state(const mesh::Mesh& m, const std::vector<double>& state) {
+        assert( int(state.size())==m.local_nodes() );
+        for( int i=0; i<seepage_nodes.size(); i++ ){
+            int node = seepage_nodes[i];
+            is_dirichlet_h_vec[node] = int(state[node]);
+        }
+    }
+
     /////////////////////////////////
     // GLOBAL
     /////////////////////////////////
@@ -306,6 +345,7 @@ public:
 
         // spatial weightings
         CV_up.resize(m.local_nodes());
+        CV_up_edge.resize(m.local_nodes());
         CV_flux.resize(m.nodes()); 
         CV_flux_comm_tag = node_comm_.vec_add(CV_flux.data());
 
@@ -378,6 +418,8 @@ public:
         std::vector<std::map<int,int> > nodes_idx;
         nodes_idx.resize(num_zones);
         // compile index and weight information mapping node information to scv information
+        // each node is in the index of a zone at most once, so the scvs of a zone can be
+        // added to the CV-averaged vectors on many threads (see process_volumes_psk)
         //for(int i=0; i<m.local_nodes(); i++){
         for(int i=0; i<m.nodes(); i++){
             const mesh::Volume& cv = m.volume(i);
@@ -417,7 +459,7 @@ public:
         faceEdge_map_front.resize(num_zones);
         faceEdge_map_back.resize(num_zones);
         for( int i=0; i<m.edges(); i++ ){
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(i);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(i);
             int fid = m.edge(i).front().id();
             int bid = m.edge(i).back().id();
             for(int j=0; j<edge_cvfaces.size(); j++){
@@ -474,12 +516,14 @@ public:
         qsat_faces_.set(m.interior_cvfaces(), m.dim());
 
         norm_faces_.set(m.interior_cvfaces(), m.dim());
+        const std::vector<double>& nrm_x = m.cvface_normal_x();
+        const std::vector<double>& nrm_y = m.cvface_normal_y();
+        const std::vector<double>& nrm_z = m.cvface_normal_z();
         for( int i=0; i<m.interior_cvfaces(); i++ ){
-            Point nrm = m.cvface(i).normal();
-            norm_faces_.x()[i] = nrm.x;
-            norm_faces_.y()[i] = nrm.y;
+            norm_faces_.x()[i] = nrm_x[i];
+            norm_faces_.y()[i] = nrm_y[i];
             if( m.dim()==3 )
-                norm_faces_.z()[i] = nrm.z;
+                norm_faces_.z()[i] = nrm_z[i];
         }
 
         K_faces_.set(m.interior_cvfaces(), m.dim());
@@ -504,7 +548,7 @@ public:
         for( int e=0; e<m.edges(); e++ ){
             double rho_edge = rho_vec[edge_node_back_[e]]*edge_weight_back_[e] + rho_vec[edge_node_front_[e]]*edge_weight_front_[e];
 
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(e);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(e);
             for(int j=0; j<edge_cvfaces.size(); j++){
                 int face = edge_cvfaces[j];
                 rho_faces_lim[ face ] = rho_edge;
@@ -576,6 +620,7 @@ public:
             }
         }
 
+        cost_.charge_all();
         for( int i=m.interior_cvfaces(); i<m.cvfaces(); i++)
         {
             const mesh::CVFace& cvf = m.cvface(i);
@@ -604,6 +649,7 @@ public:
                     }
                 }
                 qdotn_faces[i] = -total_flux / total_area * cvf.area();
+                cost_.charge(cvf.back().id());
             }
         }
 
@@ -668,22 +714,39 @@ public:
                 for(int i=0; i<m.local_nodes(); i++){
                     CV_flux[i] = 0.;
                     CV_up[i] = -1.;
+                    CV_up_edge[i] = -1;
                 }
-                // set the flux into each boundary node to be that from over the boundary
-                for(int i=m.interior_cvfaces(); i<m.cvfaces(); i++){
-                    int n=m.cvface(i).back().id();
-                    CV_flux[n] -= qdotn_faces[i];
+                // set the flux into each boundary node to be that from over the boundary,
+                // one CV face colour at a time so that the threads update different nodes
+                for(int c=0; c<m.cvface_colours(); c++){
+                    mesh::IndexRange colour = m.cvface_colour(c);
+                    int first = std::lower_bound(colour.begin(), colour.end(), m.interior_cvfaces()) - colour.begin();
+                    #pragma omp parallel for schedule(static)
+                    for(int k=first; k<colour.size(); k++){
+                        int i = colour[k];
+                        int n=m.cvface(i).back().id();
+                        CV_flux[n] -= qdotn_faces[i];
+                    }
                 }
 
-                // now find max flux into each CV
-                for(int i=0; i<m.edges(); i++){
-                    if( edge_node_front_[i]<m.local_nodes() || edge_node_back_[i]<m.local_nodes() ){
-                        int CV = edge_down[i];
-                        if( CV<m.local_nodes() ){
-                            double fl = fabs(edge_flux[i]);
-                            if( fl>CV_flux[CV] ){
-                                CV_flux[CV] = fl;
-                                CV_up[CV] = edge_up[i];
+                // now find max flux into each CV, one edge colour at a
+                // time so that the threads update different CVs.  Ties go
+                // to the edge with the lowest id, as they would in a loop
+                // over the edges in order, whatever the colour of each.
+                for(int c=0; c<m.edge_colours(); c++){
+                    mesh::IndexRange colour = m.edge_colour(c);
+                    #pragma omp parallel for schedule(static)
+                    for(int k=0; k<colour.size(); k++){
+                        int i = colour[k];
+                        if( edge_node_front_[i]<m.local_nodes() || edge_node_back_[i]<m.local_nodes() ){
+                            int CV = edge_down[i];
+                            if( CV<m.local_nodes() ){
+                                double fl = fabs(edge_flux[i]);
+                                if( fl>CV_flux[CV] || (fl==CV_flux[CV] && CV_up_edge[CV]>i) ){
+                                    CV_flux[CV] = fl;
+                                    CV_up[CV] = edge_up[i];
+                                    CV_up_edge[CV] = i;
+                                }
                             }
                         }
                     }
@@ -742,6 +805,9 @@ public:
         theta_vec = 0.;
         krw_faces_lim = 0.;
 
+        // the work so far in the evaluation is shared by every node
+        cost_.charge_all();
+
         // for each zone calucluate the scv-weighted derived quantities and add them to the appropriated CV-averaged vectors
         double T=0.;
         for( std::map<int, int>::iterator it=zones_map_.begin(); it!=zones_map_.end(); it++){
@@ -768,15 +834,18 @@ public:
             theta_scv[zone] = phi_scv[zone];
             theta_scv[zone] *= Sw_scv[zone];
 
-            // copy into global vector
-            phi_vec.permute_add_weighted_inverse(phi_scv[zone], index_scv[zone], weight_scv[zone]);
-            dphi_vec.permute_add_weighted_inverse(dphi_scv[zone], index_scv[zone], weight_scv[zone]);
-            Sw_vec.permute_add_weighted_inverse(Sw_scv[zone], index_scv[zone], weight_scv[zone]);
-            dSw_vec.permute_add_weighted_inverse(dSw_scv[zone], index_scv[zone], weight_scv[zone]);
-            theta_vec.permute_add_weighted_inverse(theta_scv[zone], index_scv[zone], weight_scv[zone]);
+            // copy into global vector, a zone has each node and CV face at most once
+            phi_vec.permute_add_weighted_inverse_distinct(phi_scv[zone], index_scv[zone], weight_scv[zone]);
+            dphi_vec.permute_add_weighted_inverse_distinct(dphi_scv[zone], index_scv[zone], weight_scv[zone]);
+            Sw_vec.permute_add_weighted_inverse_distinct(Sw_scv[zone], index_scv[zone], weight_scv[zone]);
+            dSw_vec.permute_add_weighted_inverse_distinct(dSw_scv[zone], index_scv[zone], weight_scv[zone]);
+            theta_vec.permute_add_weighted_inverse_distinct(theta_scv[zone], index_scv[zone], weight_scv[zone]);
+
+            krw_faces_lim.permute_add_weighted_pqr_distinct(krw_scv[zone], q_front_[zone], n_front_[zone], p_front_[zone], edge_weight_front_);
+            krw_faces_lim.permute_add_weighted_pqr_distinct(krw_scv[zone], q_back_[zone],  n_back_[zone],  p_back_[zone],  edge_weight_back_);
 
-            krw_faces_lim.permute_add_weighted_pqr(krw_scv[zone], q_front_[zone], n_front_[zone], p_front_[zone], edge_weight_front_);
-            krw_faces_lim.permute_add_weighted_pqr(krw_scv[zone], q_back_[zone],  n_back_[zone],  p_back_[zone],  edge_weight_back_);
+            // the nodes of the zone share its cost
+            cost_.charge(index_scv[zone]);
         }
         // find the CV-averaged density - this is much simpler because density is not dependant on material properties
         // of the porous medium
@@ -892,7 +961,7 @@ public:
         weights_fl.resize(ja_length);
 
         for(int i=0; i<m.edges(); i++){
-            const std::vector<int>& faces = m.edge_cvface(i);
+            mesh::IndexRange faces = m.edge_cvface(i);
 
             // determine the total surface area of the faces attached to edge i
             double total_area = 0.;
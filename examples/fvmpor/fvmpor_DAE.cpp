@@ -20,6 +20,10 @@
 #include <sstream>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <memory>
+#include <vector>
 
 template<typename T> std::string to_string(const T& t){
     std::ostringstream oss;
@@ -74,9 +78,114 @@ void print_ida_stats(void *ida_mem)
     fprintf(stdout, "ncfn    = %5ld     ncfl    = %5ld\n\n", ncfn, ncfl);
 }
 
+namespace {
+
+using namespace fvmpor;
+
+#ifdef PRECON
+typedef fvm::IDAIntegrator<Physics, Preconditioner> Integrator;
+#else
+typedef fvm::IDAIntegrator<Physics> Integrator;
+#endif
+typedef fvm::Solver<Physics, Integrator> Solver;
+
+// The objects of a run, in the order they are made.  Each holds references
+// to the ones before it, so to move the run to a new partition of the mesh
+// they are all made again on the new mesh and the solution is copied over.
+struct Simulation{
+    std::auto_ptr<mesh::Mesh> mesh;
+    std::auto_ptr<Physics> physics;
+#ifdef PRECON
+    std::auto_ptr<Preconditioner> preconditioner;
+#endif
+    std::auto_ptr<Integrator> integrator;
+    std::auto_ptr<Solver> solver;
+
+    double reltol, abstol;
+    double maxTimestep;
+    int maxOrder;
+
+    Simulation(double reltol, double abstol, double maxTimestep, int maxOrder)
+        : reltol(reltol), abstol(abstol), maxTimestep(maxTimestep), maxOrder(maxOrder) {}
+
+    // take ownership of m and set up the run on it
+    void build(mesh::Mesh* m){
+        solver.reset();
+        integrator.reset();
+#ifdef PRECON
+        preconditioner.reset();
+#endif
+        physics.reset();
+        mesh.reset(m);
+
+        physics.reset(new Physics);
+        *mesh->mpicomm() << "initialised physics" << std::endl;
+#ifdef PRECON
+        preconditioner.reset(new Preconditioner(*physics));
+        *mesh->mpicomm() << "initialised preconditioner" << std::endl;
+        integrator.reset(new Integrator(*mesh, *physics, *preconditioner, reltol, abstol));
+#else
+        integrator.reset(new Integrator(*mesh, *physics, reltol, abstol));
+#endif
+        *mesh->mpicomm() << "initialised integrator" << std::endl;
+        solver.reset(new Solver(*mesh, *physics, *integrator));
+        *mesh->mpicomm() << "initialised solver" << std::endl;
+
+        if(maxTimestep>0.)
+            integrator->set_max_timestep(maxTimestep);
+        if(maxOrder!=5)
+            integrator->set_max_order(maxOrder);
+    }
+
+    // ratio of the largest residual time of a domain to the mean
+    double imbalance() const{
+        double local = solver->residual_time();
+        double max_time, sum_time;
+        MPI_Comm comm = mesh->mpicomm()->communicator();
+        MPI_Allreduce(&local, &max_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+        MPI_Allreduce(&local, &sum_time, 1, MPI_DOUBLE, MPI_SUM, comm);
+        if( sum_time<=0. )
+            return 1.;
+        return max_time*mesh->mpicomm()->size()/sum_time;
+    }
+
+    // repartition the global mesh file meshname so that the residual time of
+    // the domains is balanced, and carry on the run from the current solution
+    void rebalance(const std::string& meshname){
+        // share the residual time of each domain between its nodes in
+        // proportion to their measured cost
+        std::vector<double> cost = physics->node_cost();
+        double total = 0.;
+        for( int i=0; i<int(cost.size()); i++ )
+            total += cost[i];
+        int n = mesh->local_nodes();
+        double time = solver->residual_time();
+        std::vector<double> weights(n), global;
+        for( int i=0; i<n; i++ )
+            weights[i] = total>0. ? time*cost[i]/total : time/n;
+        mesh->global_node_weights(weights, global);
+
+        std::auto_ptr<mesh::Mesh> next(new mesh::Mesh(meshname, global, mesh->mpicomm()));
+
+        std::vector<double> u, up, state, u_next, up_next, state_next;
+        solver->state(u, up);
+        physics->node_state(*mesh, state);
+        next->import_node_values(*mesh, u, hM::variables, u_next);
+        next->import_node_values(*mesh, up, hM::variables, up_next);
+        next->import_node_values(*mesh, state, 1, state_next);
+        double t = solver->time();
+
+        build(next.release());
+        physics->set_node_state(*mesh, state_next);
+        solver->restart(t, u_next, up_next);
+    }
+};
+
+} // end anonymous namespace
+
 int main(int argc, char* argv[]) {
 
-    const char* usage = " meshfile finalTime [outfile]\n";
+    const char* usage = " meshfile finalTime [outfile] [-cost evaluations] [-rebalance ratio]\n";
 
     const double abstol = 1.0e-3;
     const double reltol = 1.0e-3;
@@ -87,6 +196,32 @@ try {
     mpi::Process process(argc, argv);
     mpi::MPICommPtr mpicomm( new mpi::MPIComm(MPI_COMM_WORLD, "WORLD") );
 
+    // -cost n measures the cost of each node over the first n residual
+    // evaluations and saves it to meshfile.weights, which balances the
+    // partition of the next run that partitions the mesh as it is loaded
+    // -rebalance r repartitions the mesh after an output interval in which
+    // the slowest domain spent more than r times the mean time computing
+    // residuals, using the cost of each node measured over the interval, and
+    // carries on from the current solution.  It needs the global mesh file
+    // meshfile.msh or meshfile.mesh.
+    int cost_evaluations = 0;
+    double rebalance_ratio = 0.;
+    std::vector<char*> args(argv, argv+argc);
+    for( int i=1; i+1<int(args.size()); ){
+        std::string arg(args[i]);
+        if( arg=="-cost" )
+            cost_evaluations = std::atoi(args[i+1]);
+        else if( arg=="-rebalance" )
+            rebalance_ratio = std::atof(args[i+1]);
+        else{
+            i++;
+            continue;
+        }
+        args.erase(args.begin()+i, args.begin()+i+2);
+    }
+    argc = args.size();
+    argv = &args[0];
+
     if (argc < 3 || argc > 4) {
         std::cerr << "Usage: " << argv[0] << usage << std::endl;
         return EXIT_FAILURE;
@@ -99,30 +234,12 @@ try {
         return EXIT_FAILURE;
     }
 
-    // Load mesh
-    mesh::Mesh mesh(argv[1], mpicomm);
-    *mpicomm << "loaded mesh" << std::endl;
-#ifdef PRECON
-    typedef fvm::IDAIntegrator<Physics, Preconditioner> Integrator;
-    typedef fvm::Solver<Physics, Integrator> Solver;
-    Physics physics;
-    Preconditioner preconditioner(physics);
-    Integrator integrator(mesh, physics, preconditioner, reltol, abstol);
-    Solver solver(mesh, physics, integrator);
-#else
-    typedef fvm::IDAIntegrator<Physics> Integrator;
-    typedef fvm::Solver<Physics, Integrator> Solver;
-    Physics physics;
-    Integrator integrator(mesh, physics, reltol, abstol);
-    Solver solver(mesh, physics, integrator);
-#endif
-
     double maxTimestep = 0.;
     int maxOrder = 3;
-    if(maxTimestep>0.)
-        integrator.set_max_timestep(maxTimestep);
-    if(maxOrder!=5)
-        integrator.set_max_order(maxOrder);
+
+    // Load mesh and set up the run on it
+    Simulation sim(reltol, abstol, maxTimestep, maxOrder);
+    sim.build(new mesh::Mesh(argv[1], mpicomm));
 
     std::string filename;
     bool output_run = false;
@@ -131,19 +248,24 @@ try {
         filename = std::string(argv[3]);
     }
 
+    // rebalancing measures the cost of each node over every interval
+    int calibration = cost_evaluations>0 ? cost_evaluations : INT_MAX;
+    if( cost_evaluations>0 || rebalance_ratio>0. )
+        sim.physics->calibrate_cost(*sim.mesh, calibration);
+
     // save the initial conditions
     util::Solution<hM> solution(mpicomm);
-    double t0 = solver.time();
+    double t0 = sim.solver->time();
     if(output_run){
-        solution.add( t0, solver.begin(), solver.end_ext() );
-        solution.write_timestep_VTK_XML( 0, mesh, filename );
+        solution.add( t0, sim.solver->begin(), sim.solver->end_ext() );
+        solution.write_timestep_VTK_XML( 0, *sim.mesh, filename );
     }
     int nt = 11;
 
     // initialise mass balance stats, and store for t0
     DoubleVector fluid_mass(nt+1);
     DoubleVector time_vec(nt+1);
-    fluid_mass[0] = physics.compute_mass(mesh, solver.begin());
+    fluid_mass[0] = sim.physics->compute_mass(*sim.mesh, sim.solver->begin());
     time_vec[0] = t0;
 
     // timestep the solution
@@ -152,6 +274,10 @@ try {
     double startTime = MPI_Wtime();
     for( int i=0; i<nt; i++ )
     {
+        mesh::Mesh& mesh = *sim.mesh;
+        Physics& physics = *sim.physics;
+        Solver& solver = *sim.solver;
+
         if( mpicomm->rank() == 0 )
             std::cout << "starting timestep at time " << nextTime-dt << "( " << solver.time() << ")" << std::endl;
 
@@ -166,11 +292,45 @@ try {
         fluid_mass[i+1] = physics.compute_mass(mesh, solver.begin());
         time_vec[i+1] = nextTime;
         nextTime = t0 + (double)(i+2)*dt;
+
+        // move the run to a new partition of the mesh if the domains are
+        // out of balance
+        if( rebalance_ratio>0. && i+1<nt ){
+            double imbalance = sim.imbalance();
+            if( mpicomm->rank()==0 )
+                std::cout << "residual time imbalance " << imbalance << std::endl;
+            if( imbalance>rebalance_ratio ){
+                sim.rebalance(argv[1]);
+                if( mpicomm->rank()==0 )
+                    std::cout << "rebalanced the mesh at time " << sim.solver->time() << std::endl;
+            }
+            sim.solver->reset_residual_time();
+            sim.physics->calibrate_cost(*sim.mesh, calibration);
+        }
     }
+
+    mesh::Mesh& mesh = *sim.mesh;
+    Physics& physics = *sim.physics;
+    Integrator& integrator = *sim.integrator;
+#ifdef PRECON
+    Preconditioner& preconditioner = *sim.preconditioner;
+#endif
     double finalTime = MPI_Wtime() - startTime;
     if( mpicomm->rank()==0)
         std::cout << std::endl << "Simulation took : " << finalTime << " seconds" << std::endl;
 
+    // with FVM_COMM_PROFILE set, the time spent in the halo exchange
+    sim.solver->report_communication(std::cout, std::string(argv[1]) + "_comm.csv");
+
+    // save the measured cost of each node
+    if( cost_evaluations>0 ){
+        std::string weightname = std::string(argv[1]) + ".weights";
+        physics.save_cost(mesh, weightname);
+        if( mpicomm->rank()==0 )
+            std::cout << "saved the cost of each node over " << physics.cost_evaluations()
+                      << " evaluations to " << weightname << std::endl;
+    }
+
     if( mpicomm->size()==1 ){
         // open file for output of stats
         std::ofstream mfid;
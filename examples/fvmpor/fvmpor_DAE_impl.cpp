@@ -118,6 +118,7 @@ namespace fvmpor {
                                         const_iterator u, const_iterator udash)
     {
         ++num_calls;
+        cost_.start();
 
         for (int i = 0; i < m.nodes(); ++i) {
             assert(u[i].h == u[i].h &&
@@ -149,6 +150,9 @@ namespace fvmpor {
         process_faces_lim( m );
         // compute fluxes
         process_fluxes( t, m );
+
+        cost_.charge_all();
+        cost_.finish_evaluation();
     }
 
     template<>
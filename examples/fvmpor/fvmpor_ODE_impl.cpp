@@ -91,6 +91,7 @@ namespace fvmpor {
                                         const_iterator u, const_iterator udash)
     {
         ++num_calls;
+        cost_.start();
 
         for (int i = 0; i < m.nodes(); ++i) {
             assert( u[i].h == u[i].h && u[i].h !=  std::numeric_limits<double>::infinity() && u[i].h != -std::numeric_limits<double>::infinity() );
@@ -121,6 +122,9 @@ namespace fvmpor {
 
         // compute fluxes
         process_fluxes( t, m );
+
+        cost_.charge_all();
+        cost_.finish_evaluation();
     }
 
     template<>
@@ -538,7 +538,7 @@ public:
         faceEdge_map_front.resize(num_zones);
         faceEdge_map_back.resize(num_zones);
         for( int i=0; i<m.edges(); i++ ){
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(i);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(i);
             int fid = m.edge(i).front().id();
             int bid = m.edge(i).back().id();
             for(int j=0; j<edge_cvfaces.size(); j++){
@@ -1052,7 +1052,7 @@ void VarSatPhysicsImpl<CoordHost,CoordDevice>::process_volumes_psk( const mesh::
         weights_fl = TVec(ja_length, 0.);
 
         for(int i=0; i<m.edges(); i++){
-            const std::vector<int>& faces = m.edge_cvface(i);
+            mesh::IndexRange faces = m.edge_cvface(i);
 
             // determine the total surface area of the faces attached to edge i
             double total_area = 0.;
@@ -434,7 +434,7 @@ public:
         faceEdge_map_front.resize(num_zones);
         faceEdge_map_back.resize(num_zones);
         for( int i=0; i<m.edges(); i++ ){
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(i);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(i);
             int fid = m.edge(i).front().id();
             int bid = m.edge(i).back().id();
             for(int j=0; j<edge_cvfaces.size(); j++){
@@ -544,7 +544,7 @@ public:
         for( int e=0; e<m.edges(); e++ ){
             double rho_edge = rho_vec.at(edge_node_back_[e])*edge_weight_back_.at(e) + rho_vec.at(edge_node_front_[e])*edge_weight_front_.at(e);
 
-            const std::vector<int>& edge_cvfaces = m.edge_cvface(e);
+            mesh::IndexRange edge_cvfaces = m.edge_cvface(e);
             for(int j=0; j<edge_cvfaces.size(); j++){
                 int face = edge_cvfaces[j];
                 rho_faces_lim.at( face ) = rho_edge;
@@ -962,7 +962,7 @@ public:
         weights_fl = TVec(ja_length, 0.);
 
         for(int i=0; i<m.edges(); i++){
-            const std::vector<int>& faces = m.edge_cvface(i);
+            mesh::IndexRange faces = m.edge_cvface(i);
 
             // determine the total surface area of the faces attached to edge i
             double total_area = 0.;
@@ -335,27 +335,36 @@ public:
 
 #include <util/checked_iterator.h>
 
+#include <cassert>
+
 namespace fvm {
 
 using util::checked_iterator;
 
-// Forward declaration
-template<class Physics>
-class SolverBase;
-
-// Residual function callback
+// Residual function callback, for a solver of any node communicator (see
+// SolverBase)
 template<class Physics>
 class Callback {
 public:
     typedef typename Physics::TVecDevice TVecDevice;
-    Callback() : solver() {};
-    Callback(SolverBase<Physics>* solver) : solver(solver) {};
+    Callback() : solver(), residual() {};
+    template<class Solver>
+    Callback(Solver* solver) : solver(solver), residual(&compute_residual<Solver>) {};
     // DEVICE
-    int operator()(TVecDevice &y, bool communicate);
+    int operator()(TVecDevice &y, bool communicate) {
+        assert(solver);
+        return residual(solver, y, communicate);
+    };
     //template<typename Iterator>
     //int operator()(Iterator it, bool communicate);
 private:
-    SolverBase<Physics>* solver;
+    template<class Solver>
+    static int compute_residual(void* solver, TVecDevice &y, bool communicate) {
+        return static_cast<Solver*>(solver)->compute_residual(y, communicate);
+    };
+
+    void* solver;
+    int (*residual)(void*, TVecDevice&, bool);
 };
 
 // Simple traits class
@@ -0,0 +1,204 @@
+/**************************************************************************
+ * The block assembler builds the residual from the per-entity callbacks
+ * documented in fvm.h, for physics that do not write their own
+ * residual_evaluation.  The callbacks are called in their batched forms
+ * (see PhysicsBase) over contiguous blocks of CV faces and control volumes,
+ * one block per thread at a time, and each control volume then gathers the
+ * fluxes of its own CV faces, so no two threads write the same value.
+ **************************************************************************/
+#ifndef BLOCK_ASSEMBLER_H
+#define BLOCK_ASSEMBLER_H
+
+#include <fvm/fvm.h>
+#include <fvm/mesh.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace fvm {
+
+// The residual at each local node i is that of the PDE f(u, du/dt) =
+// -div(j) + s averaged over its control volume,
+//
+//   res_i = source_i - lhs_i - 1/vol_i * sum_f flux_f * area_f * sign_f
+//
+// where the sum is over the CV faces f of the control volume, and sign_f is
+// +1 if the CV face normal points out of the control volume (node i is the
+// back node of f) and -1 if it points in.  For a variable that dirichlet()
+// flags at a boundary node the fluxes are left out, so that
+// res_i = source_i - lhs_i holds the condition.
+// The callbacks are called concurrently for different blocks, so they must
+// only write to the values they return.
+template<class Physics>
+class BlockAssembler {
+public:
+    typedef mesh::Mesh Mesh;
+
+    typedef typename Physics::value_type value_type;
+    typedef typename Physics::TVecDevice TVecDevice;
+
+    // number of CV faces or control volumes passed to each batched callback
+    enum {block_size = 256};
+
+    explicit BlockAssembler(const Mesh& m);
+    const Mesh& mesh() const;
+
+    // the residual at the local nodes
+    // sol, deriv: the values at every node of the domain, on the host
+    void residual(double t, Physics& p,
+                  const TVecDevice& sol, const TVecDevice& deriv,
+                  TVecDevice& res);
+
+private:
+    BlockAssembler(const BlockAssembler&);
+    BlockAssembler& operator=(const BlockAssembler&);
+
+    static const int variables_per_node = VariableTraits<value_type>::number;
+
+    static const double* values(const value_type& v) {
+        return reinterpret_cast<const double*>(&v);
+    }
+
+    const Mesh& m;
+
+    // the CV faces of each local node, in compressed sparse row format, with
+    // the weight sign_f * area_f / vol_i of each
+    std::vector<int> face_start;
+    std::vector<int> face_id;
+    std::vector<double> face_weight;
+
+    // local nodes on the boundary, where dirichlet() is asked
+    std::vector<int> boundary_nodes;
+
+    std::vector<value_type> flux;
+    std::vector<value_type> lhs;
+    std::vector<value_type> source;
+};
+
+template<class Physics>
+BlockAssembler<Physics>::BlockAssembler(const Mesh& m)
+    : m(m)
+{
+    const std::vector<int>& front = m.cvface_front_id();
+    const std::vector<int>& back = m.cvface_back_id();
+    const std::vector<double>& area = m.cvface_area();
+    const std::vector<double>& vol = m.volume_vol();
+    int N = m.local_nodes();
+
+    face_start.assign(N+1, 0);
+    for (int f = 0; f < m.cvfaces(); ++f) {
+        if (back[f] < N)
+            ++face_start[back[f]+1];
+        if (front[f] >= 0 && front[f] < N)
+            ++face_start[front[f]+1];
+    }
+    for (int i = 0; i < N; ++i)
+        face_start[i+1] += face_start[i];
+
+    // CV faces in ascending order for each node
+    std::vector<int> next(face_start.begin(), face_start.end()-1);
+    face_id.resize(face_start[N]);
+    face_weight.resize(face_start[N]);
+    for (int f = 0; f < m.cvfaces(); ++f) {
+        int i = back[f];
+        if (i < N) {
+            face_id[next[i]] = f;
+            face_weight[next[i]++] = -area[f] / vol[i];
+        }
+        i = front[f];
+        if (i >= 0 && i < N) {
+            face_id[next[i]] = f;
+            face_weight[next[i]++] = area[f] / vol[i];
+        }
+    }
+
+    for (int i = 0; i < N; ++i)
+        if (m.node(i).boundaries())
+            boundary_nodes.push_back(i);
+
+    flux.resize(m.cvfaces());
+    lhs.resize(N);
+    source.resize(N);
+}
+
+template<class Physics>
+const mesh::Mesh& BlockAssembler<Physics>::mesh() const {
+    return m;
+}
+
+template<class Physics>
+void BlockAssembler<Physics>::residual(
+    double t, Physics& p,
+    const TVecDevice& sol, const TVecDevice& deriv, TVecDevice& res)
+{
+    const int vars = variables_per_node;
+    int N = mesh().local_nodes();
+    int faces = mesh().cvfaces();
+    int interior = mesh().interior_cvfaces();
+    int face_blocks = (faces + block_size - 1) / block_size;
+    int volume_blocks = (N + block_size - 1) / block_size;
+
+    // the callbacks, a block at a time; a block that straddles the interior
+    // and boundary CV faces is passed to each callback in two parts
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic) nowait
+        for (int b = 0; b < face_blocks; ++b) {
+            int begin = b * block_size;
+            int end = std::min(faces, begin + block_size);
+            if (begin < interior)
+                p.flux_block(t, mesh(), begin, std::min(end, interior), sol, &flux[begin]);
+            if (end > interior) {
+                begin = std::max(begin, interior);
+                p.boundary_flux_block(t, mesh(), begin, end, sol, &flux[begin]);
+            }
+        }
+        #pragma omp for schedule(dynamic)
+        for (int b = 0; b < volume_blocks; ++b) {
+            int begin = b * block_size;
+            int end = std::min(N, begin + block_size);
+            p.lhs_block(t, mesh(), begin, end, sol, deriv, &lhs[begin]);
+            p.source_block(t, mesh(), begin, end, sol, &source[begin]);
+        }
+
+        // each control volume gathers the fluxes through its CV faces
+        double* r = res.data();
+        #pragma omp for schedule(static)
+        for (int i = 0; i < N; ++i) {
+            const double* l = values(lhs[i]);
+            const double* s = values(source[i]);
+            double sum[vars];
+            for (int k = 0; k < vars; ++k)
+                sum[k] = s[k] - l[k];
+            for (int j = face_start[i]; j < face_start[i+1]; ++j) {
+                const double* f = values(flux[face_id[j]]);
+                double w = face_weight[j];
+                for (int k = 0; k < vars; ++k)
+                    sum[k] += w * f[k];
+            }
+            for (int k = 0; k < vars; ++k)
+                r[i*vars + k] = sum[k];
+        }
+    }
+
+    // Dirichlet variables
+    double* r = res.data();
+    for (int n = 0; n < int(boundary_nodes.size()); ++n) {
+        int i = boundary_nodes[n];
+        value_type flags = p.dirichlet(t, mesh().node(i));
+        const double* d = values(flags);
+        const double* l = values(lhs[i]);
+        const double* s = values(source[i]);
+        for (int k = 0; k < vars; ++k)
+            if (d[k])
+                r[i*vars + k] = s[k] - l[k];
+    }
+}
+
+// Definition of static member
+template<class Physics>
+const int BlockAssembler<Physics>::variables_per_node;
+
+} // end namespace fvm
+
+#endif
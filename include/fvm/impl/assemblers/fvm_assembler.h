@@ -3,6 +3,10 @@
  * This allows the implementer of the physics to implement a more efficient
  * assembler than the default assembler, which can be orders of magnitude
  * faster for meshes with many control volume faces
+ *
+ * Physics derived from PhysicsBase that do not write their own
+ * residual_evaluation get the library's BlockAssembler (block_assembler.h),
+ * which builds the residual from the per-entity callbacks in fvm.h.
  **************************************************************************/
 #ifndef FVM_ASSEMBLER_H
 #define FVM_ASSEMBLER_H
@@ -31,6 +35,19 @@ public:
                           const TVecDevice &u,
                           const TVecDevice &up,
                           TVecDevice &res       );
+
+    // compute_residual() in two phases, so that the exchange of the values
+    // at the external nodes can overlap the first.  The interior phase only
+    // uses the values at the local nodes, the halo phase finishes the
+    // residual once the external values have arrived.
+    int compute_residual_interior( double time,
+                                   const TVecDevice &u,
+                                   const TVecDevice &up,
+                                   TVecDevice &res       );
+    int compute_residual_halo( double time,
+                               const TVecDevice &u,
+                               const TVecDevice &up,
+                               TVecDevice &res       );
 private:
     FVMAssembler(const FVMAssembler&);
     FVMAssembler& operator=(const FVMAssembler&);
@@ -82,6 +99,27 @@ int FVMAssembler<Physics>::compute_residual(
     return 0;
 }
 
+template<class Physics>
+int FVMAssembler<Physics>::compute_residual_interior(
+    double time, const TVecDevice &u, const TVecDevice &up, TVecDevice &res) {
+    // work that needs no external node values
+    physics().preprocess_evaluation_interior(time, mesh(), u, up);
+
+    return 0;
+}
+
+template<class Physics>
+int FVMAssembler<Physics>::compute_residual_halo(
+    double time, const TVecDevice &u, const TVecDevice &up, TVecDevice &res) {
+    // the rest of the preprocessing
+    physics().preprocess_evaluation_halo(time, mesh(), u, up);
+
+    // find the residual
+    physics().residual_evaluation(time, mesh(), u, up, res);
+
+    return 0;
+}
+
 // Definition of static member
 template<typename ValueType>
 const int FVMAssembler<ValueType>::variables_per_node;
@@ -38,7 +38,9 @@ private:
     // The mechanism for communicating the values and derivatives at external
     // nodes is rather crude.  We simply do an MPI gather all, so that each
     // process ends up with the values at all nodes.  It can then pull out the
-    // ones it needs.
+    // ones it needs.  HaloCommunicator does the same with memory and
+    // bandwidth in proportion to the halo, and GatherCommunicator collects
+    // values for output on one process.
     std::vector<value_type> global_values;
 
     // Local node counts and vtxdist scaled by variables_per_node
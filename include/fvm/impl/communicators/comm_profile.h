@@ -0,0 +1,166 @@
+#ifndef COMM_PROFILE_H
+#define COMM_PROFILE_H
+
+#include <mpi.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mpi {
+
+    // Counts the messages and bytes sent by a Communicator, and the time
+    // spent packing, unpacking and waiting, in total, for each vector or
+    // group tag and for each neighbour.  The time waited for a neighbour is
+    // the time from the start of a receive until its values arrived, so the
+    // slow neighbour is the one with the most.  Nothing is recorded unless
+    // the profile is enabled, by enable() or by setting the environment
+    // variable FVM_COMM_PROFILE when the Communicator is made.
+    class CommProfile{
+        public:
+            struct Counters{
+                Counters() : messages(0), bytes(0.), pack_time(0.), unpack_time(0.), wait_time(0.) {};
+                long messages;
+                double bytes;
+                double pack_time;
+                double unpack_time;
+                double wait_time;
+            };
+
+            CommProfile() : enabled_(std::getenv("FVM_COMM_PROFILE")!=0) {};
+
+            bool enabled() const {return enabled_;};
+            void enable(bool on) {enabled_ = on;};
+            void reset(){
+                total_ = Counters();
+                by_tag_.clear();
+                by_neighbour_.clear();
+            };
+
+            // the clock, which only runs when the profile is enabled
+            double now() const{
+                return enabled_ ? MPI_Wtime() : 0.;
+            };
+
+            // one message of bytes bytes was sent to neighbour for tag
+            void message(int tag, int neighbour, double bytes){
+                if( !enabled_ )
+                    return;
+                total_.messages++;
+                total_.bytes += bytes;
+                by_tag_[tag].messages++;
+                by_tag_[tag].bytes += bytes;
+                by_neighbour_[neighbour].messages++;
+                by_neighbour_[neighbour].bytes += bytes;
+            };
+            void pack(int tag, double t){
+                if( !enabled_ )
+                    return;
+                total_.pack_time += t;
+                by_tag_[tag].pack_time += t;
+            };
+            void unpack(int tag, double t){
+                if( !enabled_ )
+                    return;
+                total_.unpack_time += t;
+                by_tag_[tag].unpack_time += t;
+            };
+            void wait(int tag, double t){
+                if( !enabled_ )
+                    return;
+                total_.wait_time += t;
+                by_tag_[tag].wait_time += t;
+            };
+            void wait_for_neighbour(int neighbour, double t){
+                if( !enabled_ )
+                    return;
+                by_neighbour_[neighbour].wait_time += t;
+            };
+
+            const Counters& total() const {return total_;};
+            const std::map<int,Counters>& by_tag() const {return by_tag_;};
+            const std::map<int,Counters>& by_neighbour() const {return by_neighbour_;};
+
+            // print the min, mean and max of the totals over the processes
+            // of comm to out on process 0, and write the counters of every
+            // process to the file csvname (unless it is empty), one line for
+            // its total, each tag and each neighbour
+            // notes: collective, does nothing if the profile is not enabled
+            void report(MPI_Comm comm, std::ostream& out, const std::string& csvname) const;
+
+        private:
+            static void append(std::ostream& os, int rank, const char* kind, int id, const Counters& c){
+                os << rank << "," << kind << "," << id << ","
+                   << c.messages << "," << c.bytes << ","
+                   << c.pack_time << "," << c.unpack_time << "," << c.wait_time << "\n";
+            };
+
+            bool enabled_;
+            Counters total_;
+            std::map<int,Counters> by_tag_;
+            std::map<int,Counters> by_neighbour_;
+    };
+
+    inline void CommProfile::report(MPI_Comm comm, std::ostream& out, const std::string& csvname) const{
+        if( !enabled_ )
+            return;
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+
+        // table of the totals
+        const int fields = 5;
+        const char* names[fields] = {"messages", "MB", "pack (s)", "unpack (s)", "wait (s)"};
+        double local[fields] = {double(total_.messages), total_.bytes/1e6,
+                                total_.pack_time, total_.unpack_time, total_.wait_time};
+        double low[fields], high[fields], sum[fields];
+        MPI_Reduce(local, low, fields, MPI_DOUBLE, MPI_MIN, 0, comm);
+        MPI_Reduce(local, high, fields, MPI_DOUBLE, MPI_MAX, 0, comm);
+        MPI_Reduce(local, sum, fields, MPI_DOUBLE, MPI_SUM, 0, comm);
+        if( rank==0 ){
+            out << "communication profile over " << size << " processes" << std::endl
+                << std::setw(12) << " "
+                << std::setw(14) << "min"
+                << std::setw(14) << "avg"
+                << std::setw(14) << "max" << std::endl;
+            for( int i=0; i<fields; i++ )
+                out << std::setw(12) << names[i]
+                    << std::setw(14) << std::setprecision(6) << low[i]
+                    << std::setw(14) << std::setprecision(6) << sum[i]/size
+                    << std::setw(14) << std::setprecision(6) << high[i] << std::endl;
+        }
+        if( csvname.empty() )
+            return;
+
+        // gather the lines of every process to process 0, which writes them
+        std::ostringstream lines;
+        lines << std::setprecision(9);
+        append(lines, rank, "total", -1, total_);
+        for( std::map<int,Counters>::const_iterator it=by_tag_.begin(); it!=by_tag_.end(); it++ )
+            append(lines, rank, "tag", it->first, it->second);
+        for( std::map<int,Counters>::const_iterator it=by_neighbour_.begin(); it!=by_neighbour_.end(); it++ )
+            append(lines, rank, "neighbour", it->first, it->second);
+        std::string text = lines.str();
+
+        int length = text.size();
+        std::vector<int> lengths(size), displacements(size, 0);
+        MPI_Gather(&length, 1, MPI_INT, &lengths[0], 1, MPI_INT, 0, comm);
+        for( int i=1; i<size; i++ )
+            displacements[i] = displacements[i-1]+lengths[i-1];
+        std::vector<char> all(rank==0 ? displacements[size-1]+lengths[size-1]+1 : 1);
+        MPI_Gatherv(const_cast<char*>(text.data()), length, MPI_CHAR,
+                    &all[0], &lengths[0], &displacements[0], MPI_CHAR, 0, comm);
+        if( rank==0 ){
+            std::ofstream csv(csvname.c_str());
+            csv << "rank,kind,id,messages,bytes,pack_time,unpack_time,wait_time\n";
+            csv.write(&all[0], all.size()-1);
+            out << "wrote the communication profile of each process to " << csvname << std::endl;
+        }
+    }
+}
+#endif
@@ -2,10 +2,15 @@
 #define COMMUNICATOR_H
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <numeric>
 #include <vector>
 #include <map>
 
+#include <sched.h>
+
+#include <fvm/impl/communicators/comm_profile.h>
 #include <fvm/impl/communicators/pattern.h>
 #include <mpi/mpicomm.h>
 
@@ -44,6 +49,34 @@ namespace mpi {
         void set(MPI_Datatype T) {MPIType = T;};
     };
 
+    // how a Communicator exchanges halos
+    //  exchange_point_to_point : a persistent send and receive for each
+    //                            neighbour
+    //  exchange_neighbourhood  : one MPI-3 neighbourhood collective over a
+    //                            distributed graph of the Pattern, persistent
+    //                            if the MPI library supports MPI-4
+    //  exchange_shared_memory  : neighbours on the same node read the values
+    //                            sent to them straight out of an MPI-3 shared
+    //                            window, other neighbours are point-to-point
+    enum exchange_backend {exchange_point_to_point, exchange_neighbourhood, exchange_shared_memory};
+
+    // the backend of Communicators made from now on, which can be set by
+    // the environment variable FVM_HALO_EXCHANGE=neighbourhood or shared.
+    // It must be the same on every process.
+    inline exchange_backend& default_exchange_backend(){
+        static exchange_backend backend = exchange_point_to_point;
+        static bool initialised = false;
+        if( !initialised ){
+            const char* env = std::getenv("FVM_HALO_EXCHANGE");
+            if( env && std::strcmp(env, "neighbourhood")==0 )
+                backend = exchange_neighbourhood;
+            else if( env && std::strcmp(env, "shared")==0 )
+                backend = exchange_shared_memory;
+            initialised = true;
+        }
+        return backend;
+    }
+
     // communicator used to coordinate the communication of information
     // stored in arrays that have overlapping implied by a Pattern
     template <typename Coord, typename Type>
@@ -58,15 +91,46 @@ namespace mpi {
         typedef lin::Vector<int, lin::DefaultCoordinator<int> > TVecHostIndex;
         public:
             Communicator( const std::string &str, const mesh::Pattern& );
-            Communicator() : pattern_(0) {};
+            Communicator() : pattern_(0), pack_on_host_(false), backend_(default_exchange_backend()), graph_comm_(MPI_COMM_NULL), node_comm_(MPI_COMM_NULL) {};
+            ~Communicator();
             const mesh::Pattern& pattern() const;
             void set_pattern( const std::string &str, const mesh::Pattern& );
 
+            // choose how halos are exchanged, before any vectors are added
+            // notes: collective, every process must choose the same backend.
+            //        With exchange_shared_memory adding and removing vectors
+            //        and groups is also collective, as each has a window.
+            void set_backend( exchange_backend );
+            exchange_backend backend() const {return backend_;};
+
+            // whether vectors on the host are packed into contiguous buffers
+            // rather than sent with indexed MPI types.  This is chosen by
+            // timing both when the Communicator is made, and can be set
+            // before any vectors are added.  The neighbourhood backend
+            // always packs.
+            void set_host_packing( bool );
+            bool host_packing() const {return pack_on_host_;};
+
             // add and remove vectors to and from the communicator
             int vec_add(TVec&);
             int vec_remove(int);
 
+            // add and remove groups of vectors, whose halos are exchanged
+            // together in one message to each neighbour.  The tag returned
+            // by group_add() is passed to send() and recv() like that of a
+            // vector.  A vector can only be removed when it is in no group.
+            int group_add(const std::vector<int>&);
+            int group_remove(int);
+
             MPICommPtr mpicomm() const {return comm_;};
+
+            // counters of the messages, bytes and time spent by this
+            // communicator, see CommProfile
+            CommProfile& profile() {return profile_;};
+            const CommProfile& profile() const {return profile_;};
+            // notes: collective
+            void report_profile( std::ostream& out, const std::string& csvname ) const
+                {profile_.report(comm_->communicator(), out, csvname);};
             
             // communication
             int recv( int );
@@ -81,6 +145,40 @@ namespace mpi {
             void build_from_pattern();
             void build_on_host_from_pattern();
             void build_on_device_from_pattern();
+            void build_indexed_types();
+            void build_packed_index();
+            void build_contiguous_types();
+            void free_types();
+            bool packing_is_faster();
+            bool packed() const { return !data_on_host_ || pack_on_host_; };
+            // unpacked vectors are both the send and the receive buffer,
+            // which a neighbourhood collective may not be given
+            bool must_pack() const { return data_on_host_ && backend_==exchange_neighbourhood; };
+            void pack( int );
+            void unpack( int );
+            void pack_host( int );
+            void unpack_host( int );
+            void count_messages( int );
+            void wait_requests( int, std::vector<MPI_Request>&, std::vector<MPI_Request>& );
+            void init_requests( int );
+            void free_requests( int );
+            int next_tag() const;
+            void pack_device( int );
+            void unpack_device( int );
+            int send_group( int );
+            int recv_group( int );
+            void free_group( int );
+            void build_graph();
+            void start_neighbourhood( int );
+            void wait_neighbourhood( int );
+            void build_shared();
+            void init_shared( int, int );
+            void free_shared( int );
+            void publish_shared( int );
+            void collect_shared( int );
+            bool on_node( int i ) const { return backend_==exchange_shared_memory && node_rank_[i]>=0; };
+            template<typename T>
+            static T* data_or_null( std::vector<T>& v ) { return v.empty() ? 0 : &v[0]; };
 
             // the pattern that describes how to distribute
             // information to and from neighbours
@@ -88,6 +186,7 @@ namespace mpi {
 
             int block_size_;
             bool data_on_host_;
+            bool pack_on_host_;
 
             // a list of tags associated with the vectors using the communicator
             std::set<int> vectors_;
@@ -105,6 +204,8 @@ namespace mpi {
             std::map<int,int> recv_offset_;
             TVecIndex send_perm_;
             TVecIndex recv_perm_;
+            std::vector<int> host_send_perm_;
+            std::vector<int> host_recv_perm_;
 
             // the MPI communicator
             MPICommPtr comm_;
@@ -120,13 +221,80 @@ namespace mpi {
             std::map<int,std::vector<int> > recv_displacements_;
 
             // maps with vector tag as key and a vector of MPI_Request for each of sends and receives to neighbours
+            // the requests are persistent: they are made when the vector is
+            // added, and each exchange only starts and completes them
             std::map<int,std::vector<MPI_Request> > send_requests_;
             std::map<int,std::vector<MPI_Request> > recv_requests_;
+
+            // a group of vectors that are exchanged together: the values
+            // for each neighbour are packed, one vector after the other, into
+            // a contiguous block of the group's buffers, and sent with one
+            // persistent request
+            struct Group{
+                std::vector<int> members;
+                std::vector<baseT> send_buffer;
+                std::vector<baseT> recv_buffer;
+                // offset of each neighbour's block in the buffers
+                std::vector<int> send_offset;
+                std::vector<int> recv_offset;
+                std::vector<MPI_Datatype> send_type;
+                std::vector<MPI_Datatype> recv_type;
+                std::vector<MPI_Request> send_requests;
+                std::vector<MPI_Request> recv_requests;
+                // size of each neighbour's block, for MPI_Neighbor_alltoallv
+                std::vector<int> send_count;
+                std::vector<int> recv_count;
+            };
+            std::map<int,Group> groups_;
+
+            // the neighbourhood collective backend exchanges each vector or
+            // group with one request on a distributed graph communicator,
+            // whose neighbours are in the order of the Pattern.  The types
+            // for each neighbour are those of the point-to-point backend, at
+            // byte offsets in the send and receive buffers.
+            exchange_backend backend_;
+            MPI_Comm graph_comm_;
+            std::vector<int> graph_counts_;
+            std::vector<MPI_Aint> graph_send_offset_;
+            std::vector<MPI_Aint> graph_recv_offset_;
+            std::vector<MPI_Datatype> graph_send_type_;
+            std::vector<MPI_Datatype> graph_recv_type_;
+            std::map<int,MPI_Request> graph_requests_;
+
+            // the shared memory backend gives each vector or group a window
+            // on the processes of the node, into which the values for each
+            // neighbour on the node are copied, at shared_offset_ (times the
+            // number of vectors in a group).  The neighbour copies them out
+            // of the window at remote_offset_, the offset of its block in
+            // our window.  The window starts with two counters: the number
+            // of exchanges published, and the number of exchanges read from
+            // all of the neighbours on the node.  A process waits for its
+            // neighbours to publish before reading, and for them to have
+            // read before writing its window again.
+            struct SharedWindow{
+                MPI_Win win;
+                char* base;
+                std::vector<char*> remote_base;
+                long exchanges;
+            };
+            enum {shared_header=64};
+            static volatile long* published( char* base ) { return reinterpret_cast<volatile long*>(base); };
+            static volatile long* consumed( char* base ) { return reinterpret_cast<volatile long*>(base)+1; };
+            static baseT* shared_data( char* base ) { return reinterpret_cast<baseT*>(base+shared_header); };
+            static void wait_for( volatile long* counter, long value, MPI_Win win );
+            MPI_Comm node_comm_;
+            std::vector<int> node_rank_;
+            std::vector<int> shared_offset_;
+            std::vector<int> remote_offset_;
+            int shared_size_;
+            std::map<int,SharedWindow> shared_;
+
+            CommProfile profile_;
     };
 
     template<typename Coord, typename Type>
     Communicator<Coord, Type>::Communicator( const std::string &str, const mesh::Pattern& pat ) 
-        : pattern_(&pat)
+        : pattern_(&pat), pack_on_host_(false), backend_(default_exchange_backend()), graph_comm_(MPI_COMM_NULL), node_comm_(MPI_COMM_NULL)
     {
         name_ = pattern().comm()->name_short()+"_"+str;
         comm_ = pattern().comm()->duplicate(name_);
@@ -136,6 +304,58 @@ namespace mpi {
         build_from_pattern();
     }
 
+    template<typename Coord, typename Type>
+    Communicator<Coord, Type>::~Communicator()
+    {
+        for( typename std::map<int,Group>::iterator i=groups_.begin(); i!=groups_.end(); i++ )
+            free_group(i->first);
+        for( std::set<int>::iterator i=vectors_.begin(); i!=vectors_.end(); i++ )
+            free_requests(*i);
+        while( !shared_.empty() )
+            free_shared(shared_.begin()->first);
+        if( graph_comm_!=MPI_COMM_NULL )
+            MPI_Comm_free(&graph_comm_);
+        if( node_comm_!=MPI_COMM_NULL )
+            MPI_Comm_free(&node_comm_);
+        if( pattern_ )
+            free_types();
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::set_backend( exchange_backend backend )
+    {
+        assert( vectors_.empty() && groups_.empty() );
+        backend_ = backend;
+        if( pattern_ && must_pack() && !pack_on_host_ ){
+            pack_on_host_ = true;
+            free_types();
+            build_contiguous_types();
+            if( graph_comm_!=MPI_COMM_NULL )
+                build_graph();
+        }
+        if( pattern_ && backend_==exchange_neighbourhood && graph_comm_==MPI_COMM_NULL )
+            build_graph();
+        if( pattern_ && backend_==exchange_shared_memory && node_comm_==MPI_COMM_NULL )
+            build_shared();
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::set_host_packing( bool pack )
+    {
+        assert( vectors_.empty() && groups_.empty() );
+        if( !data_on_host_ || pack==pack_on_host_ || must_pack() )
+            return;
+        pack_on_host_ = pack;
+        free_types();
+        if( pack_on_host_ )
+            build_contiguous_types();
+        else
+            build_indexed_types();
+        // the graph holds the types
+        if( backend_==exchange_neighbourhood )
+            build_graph();
+    }
+
     template<typename Coord, typename Type>
     void Communicator<Coord, Type>::set_pattern(const std::string &str, const mesh::Pattern& pat)
     {
@@ -157,6 +377,43 @@ namespace mpi {
             build_on_host_from_pattern();
         else
             build_on_device_from_pattern();
+        if( backend_==exchange_neighbourhood )
+            build_graph();
+        if( backend_==exchange_shared_memory )
+            build_shared();
+    }
+
+    // make the distributed graph of the Pattern, in which each domain
+    // both sends to and receives from each of its neighbours
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::build_graph(){
+        *comm_ << "Communicator::build_graph" << std::endl;
+        if( graph_comm_!=MPI_COMM_NULL )
+            MPI_Comm_free(&graph_comm_);
+        std::vector<int> neighbour_list(pattern().neighbour_list());
+        int degree = neighbour_list.size();
+        int flag = MPI_Dist_graph_create_adjacent( comm_->communicator(),
+                                                   degree, data_or_null(neighbour_list), MPI_UNWEIGHTED,
+                                                   degree, data_or_null(neighbour_list), MPI_UNWEIGHTED,
+                                                   MPI_INFO_NULL, 0, &graph_comm_ );
+        assert( flag==MPI_SUCCESS );
+
+        graph_counts_.assign(degree, 1);
+        graph_send_offset_.assign(degree, 0);
+        graph_recv_offset_.assign(degree, 0);
+        graph_send_type_.resize(degree);
+        graph_recv_type_.resize(degree);
+        for( int i=0; i<degree; i++ ){
+            int n = neighbour_list[i];
+            graph_send_type_[i] = send_type_[n].MPIType;
+            graph_recv_type_[i] = recv_type_[n].MPIType;
+            // packed values for each neighbour are at an offset in the
+            // buffers, otherwise the types index the vector
+            if( packed() ){
+                graph_send_offset_[i] = send_offset_[n]*sizeof(baseT);
+                graph_recv_offset_[i] = recv_offset_[n]*sizeof(baseT);
+            }
+        }
     }
 
     template<typename Coord, typename Type>
@@ -167,57 +424,61 @@ namespace mpi {
         block_size_ = block_traits<Type>::blocksize;
         *comm_ << "\tblock_size_ = " << block_size_ << std::endl;
 
-        // determine the displacements in the send and receive buffers
-        // for making the MPI Types for each neighbour
-        int n_recv = 0;
-        int n_send = 0;
-        for(int i=0; i<pattern().num_neighbours(); i++)
-        {
-            int n = pattern().neighbour(i);
-            size_t to_send = pattern().send_index(n).size();
-            size_t to_recv = pattern().recv_index(n).size();
-
-            send_offset_[n] = n_send;
-            recv_offset_[n] = n_recv;
-
-            n_send += to_send*block_size_;
-            n_recv += to_recv*block_size_;
-        }
+        // the values for each neighbour are packed one after the other
+        build_packed_index();
+        build_contiguous_types();
+        int n_send = host_send_perm_.size();
+        int n_recv = host_recv_perm_.size();
 
-        // make the permutation vectors used for packing/unpacking the
-        // data being communicated
+        // copy the permutations to the device
         TVecHostIndex send_perm(n_send);
         TVecHostIndex recv_perm(n_recv);
-        int recv_idx=0, send_idx=0;
+        for(int i=0; i<n_send; i++)
+            send_perm[i] = host_send_perm_[i];
+        for(int i=0; i<n_recv; i++)
+            recv_perm[i] = host_recv_perm_[i];
+        send_perm_ = send_perm;
+        recv_perm_ = recv_perm;
+
+        // vector used for temporary copying to/from the device
+        // we use the same buffer for both sends and receives
+        // so allocate enough room to accomodate both operations
+        device_buffer_ = TVec(std::max(n_recv, n_send));
+    }
+
+    // the offset of the values for each neighbour in packed send and receive
+    // buffers, and the position in the vector of each packed value
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::build_packed_index(){
+        int n_recv = 0;
+        int n_send = 0;
+        host_send_perm_.clear();
+        host_recv_perm_.clear();
         for(int i=0; i<pattern().num_neighbours(); i++)
         {
             int n = pattern().neighbour(i);
             const std::vector<int>& send_patt = pattern().send_index(n);
             const std::vector<int>& recv_patt = pattern().recv_index(n);
 
-            for(int j=0; j<send_patt.size(); j++, send_idx+=block_size_)
+            send_offset_[n] = n_send;
+            recv_offset_[n] = n_recv;
+            n_send += send_patt.size()*block_size_;
+            n_recv += recv_patt.size()*block_size_;
+
+            for(int j=0; j<send_patt.size(); j++)
                 for(int k=0; k<block_size_; k++)
-                    send_perm[send_idx+k] = send_patt[j]*block_size_+k;
+                    host_send_perm_.push_back(send_patt[j]*block_size_+k);
 
-            for(int j=0; j<recv_patt.size(); j++, recv_idx+=block_size_)
+            for(int j=0; j<recv_patt.size(); j++)
                 for(int k=0; k<block_size_; k++)
-                    recv_perm[recv_idx+k] = recv_patt[j]*block_size_+k;
+                    host_recv_perm_.push_back(recv_patt[j]*block_size_+k);
         }
+    }
 
-        // copy these permutations to the device
-        send_perm_ = send_perm;
-        recv_perm_ = recv_perm;
-
-        // vector used for temporary copying to/from the device
-        // we use the same buffer for both sends and receives
-        // so allocate enough room to accomodate both operations
-        device_buffer_ = TVec(std::max(n_recv, n_send));
-
-        // make a vector of block sizes, which are always equal for
-        // both sends and receives, so allocate one vector large enough for
-        // both cases
-
-        // create the MPI_Datatype for each send and receive operation
+    // create the contiguous MPI_Datatype for each send and receive operation
+    // on packed buffers
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::build_contiguous_types(){
         for(int i=0; i<pattern().num_neighbours(); i++)
         {
             MPI_Datatype tmpType;
@@ -245,7 +506,17 @@ namespace mpi {
             *comm_ << "\trecv type to neigbour " << n << " is "
                    << recv_type_[n].MPIType << std::endl;
         }
-    } 
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::free_types(){
+        for(int i=0; i<pattern().num_neighbours(); i++)
+        {
+            int n = pattern().neighbour(i);
+            MPI_Type_free(&send_type_[n].MPIType);
+            MPI_Type_free(&recv_type_[n].MPIType);
+        }
+    }
 
     template<typename Coord, typename Type>
     void Communicator<Coord, Type>::build_on_host_from_pattern(){
@@ -292,7 +563,25 @@ namespace mpi {
         block_lengths_.assign(maxLen, block_size_);
 
         // STEP 3: create the MPI_Datatype for each send and receive operation
-        // to a neighbour [page 96]
+        // to a neighbour
+        build_indexed_types();
+
+        // STEP 4: MPI packs the indexed types one block at a time, which
+        //         can be slower than packing the values into contiguous
+        //         buffers ourselves, so use whichever is quicker here
+        build_packed_index();
+        pack_on_host_ = must_pack() || packing_is_faster();
+        *comm_ << "\tpack_on_host_ = " << (pack_on_host_ ? std::string("true") : std::string("false") ) << std::endl;
+        if( pack_on_host_ ){
+            free_types();
+            build_contiguous_types();
+        }
+    }
+
+    // create the indexed MPI_Datatype for each send and receive operation,
+    // straight from and to the vectors [page 96]
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::build_indexed_types(){
         for(int i=0; i<pattern().num_neighbours(); i++)
         {
             MPI_Datatype tmpType;
@@ -330,52 +619,116 @@ namespace mpi {
     template<typename Coord, typename Type>
     int Communicator<Coord, Type>::vec_add(TVec &v){
         // determine new tag for the vector
-        int new_tag = 1;
-        if( vectors_.size() )
-            new_tag = *std::max_element(vectors_.begin(), vectors_.end()) + 1;
+        int new_tag = next_tag();
         *comm_ << "adding vector with tag " << new_tag << std::endl;
         vectors_.insert(new_tag);
 
-        send_requests_[new_tag].resize( neighbours() );
-        recv_requests_[new_tag].resize( neighbours() );
         busy_[new_tag] = false;
 
         // communication buffer is always on the host. If the base vector
         // type is on the host, then make the buffer point directly to
         // the vector, otherwise create a new host vector that will
         // be copied into/out of before/after each send/receive.
-        if( data_on_host_ ){
+        if( !packed() ){
             recv_buffer_[new_tag] = TVecHost(v.size(), v.data());
             send_buffer_[new_tag] = TVecHost(v.size(), v.data());
         }
         else{
-            recv_buffer_[new_tag] = TVecHost(recv_perm_.size());
-            send_buffer_[new_tag] = TVecHost(send_perm_.size());
+            recv_buffer_[new_tag] = TVecHost(host_recv_perm_.size());
+            send_buffer_[new_tag] = TVecHost(host_send_perm_.size());
         }
 
         // keep a reference to the original data
         vector_[new_tag] = TVec(v.size(), v.data());
 
+        init_requests(new_tag);
+        if( backend_==exchange_shared_memory )
+            init_shared(new_tag, 1);
+
         return new_tag;
     }
 
+    // make the persistent send and receive requests for the vector with tag
+    // the buffers they point to stay put for as long as the vector is in
+    // the communicator
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::init_requests( int tag ){
+        if( backend_==exchange_neighbourhood ){
+            graph_requests_[tag] = MPI_REQUEST_NULL;
+#if MPI_VERSION >= 4
+            int flag = MPI_Neighbor_alltoallw_init(
+                            send_buffer_[tag].data(), data_or_null(graph_counts_),
+                            data_or_null(graph_send_offset_), data_or_null(graph_send_type_),
+                            recv_buffer_[tag].data(), data_or_null(graph_counts_),
+                            data_or_null(graph_recv_offset_), data_or_null(graph_recv_type_),
+                            graph_comm_, MPI_INFO_NULL, &graph_requests_[tag] );
+            assert( flag==MPI_SUCCESS );
+#endif
+            return;
+        }
+        send_requests_[tag].clear();
+        recv_requests_[tag].clear();
+        for( int i=0; i<neighbours(); i++ ){
+            // neighbours on the node are exchanged through shared memory
+            if( on_node(i) )
+                continue;
+            int n = pattern().neighbour(i);
+            int send_offset = packed() ? send_offset_[n] : 0;
+            int recv_offset = packed() ? recv_offset_[n] : 0;
+
+            send_requests_[tag].push_back( comm_->Send_init( send_buffer_[tag].data()+send_offset,
+                                                             n,
+                                                             tag,
+                                                             send_type_[n].MPIType ) );
+            recv_requests_[tag].push_back( comm_->Recv_init( recv_buffer_[tag].data()+recv_offset,
+                                                             n,
+                                                             tag,
+                                                             recv_type_[n].MPIType ) );
+        }
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::free_requests( int tag ){
+        if( backend_==exchange_neighbourhood ){
+#if MPI_VERSION >= 4
+            comm_->Request_free(graph_requests_[tag]);
+#endif
+            graph_requests_.erase(tag);
+            return;
+        }
+        std::vector<MPI_Request>& send_requests = send_requests_[tag];
+        std::vector<MPI_Request>& recv_requests = recv_requests_[tag];
+        for( int i=0; i<int(send_requests.size()); i++ )
+            comm_->Request_free(send_requests[i]);
+        for( int i=0; i<int(recv_requests.size()); i++ )
+            comm_->Request_free(recv_requests[i]);
+    }
+
     // remove a vector from the communicator
     template<typename Coord, typename Type>
     int Communicator<Coord, Type>::vec_remove( int tag ){
-        // WARNING
-        // Need to clean up any unfinished communication for the vector associated with tag
-
         // remove the vector tag from the tag list
         std::set<int>::const_iterator it = vectors_.find(tag);
         *comm_ << "removing vector with tag " << tag << std::endl;
         assert( it!=vectors_.end() );
+
+        // the vector must not be in a group
+        for( typename std::map<int,Group>::const_iterator g=groups_.begin(); g!=groups_.end(); g++ )
+            assert( std::find(g->second.members.begin(), g->second.members.end(), tag)==g->second.members.end() );
+
+        // finish any unfinished communication for the vector, so that its
+        // requests are inactive when they are freed
+        if( busy_[tag] )
+            recv(tag);
         vectors_.erase(it);
 
         // remove associated information
+        free_requests(tag);
+        if( backend_==exchange_shared_memory )
+            free_shared(tag);
         send_requests_.erase(tag);
         recv_requests_.erase(tag);
         busy_.erase(tag);
-        data_.erase(tag);
         send_buffer_.erase(tag);
         recv_buffer_.erase(tag);
         vector_.erase(tag);
@@ -386,49 +739,34 @@ namespace mpi {
     template<typename Coord, typename Type>
     int Communicator<Coord, Type>::send( int tag ){
         //*comm_ << "Vector " << tag << " : initiating sends" << std::endl;
+        if( groups_.count(tag) )
+            return send_group(tag);
+
         // check that we have been asked for a valid tag
         assert( std::find(vectors_.begin(), vectors_.end(), tag)!=vectors_.end() );
 
         // assert that we are not requesting a send on a vector that has a pending receive 
         assert( !busy_[tag] );
 
-        if( pattern().num_neighbours() ){
-            // if the data is on the device we first copy it to the host
-            if( !data_on_host_ && comm_->size()>1 ){
-                int to_send = send_perm_.size();
-
-                // collect values to send into the device buffer
-                device_buffer_.at(0,to_send-1) = vector_[tag].at(send_perm_);
-
-                // copy the buffer from the device into the send buffer on the host
-                device_buffer_.at(0,to_send-1).dump(send_buffer_[tag].data());
-            }
-
-            // make the send
-            for( int i=0; i<neighbours(); i++ ){
-                int n = pattern().neighbour(i);
-
-                if(data_on_host_){
-                    send_requests_[tag][i] = comm_->Isend( send_buffer_[tag].data(),
-                                                           n,
-                                                           tag,
-                                                           send_type_[n].MPIType );
-                    recv_requests_[tag][i] = comm_->Irecv( recv_buffer_[tag].data(),
-                                                           n,
-                                                           tag,
-                                                           recv_type_[n].MPIType );
-                }else{
-                    send_requests_[tag][i] = comm_->Isend( send_buffer_[tag].data()+send_offset_[n],
-                                                           n,
-                                                           tag,
-                                                           send_type_[n].MPIType );
-                    recv_requests_[tag][i] = comm_->Irecv( recv_buffer_[tag].data()+recv_offset_[n],
-                                                           n,
-                                                           tag,
-                                                           recv_type_[n].MPIType );
-                }
-            }
+        if( backend_==exchange_neighbourhood ){
+            // every domain takes part in the collective
+            if( packed() && neighbours() )
+                pack(tag);
+            start_neighbourhood(tag);
+        }
+        else if( pattern().num_neighbours() ){
+            // if the data is on the device, or packed, we first copy it to
+            // the send buffer on the host
+            if( packed() )
+                pack(tag);
+
+            // start the receives, then the sends
+            comm_->Startall( recv_requests_[tag] );
+            comm_->Startall( send_requests_[tag] );
+            if( backend_==exchange_shared_memory )
+                publish_shared(tag);
         }
+        count_messages(tag);
 
         busy_[tag] = true;
         
@@ -438,6 +776,8 @@ namespace mpi {
     // complete pending communication associated with vector with tag
     template<typename Coord, typename Type>
     int Communicator<Coord, Type>::recv( int tag ){
+        if( groups_.count(tag) )
+            return recv_group(tag);
 
         // check that we have been asked for a valid tag
         assert( std::find(vectors_.begin(), vectors_.end(), tag)!=vectors_.end() );
@@ -445,24 +785,21 @@ namespace mpi {
         // assert that we are not requesting a recv on a vector that has no pending recv 
         assert( busy_[tag] );
 
+        if( backend_==exchange_neighbourhood ){
+            wait_neighbourhood(tag);
+            if( packed() && neighbours() )
+                unpack(tag);
+        }
         // only communicate if actually need to
-        if( pattern().num_neighbours() ){
-            int send_size = send_requests_[tag].size();
-            int recv_size = recv_requests_[tag].size();
-            std::vector<MPI_Status> tmpStatus;
-            tmpStatus.resize(std::max(send_size, recv_size));
-
-            comm_->Waitall(send_requests_[tag], tmpStatus);
-            comm_->Waitall(recv_requests_[tag], tmpStatus);
-
-
-            // if the data is meant to be on the device we need to copy it
-            // there from the host buffer
-            if( !data_on_host_ ){
-                int to_recv = recv_perm_.size();
-                device_buffer_.at(0,to_recv-1) = recv_buffer_[tag];
-                vector_[tag].at(recv_perm_) = device_buffer_.at(0,to_recv-1);
-            }
+        else if( pattern().num_neighbours() ){
+            wait_requests(tag, send_requests_[tag], recv_requests_[tag]);
+            if( backend_==exchange_shared_memory )
+                collect_shared(tag);
+
+            // if the data is meant to be on the device, or was packed, we
+            // need to copy it there from the host buffer
+            if( packed() )
+                unpack(tag);
         }
 
         busy_[tag] = false;
@@ -478,9 +815,638 @@ namespace mpi {
                 recv(tag);
             }
         }
+        for( typename std::map<int,Group>::iterator i=groups_.begin(); i!=groups_.end(); i++ ){
+            int tag = i->first;
+            if( busy_[tag] ){
+                recv(tag);
+            }
+        }
         return 0;
     }
 
+    // start the neighbourhood collective for the vector or group with tag
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::start_neighbourhood( int tag ){
+        MPI_Request& request = graph_requests_[tag];
+#if MPI_VERSION >= 4
+        int flag = MPI_Start( &request );
+#else
+        int flag;
+        if( groups_.count(tag) ){
+            Group& group = groups_[tag];
+            flag = MPI_Ineighbor_alltoallv(
+                            data_or_null(group.send_buffer), data_or_null(group.send_count),
+                            data_or_null(group.send_offset), MPI_base_T,
+                            data_or_null(group.recv_buffer), data_or_null(group.recv_count),
+                            data_or_null(group.recv_offset), MPI_base_T,
+                            graph_comm_, &request );
+        }
+        else{
+            flag = MPI_Ineighbor_alltoallw(
+                            send_buffer_[tag].data(), data_or_null(graph_counts_),
+                            data_or_null(graph_send_offset_), data_or_null(graph_send_type_),
+                            recv_buffer_[tag].data(), data_or_null(graph_counts_),
+                            data_or_null(graph_recv_offset_), data_or_null(graph_recv_type_),
+                            graph_comm_, &request );
+        }
+#endif
+        assert( flag==MPI_SUCCESS );
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::wait_neighbourhood( int tag ){
+        double start = profile_.now();
+        int flag = MPI_Wait( &graph_requests_[tag], MPI_STATUS_IGNORE );
+        assert( flag==MPI_SUCCESS );
+        profile_.wait(tag, profile_.now()-start);
+    }
+
+    // complete the point-to-point sends and receives of the vector or group
+    // with tag.  When profiling, the receives are completed as they arrive,
+    // to time how long each neighbour was waited for.
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::wait_requests( int tag,
+                                                   std::vector<MPI_Request>& send_requests,
+                                                   std::vector<MPI_Request>& recv_requests ){
+        std::vector<MPI_Status> status(std::max(send_requests.size(), recv_requests.size()));
+        if( !profile_.enabled() ){
+            comm_->Waitall(send_requests, status);
+            comm_->Waitall(recv_requests, status);
+            return;
+        }
+
+        double start = profile_.now();
+        // the receives are for the neighbours not on the node, in order
+        std::vector<int> from;
+        for( int i=0; i<neighbours(); i++ )
+            if( !on_node(i) )
+                from.push_back(neighbour(i));
+        std::vector<int> indices(recv_requests.size());
+        for( int remaining=recv_requests.size(); remaining>0; ){
+            int count;
+            MPI_Waitsome( recv_requests.size(), &recv_requests[0], &count, &indices[0], &status[0] );
+            if( count==MPI_UNDEFINED )
+                break;
+            double t = profile_.now()-start;
+            for( int k=0; k<count; k++ )
+                profile_.wait_for_neighbour(from[indices[k]], t);
+            remaining -= count;
+        }
+        comm_->Waitall(send_requests, status);
+        profile_.wait(tag, profile_.now()-start);
+    }
+
+    // count the message to each neighbour for the vector or group with tag
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::count_messages( int tag ){
+        if( !profile_.enabled() )
+            return;
+        bool is_group = groups_.count(tag);
+        for( int i=0; i<neighbours(); i++ ){
+            int n = neighbour(i);
+            int values = is_group ? groups_[tag].send_count[i]
+                                  : int(pattern().send_index(n).size())*block_size_;
+            profile_.message(tag, n, double(values)*sizeof(baseT));
+        }
+    }
+
+    // find the neighbours on the same node, and the offsets of the blocks
+    // for each of them in the shared windows
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::build_shared(){
+        *comm_ << "Communicator::build_shared" << std::endl;
+        if( node_comm_!=MPI_COMM_NULL )
+            MPI_Comm_free(&node_comm_);
+        int flag = MPI_Comm_split_type( comm_->communicator(), MPI_COMM_TYPE_SHARED,
+                                        comm_->rank(), MPI_INFO_NULL, &node_comm_ );
+        assert( flag==MPI_SUCCESS );
+
+        // rank of each neighbour in node_comm_, or MPI_UNDEFINED if it is
+        // on another node
+        std::vector<int> neighbour_list(pattern().neighbour_list());
+        node_rank_.assign(neighbours(), MPI_UNDEFINED);
+        MPI_Group group, node_group;
+        MPI_Comm_group( comm_->communicator(), &group );
+        MPI_Comm_group( node_comm_, &node_group );
+        if( neighbours() )
+            MPI_Group_translate_ranks( group, neighbours(), &neighbour_list[0], node_group, &node_rank_[0] );
+        MPI_Group_free( &group );
+        MPI_Group_free( &node_group );
+        for( int i=0; i<neighbours(); i++ )
+            if( node_rank_[i]==MPI_UNDEFINED )
+                node_rank_[i] = -1;
+
+        // our window holds the values for each neighbour on the node in turn
+        shared_offset_.assign(neighbours(), 0);
+        remote_offset_.assign(neighbours(), 0);
+        shared_size_ = 0;
+        for( int i=0; i<neighbours(); i++ )
+            if( node_rank_[i]>=0 ){
+                shared_offset_[i] = shared_size_;
+                shared_size_ += pattern().send_index(neighbour(i)).size()*block_size_;
+                *comm_ << "\tneighbour " << neighbour(i) << " is on the node, rank "
+                       << node_rank_[i] << std::endl;
+            }
+
+        // tell each neighbour on the node where its block is in our window
+        std::vector<MPI_Request> requests;
+        for( int i=0; i<neighbours(); i++ )
+            if( node_rank_[i]>=0 ){
+                requests.push_back( comm_->Irecv( &remote_offset_[i], neighbour(i), 0, MPI_INT ) );
+                requests.push_back( comm_->Isend( &shared_offset_[i], neighbour(i), 0, MPI_INT ) );
+            }
+        std::vector<MPI_Status> status(requests.size());
+        comm_->Waitall( requests, status );
+    }
+
+    // make the shared window for the vector or group with tag, which has
+    // members vectors
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::init_shared( int tag, int members ){
+        SharedWindow& shared = shared_[tag];
+        shared.exchanges = 0;
+
+        // the window is collective over the node, even for processes
+        // without neighbours on it
+        MPI_Info info;
+        MPI_Info_create( &info );
+        MPI_Info_set( info, const_cast<char*>("alloc_shared_noncontig"), const_cast<char*>("true") );
+        int flag = MPI_Win_allocate_shared( shared_header + shared_size_*members*sizeof(baseT), 1,
+                                            info, node_comm_, &shared.base, &shared.win );
+        assert( flag==MPI_SUCCESS );
+        MPI_Info_free( &info );
+        *published(shared.base) = 0;
+        *consumed(shared.base) = 0;
+        // one passive epoch for the life of the window, in which
+        // MPI_Win_sync orders the reads and writes of the counters and values
+        MPI_Win_lock_all( MPI_MODE_NOCHECK, shared.win );
+        MPI_Barrier( node_comm_ );
+
+        shared.remote_base.assign(neighbours(), 0);
+        for( int i=0; i<neighbours(); i++ ){
+            if( !on_node(i) )
+                continue;
+            MPI_Aint size;
+            int disp_unit;
+            MPI_Win_shared_query( shared.win, node_rank_[i], &size, &disp_unit, &shared.remote_base[i] );
+        }
+    }
+
+    // every process has read, and finished with, the windows of its
+    // neighbours when it takes part in freeing them
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::free_shared( int tag ){
+        SharedWindow& shared = shared_[tag];
+        MPI_Win_unlock_all( shared.win );
+        MPI_Win_free( &shared.win );
+        shared_.erase(tag);
+    }
+
+    // wait for a counter in a shared window to reach value.  The wait
+    // spins, which is quickest when each process has its own core, and
+    // yields after a while in case the node is oversubscribed.
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::wait_for( volatile long* counter, long value, MPI_Win win ){
+        for( int spins=0; *counter<value; spins++ ){
+            if( spins>100 )
+                sched_yield();
+            MPI_Win_sync( win );
+        }
+    }
+
+    // copy the values for each neighbour on the node into the window of the
+    // vector or group with tag, once the neighbours have read the last ones
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::publish_shared( int tag ){
+        SharedWindow& shared = shared_[tag];
+        double start = profile_.now();
+        for( int i=0; i<neighbours(); i++ )
+            if( on_node(i) )
+                wait_for( consumed(shared.remote_base[i]), shared.exchanges, shared.win );
+        MPI_Win_sync( shared.win );
+        profile_.wait(tag, profile_.now()-start);
+        start = profile_.now();
+
+        bool is_group = groups_.count(tag);
+        int members = is_group ? groups_[tag].members.size() : 1;
+        for( int i=0; i<neighbours(); i++ ){
+            if( !on_node(i) )
+                continue;
+            int n = neighbour(i);
+            baseT* window = shared_data(shared.base) + shared_offset_[i]*members;
+            if( is_group ){
+                Group& group = groups_[tag];
+                const baseT* block = &group.send_buffer[0] + group.send_offset[i];
+                std::copy(block, block+group.send_count[i], window);
+            }
+            else if( !packed() ){
+                const std::vector<int>& index = pattern().send_index(n);
+                const baseT* v = vector_[tag].data();
+                for( int j=0; j<int(index.size()); j++ )
+                    for( int k=0; k<block_size_; k++ )
+                        *window++ = v[index[j]*block_size_+k];
+            }
+            else{
+                const baseT* block = send_buffer_[tag].data() + send_offset_[n];
+                std::copy(block, block+pattern().send_index(n).size()*block_size_, window);
+            }
+        }
+
+        // the values must be visible before the counter
+        MPI_Win_sync( shared.win );
+        *published(shared.base) = ++shared.exchanges;
+        profile_.pack(tag, profile_.now()-start);
+    }
+
+    // once each neighbour on the node has published its values, copy them
+    // out of its window to where the point-to-point receive would put them
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::collect_shared( int tag ){
+        SharedWindow& shared = shared_[tag];
+        bool is_group = groups_.count(tag);
+        int members = is_group ? groups_[tag].members.size() : 1;
+        double start = profile_.now();
+        double waited = 0.;
+        for( int i=0; i<neighbours(); i++ ){
+            if( !on_node(i) )
+                continue;
+            double wait_start = profile_.now();
+            wait_for( published(shared.remote_base[i]), shared.exchanges, shared.win );
+            MPI_Win_sync( shared.win );
+            waited += profile_.now()-wait_start;
+            profile_.wait_for_neighbour(neighbour(i), profile_.now()-start);
+
+            int n = neighbour(i);
+            const baseT* window = shared_data(shared.remote_base[i]) + remote_offset_[i]*members;
+            if( is_group ){
+                Group& group = groups_[tag];
+                std::copy(window, window+group.recv_count[i], &group.recv_buffer[0] + group.recv_offset[i]);
+            }
+            else if( !packed() ){
+                const std::vector<int>& index = pattern().recv_index(n);
+                baseT* v = vector_[tag].data();
+                for( int j=0; j<int(index.size()); j++ )
+                    for( int k=0; k<block_size_; k++ )
+                        v[index[j]*block_size_+k] = *window++;
+            }
+            else{
+                int count = pattern().recv_index(n).size()*block_size_;
+                std::copy(window, window+count, recv_buffer_[tag].data() + recv_offset_[n]);
+            }
+        }
+
+        // let the neighbours write their windows again
+        MPI_Win_sync( shared.win );
+        *consumed(shared.base) = shared.exchanges;
+        profile_.wait(tag, waited);
+        profile_.unpack(tag, profile_.now()-start-waited);
+    }
+
+    // tags are shared by vectors and groups
+    template<typename Coord, typename Type>
+    int Communicator<Coord, Type>::next_tag() const{
+        int new_tag = 1;
+        if( vectors_.size() )
+            new_tag = *std::max_element(vectors_.begin(), vectors_.end()) + 1;
+        if( groups_.size() )
+            new_tag = std::max(new_tag, groups_.rbegin()->first + 1);
+        return new_tag;
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::pack( int tag ){
+        double start = profile_.now();
+        if( data_on_host_ )
+            pack_host(tag);
+        else
+            pack_device(tag);
+        profile_.pack(tag, profile_.now()-start);
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::unpack( int tag ){
+        double start = profile_.now();
+        if( data_on_host_ )
+            unpack_host(tag);
+        else
+            unpack_device(tag);
+        profile_.unpack(tag, profile_.now()-start);
+    }
+
+    // gather the values of the vector with tag to send into its send buffer
+    // threaded for large halos, where it pays to start the threads
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::pack_host( int tag ){
+        const baseT* v = vector_[tag].data();
+        baseT* buffer = send_buffer_[tag].data();
+        const int* perm = data_or_null(host_send_perm_);
+        int to_send = host_send_perm_.size();
+        #pragma omp parallel for schedule(static) if(to_send>16384)
+        for( int i=0; i<to_send; i++ )
+            buffer[i] = v[perm[i]];
+    }
+
+    // scatter the received values of the vector with tag from its receive
+    // buffer
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::unpack_host( int tag ){
+        baseT* v = vector_[tag].data();
+        const baseT* buffer = recv_buffer_[tag].data();
+        const int* perm = data_or_null(host_recv_perm_);
+        int to_recv = host_recv_perm_.size();
+        #pragma omp parallel for schedule(static) if(to_recv>16384)
+        for( int i=0; i<to_recv; i++ )
+            v[perm[i]] = buffer[i];
+    }
+
+    // time exchanging the halo of a vector with the indexed types, and by
+    // packing it into buffers with contiguous types.  The slowest domain
+    // decides, so that every domain chooses the same.
+    // notes: collective
+    template<typename Coord, typename Type>
+    bool Communicator<Coord, Type>::packing_is_faster(){
+        const int warmup = 2;
+        const int repeats = 20;
+
+        int length = 0;
+        for( int i=0; i<int(host_send_perm_.size()); i++ )
+            length = std::max(length, host_send_perm_[i]+1);
+        for( int i=0; i<int(host_recv_perm_.size()); i++ )
+            length = std::max(length, host_recv_perm_[i]+1);
+        std::vector<baseT> v(length, baseT(1));
+        std::vector<baseT> send_buffer(host_send_perm_.size());
+        std::vector<baseT> recv_buffer(host_recv_perm_.size());
+        std::vector<MPI_Request> requests(2*neighbours());
+        std::vector<MPI_Status> status(2*neighbours());
+
+        double time[2] = {0., 0.};
+        for( int packing=0; packing<2; packing++ ){
+            comm_->barrier();
+            double start = 0.;
+            for( int r=0; r<warmup+repeats; r++ ){
+                if( r==warmup )
+                    start = MPI_Wtime();
+                if( packing )
+                    for( int i=0; i<int(host_send_perm_.size()); i++ )
+                        send_buffer[i] = v[host_send_perm_[i]];
+                for( int i=0; i<neighbours(); i++ ){
+                    int n = neighbour(i);
+                    if( packing ){
+                        MPI_Irecv( data_or_null(recv_buffer)+recv_offset_[n], pattern().recv_index(n).size()*block_size_,
+                                   MPI_base_T, n, 0, comm_->communicator(), &requests[2*i] );
+                        MPI_Isend( data_or_null(send_buffer)+send_offset_[n], pattern().send_index(n).size()*block_size_,
+                                   MPI_base_T, n, 0, comm_->communicator(), &requests[2*i+1] );
+                    }else{
+                        MPI_Irecv( data_or_null(v), 1, recv_type_[n].MPIType, n, 0, comm_->communicator(), &requests[2*i] );
+                        MPI_Isend( data_or_null(v), 1, send_type_[n].MPIType, n, 0, comm_->communicator(), &requests[2*i+1] );
+                    }
+                }
+                comm_->Waitall( requests, status );
+                if( packing )
+                    for( int i=0; i<int(host_recv_perm_.size()); i++ )
+                        v[host_recv_perm_[i]] = recv_buffer[i];
+            }
+            time[packing] = MPI_Wtime()-start;
+        }
+
+        double max_time[2];
+        MPI_Allreduce( time, max_time, 2, MPI_DOUBLE, MPI_MAX, comm_->communicator() );
+        *comm_ << "\thalo exchange takes " << 1e6*max_time[0]/repeats << " us with indexed types, "
+               << 1e6*max_time[1]/repeats << " us packed" << std::endl;
+        return max_time[1]<max_time[0];
+    }
+
+    // copy the values of the vector with tag to send from the device into
+    // its send buffer on the host
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::pack_device( int tag ){
+        int to_send = send_perm_.size();
+
+        // collect values to send into the device buffer
+        device_buffer_.at(0,to_send-1) = vector_[tag].at(send_perm_);
+
+        // copy the buffer from the device into the send buffer on the host
+        device_buffer_.at(0,to_send-1).dump(send_buffer_[tag].data());
+    }
+
+    // copy the received values of the vector with tag from its receive
+    // buffer on the host to the device
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::unpack_device( int tag ){
+        int to_recv = recv_perm_.size();
+        device_buffer_.at(0,to_recv-1) = recv_buffer_[tag];
+        vector_[tag].at(recv_perm_) = device_buffer_.at(0,to_recv-1);
+    }
+
+    // add a group of the vectors with tags
+    template<typename Coord, typename Type>
+    int Communicator<Coord, Type>::group_add( const std::vector<int>& tags ){
+        for( int m=0; m<int(tags.size()); m++ )
+            assert( vectors_.count(tags[m]) );
+
+        int new_tag = next_tag();
+        *comm_ << "adding group with tag " << new_tag << " of " << tags.size() << " vectors" << std::endl;
+        busy_[new_tag] = false;
+
+        Group& group = groups_[new_tag];
+        group.members = tags;
+        int members = tags.size();
+
+        // the block for each neighbour holds the values for each vector in turn
+        int n_send = 0;
+        int n_recv = 0;
+        for( int i=0; i<neighbours(); i++ ){
+            int n = pattern().neighbour(i);
+            int to_send = pattern().send_index(n).size()*block_size_*members;
+            int to_recv = pattern().recv_index(n).size()*block_size_*members;
+
+            group.send_offset.push_back(n_send);
+            group.recv_offset.push_back(n_recv);
+            group.send_count.push_back(to_send);
+            group.recv_count.push_back(to_recv);
+            n_send += to_send;
+            n_recv += to_recv;
+
+            MPI_Datatype tmpType;
+            int flag = MPI_Type_contiguous( to_send, MPI_base_T, &tmpType );
+            assert( flag==MPI_SUCCESS );
+            flag = MPI_Type_commit( &tmpType );
+            assert( flag==MPI_SUCCESS );
+            group.send_type.push_back(tmpType);
+
+            flag = MPI_Type_contiguous( to_recv, MPI_base_T, &tmpType );
+            assert( flag==MPI_SUCCESS );
+            flag = MPI_Type_commit( &tmpType );
+            assert( flag==MPI_SUCCESS );
+            group.recv_type.push_back(tmpType);
+        }
+        group.send_buffer.resize(n_send);
+        group.recv_buffer.resize(n_recv);
+
+        // the buffers are never resized, so the requests can be persistent
+        if( backend_==exchange_neighbourhood ){
+            graph_requests_[new_tag] = MPI_REQUEST_NULL;
+#if MPI_VERSION >= 4
+            int flag = MPI_Neighbor_alltoallv_init(
+                            data_or_null(group.send_buffer), data_or_null(group.send_count),
+                            data_or_null(group.send_offset), MPI_base_T,
+                            data_or_null(group.recv_buffer), data_or_null(group.recv_count),
+                            data_or_null(group.recv_offset), MPI_base_T,
+                            graph_comm_, MPI_INFO_NULL, &graph_requests_[new_tag] );
+            assert( flag==MPI_SUCCESS );
+#endif
+            return new_tag;
+        }
+        for( int i=0; i<neighbours(); i++ ){
+            if( on_node(i) )
+                continue;
+            int n = pattern().neighbour(i);
+            group.send_requests.push_back(
+                comm_->Send_init( &group.send_buffer[0]+group.send_offset[i], n, new_tag, group.send_type[i] ) );
+            group.recv_requests.push_back(
+                comm_->Recv_init( &group.recv_buffer[0]+group.recv_offset[i], n, new_tag, group.recv_type[i] ) );
+        }
+        if( backend_==exchange_shared_memory )
+            init_shared(new_tag, members);
+
+        return new_tag;
+    }
+
+    // remove the group with tag, the vectors in it stay in the communicator
+    template<typename Coord, typename Type>
+    int Communicator<Coord, Type>::group_remove( int tag ){
+        *comm_ << "removing group with tag " << tag << std::endl;
+        assert( groups_.count(tag) );
+
+        if( busy_[tag] )
+            recv(tag);
+        free_group(tag);
+        if( backend_==exchange_shared_memory )
+            free_shared(tag);
+        groups_.erase(tag);
+        busy_.erase(tag);
+
+        return tag;
+    }
+
+    template<typename Coord, typename Type>
+    void Communicator<Coord, Type>::free_group( int tag ){
+        Group& group = groups_[tag];
+        if( backend_==exchange_neighbourhood ){
+#if MPI_VERSION >= 4
+            comm_->Request_free(graph_requests_[tag]);
+#endif
+            graph_requests_.erase(tag);
+        }
+        for( int i=0; i<int(group.send_requests.size()); i++ ){
+            comm_->Request_free(group.send_requests[i]);
+            comm_->Request_free(group.recv_requests[i]);
+        }
+        for( int i=0; i<int(group.send_type.size()); i++ ){
+            MPI_Type_free(&group.send_type[i]);
+            MPI_Type_free(&group.recv_type[i]);
+        }
+        group.send_requests.clear();
+        group.recv_requests.clear();
+        group.send_type.clear();
+        group.recv_type.clear();
+    }
+
+    // pack the values of each vector in the group into the block for each
+    // neighbour, then start the receives and sends
+    template<typename Coord, typename Type>
+    int Communicator<Coord, Type>::send_group( int tag ){
+        Group& group = groups_[tag];
+        assert( !busy_[tag] );
+
+        if( neighbours() ){
+            double start = profile_.now();
+            int members = group.members.size();
+            if( !data_on_host_ )
+                for( int m=0; m<members; m++ )
+                    pack_device(group.members[m]);
+
+            for( int i=0; i<neighbours(); i++ ){
+                int n = pattern().neighbour(i);
+                const std::vector<int>& index = pattern().send_index(n);
+                baseT* buffer = &group.send_buffer[0] + group.send_offset[i];
+                for( int m=0; m<members; m++ ){
+                    int vtag = group.members[m];
+                    assert( !busy_[vtag] );
+                    if( data_on_host_ ){
+                        const baseT* v = vector_[vtag].data();
+                        for( int j=0; j<int(index.size()); j++ )
+                            for( int k=0; k<block_size_; k++ )
+                                *buffer++ = v[index[j]*block_size_+k];
+                    }else{
+                        const baseT* v = send_buffer_[vtag].data() + send_offset_[n];
+                        buffer = std::copy(v, v+index.size()*block_size_, buffer);
+                    }
+                }
+            }
+            profile_.pack(tag, profile_.now()-start);
+
+            if( backend_!=exchange_neighbourhood ){
+                comm_->Startall( group.recv_requests );
+                comm_->Startall( group.send_requests );
+            }
+            if( backend_==exchange_shared_memory )
+                publish_shared(tag);
+        }
+        if( backend_==exchange_neighbourhood )
+            start_neighbourhood(tag);
+        count_messages(tag);
+
+        busy_[tag] = true;
+        return tag;
+    }
+
+    // complete the exchange of the group, and unpack the values received
+    // from each neighbour into the vectors
+    template<typename Coord, typename Type>
+    int Communicator<Coord, Type>::recv_group( int tag ){
+        Group& group = groups_[tag];
+        assert( busy_[tag] );
+
+        if( backend_==exchange_neighbourhood )
+            wait_neighbourhood(tag);
+        if( neighbours() ){
+            if( backend_!=exchange_neighbourhood )
+                wait_requests(tag, group.send_requests, group.recv_requests);
+            if( backend_==exchange_shared_memory )
+                collect_shared(tag);
+
+            double start = profile_.now();
+            int members = group.members.size();
+            for( int i=0; i<neighbours(); i++ ){
+                int n = pattern().neighbour(i);
+                const std::vector<int>& index = pattern().recv_index(n);
+                const baseT* buffer = &group.recv_buffer[0] + group.recv_offset[i];
+                for( int m=0; m<members; m++ ){
+                    int vtag = group.members[m];
+                    if( data_on_host_ ){
+                        baseT* v = vector_[vtag].data();
+                        for( int j=0; j<int(index.size()); j++ )
+                            for( int k=0; k<block_size_; k++ )
+                                v[index[j]*block_size_+k] = *buffer++;
+                    }else{
+                        int count = index.size()*block_size_;
+                        std::copy(buffer, buffer+count, recv_buffer_[vtag].data() + recv_offset_[n]);
+                        buffer += count;
+                    }
+                }
+            }
+
+            if( !data_on_host_ )
+                for( int m=0; m<members; m++ )
+                    unpack_device(group.members[m]);
+            profile_.unpack(tag, profile_.now()-start);
+        }
+
+        busy_[tag] = false;
+        return tag;
+    }
+
     // return a reference to the Pattern
     template<typename Coord, typename Type>
     const mesh::Pattern& Communicator<Coord, Type>::pattern() const {
@@ -0,0 +1,226 @@
+#ifndef GATHER_COMMUNICATOR_H
+#define GATHER_COMMUNICATOR_H
+
+#include <fvm/fvm.h>
+#include <fvm/mesh.h>
+#include <mpi/mpicomm.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace fvm {
+
+// Gathers the values at a set of global nodes to one process, e.g. for
+// output.  Each process sends only the values at the nodes of the set that
+// it owns, and only the root holds the result, so no process other than the
+// root needs memory for the global mesh.
+//
+// Global ids and the global order are the numbering of the distributed
+// mesh, in which the local nodes of domain p are vtxdist[p] to vtxdist[p+1]-1
+// after the nodes have been reordered (see Mesh::global_node_id).  This is
+// not the order of the mesh file: Mesh::node_source_id gives the file index
+// of each local node, and can be gathered alongside the values to map the
+// result back.
+template<typename ValueType>
+class GatherCommunicator {
+public:
+    typedef mesh::Mesh Mesh;
+
+    typedef ValueType value_type;
+    typedef typename Iterator<value_type>::type iterator;
+    typedef typename ConstIterator<value_type>::type const_iterator;
+
+    // gather every node of the mesh, in global order (see above)
+    GatherCommunicator(const Mesh& m, int root = 0);
+
+    // gather the nodes with the global ids output_nodes, in that order
+    // output_nodes: only significant on the root
+    // notes: collective
+    GatherCommunicator(const Mesh& m, const std::vector<int>& output_nodes, int root = 0);
+
+    const Mesh& mesh() const;
+    int root() const;
+
+    // number of values gathered to the root (0 on other processes)
+    int size() const;
+
+    // gather the values at the output nodes to the root
+    // values: values at the nodes of the domain, local nodes first
+    // result: resized to size() on the root, unchanged elsewhere
+    // notes: collective, throws mpi::MPIException if the gather fails
+    void gather(const_iterator values, std::vector<value_type>& result) const;
+
+private:
+    GatherCommunicator(const GatherCommunicator&);
+    GatherCommunicator& operator=(const GatherCommunicator&);
+
+    static const int variables_per_node = VariableTraits<value_type>::number;
+
+    const Mesh& m;
+    mpi::MPICommPtr procinfo;
+    int root_;
+    int size_;
+
+    // the local nodes this process sends, in the order they are gathered
+    std::vector<int> send_nodes;
+    mutable std::vector<value_type> send_buffer;
+
+    // on the root: the number of values from each process and where they
+    // start, scaled by variables_per_node, and the position in the result
+    // of each value gathered (empty when gathering every node, whose order
+    // is already the global order)
+    std::vector<int> scaled_counts;
+    std::vector<int> scaled_displacements;
+    std::vector<int> position;
+    mutable std::vector<value_type> recv_buffer;
+
+    void set_counts(const std::vector<int>& counts);
+
+    // throws mpi::MPIException if flag, returned by the MPI routine call,
+    // is not MPI_SUCCESS
+    void check(int flag, const std::string& call) const;
+};
+
+template<typename ValueType>
+GatherCommunicator<ValueType>::GatherCommunicator(const Mesh& m, int root)
+    : m(m), root_(root)
+{
+    procinfo = m.mpicomm()->duplicate("Gather");
+
+    for (int i = 0; i < mesh().local_nodes(); ++i)
+        send_nodes.push_back(i);
+    send_buffer.resize(send_nodes.size());
+
+    const std::vector<int>& vtxdist = mesh().vtxdist();
+    std::vector<int> counts;
+    for (int p = 0; p < procinfo->size(); ++p)
+        counts.push_back(vtxdist[p+1] - vtxdist[p]);
+    set_counts(counts);
+    size_ = procinfo->rank() == root_ ? mesh().global_nodes() : 0;
+}
+
+template<typename ValueType>
+GatherCommunicator<ValueType>::GatherCommunicator(
+    const Mesh& m, const std::vector<int>& output_nodes, int root)
+    : m(m), root_(root)
+{
+    procinfo = m.mpicomm()->duplicate("Gather");
+    const std::vector<int>& vtxdist = mesh().vtxdist();
+    int domains = procinfo->size();
+
+    // every process needs the list to find the nodes it owns
+    std::vector<int> nodes(output_nodes);
+    int count = nodes.size();
+    check(MPI_Bcast(&count, 1, MPI_INT, root_, procinfo->communicator()),
+          "MPI_Bcast");
+    nodes.resize(count);
+    if (count)
+        check(MPI_Bcast(&nodes[0], count, MPI_INT, root_, procinfo->communicator()),
+              "MPI_Bcast");
+
+    // the owner of each node, whose values are gathered in list order
+    std::vector<int> counts(domains, 0);
+    std::vector<int> owner(count);
+    for (int k = 0; k < count; ++k) {
+        assert(nodes[k] >= 0 && nodes[k] < mesh().global_nodes());
+        owner[k] = std::upper_bound(vtxdist.begin(), vtxdist.end(), nodes[k])
+                 - vtxdist.begin() - 1;
+        ++counts[owner[k]];
+        if (owner[k] == procinfo->rank())
+            send_nodes.push_back(nodes[k] - vtxdist[owner[k]]);
+    }
+    send_buffer.resize(send_nodes.size());
+    set_counts(counts);
+
+    if (procinfo->rank() == root_) {
+        std::vector<int> next(domains);
+        for (int p = 0; p < domains; ++p)
+            next[p] = scaled_displacements[p] / variables_per_node;
+        position.resize(count);
+        for (int k = 0; k < count; ++k)
+            position[next[owner[k]]++] = k;
+    }
+    size_ = procinfo->rank() == root_ ? count : 0;
+}
+
+template<typename ValueType>
+void GatherCommunicator<ValueType>::set_counts(const std::vector<int>& counts)
+{
+    if (procinfo->rank() != root_)
+        return;
+    int total = 0;
+    for (int p = 0; p < int(counts.size()); ++p) {
+        scaled_counts.push_back(counts[p] * variables_per_node);
+        scaled_displacements.push_back(total * variables_per_node);
+        total += counts[p];
+    }
+    recv_buffer.resize(total);
+}
+
+template<typename ValueType>
+const mesh::Mesh& GatherCommunicator<ValueType>::mesh() const {
+    return m;
+}
+
+template<typename ValueType>
+int GatherCommunicator<ValueType>::root() const {
+    return root_;
+}
+
+template<typename ValueType>
+int GatherCommunicator<ValueType>::size() const {
+    return size_;
+}
+
+template<typename ValueType>
+void GatherCommunicator<ValueType>::gather(
+    const_iterator values, std::vector<value_type>& result) const
+{
+    for (int i = 0; i < int(send_nodes.size()); ++i)
+        send_buffer[i] = values[send_nodes[i]];
+
+    bool is_root = procinfo->rank() == root_;
+    int flag = MPI_Gatherv(
+        send_buffer.empty() ? 0 : &send_buffer[0],
+        send_buffer.size() * variables_per_node,
+        MPI_DOUBLE,
+        recv_buffer.empty() ? 0 : &recv_buffer[0],
+        is_root ? const_cast<int*>(&scaled_counts[0]) : 0,
+        is_root ? const_cast<int*>(&scaled_displacements[0]) : 0,
+        MPI_DOUBLE,
+        root_,
+        procinfo->communicator()
+    );
+    check(flag, "MPI_Gatherv");
+    if (!is_root)
+        return;
+
+    result.resize(size_);
+    if (position.empty())
+        std::copy(recv_buffer.begin(), recv_buffer.end(), result.begin());
+    else
+        for (int k = 0; k < int(position.size()); ++k)
+            result[position[k]] = recv_buffer[k];
+}
+
+template<typename ValueType>
+void GatherCommunicator<ValueType>::check(int flag, const std::string& call) const
+{
+    if (flag == MPI_SUCCESS)
+        return;
+    std::string message = procinfo->name() + " : " + call
+                        + "() : flag = " + mpi::flag_string(flag);
+    *procinfo << message << std::endl;
+    mpi::MPIException e;
+    e.set_error_message(message);
+    throw e;
+}
+
+// Definition of static member
+template<typename ValueType>
+const int GatherCommunicator<ValueType>::variables_per_node;
+
+} // end namespace fvm
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef HALO_COMMUNICATOR_H
+#define HALO_COMMUNICATOR_H
+
+#include <fvm/fvm.h>
+#include <fvm/mesh.h>
+#include <mpi/mpicomm.h>
+
+#include <vector>
+
+namespace fvm {
+
+// A drop-in replacement for BroadcastCommunicator that only moves the values
+// at external nodes.  Each process sends to each of its neighbours in the
+// node pattern of the mesh the values that the neighbour holds as external
+// nodes, so memory and bandwidth grow with the size of the halo rather than
+// with the size of the global mesh.
+template<typename ValueType>
+class HaloCommunicator {
+public:
+    typedef mesh::Mesh Mesh;
+
+    typedef ValueType value_type;
+    typedef typename Iterator<value_type>::type iterator;
+    typedef typename ConstIterator<value_type>::type const_iterator;
+
+    HaloCommunicator(const Mesh& m);
+    const Mesh& mesh() const;
+
+    // copy the values at the external nodes from the processes that own them
+    // values: values at the nodes of the domain, local nodes first
+    // notes: collective over the neighbours in the node pattern, throws
+    //        mpi::MPIException if a send or receive fails
+    void communicate(iterator values);
+
+private:
+    HaloCommunicator(const HaloCommunicator&);
+    HaloCommunicator& operator=(const HaloCommunicator&);
+
+    static const int variables_per_node = VariableTraits<value_type>::number;
+
+    const Mesh& m;
+    mpi::MPICommPtr procinfo;
+
+    // the values for each neighbour are packed one after the other, the
+    // block for the ith neighbour starting at send_offset[i] (recv_offset[i])
+    std::vector<value_type> send_buffer;
+    std::vector<value_type> recv_buffer;
+    std::vector<int> send_offset;
+    std::vector<int> recv_offset;
+    std::vector<MPI_Request> requests;
+    std::vector<MPI_Status> statuses;
+
+    // the block of n values starting at offset, null if n is zero so that a
+    // neighbour with nothing to send never indexes past the end of a buffer
+    static value_type* block(std::vector<value_type>& buffer, int offset, int n) {
+        return n ? &buffer[offset] : 0;
+    }
+};
+
+template<typename ValueType>
+const mesh::Mesh& HaloCommunicator<ValueType>::mesh() const {
+    return m;
+}
+
+template<typename ValueType>
+HaloCommunicator<ValueType>::HaloCommunicator(const Mesh& m)
+    : m(m)
+{
+    procinfo = m.mpicomm()->duplicate("Halo");
+
+    const mesh::Pattern& pattern = mesh().node_pattern();
+    int n_send = 0, n_recv = 0;
+    for (int i = 0; i < pattern.num_neighbours(); ++i) {
+        int n = pattern.neighbour(i);
+        send_offset.push_back(n_send);
+        recv_offset.push_back(n_recv);
+        n_send += pattern.send_index(n).size();
+        n_recv += pattern.recv_index(n).size();
+    }
+    send_buffer.resize(n_send);
+    recv_buffer.resize(n_recv);
+    requests.resize(2*pattern.num_neighbours());
+    statuses.resize(2*pattern.num_neighbours());
+}
+
+template<typename ValueType>
+void HaloCommunicator<ValueType>::communicate(iterator values)
+{
+    const mesh::Pattern& pattern = mesh().node_pattern();
+    int neighbours = pattern.num_neighbours();
+    if (neighbours == 0)
+        return;
+
+    // post the receives, then pack and send the values for each neighbour
+    for (int i = 0; i < neighbours; ++i) {
+        int n = pattern.neighbour(i);
+        int count = pattern.recv_index(n).size();
+        requests[i] = procinfo->Irecv(
+            block(recv_buffer, recv_offset[i], count),
+            count * variables_per_node, n, 0, MPI_DOUBLE
+        );
+    }
+    for (int i = 0; i < neighbours; ++i) {
+        int n = pattern.neighbour(i);
+        const std::vector<int>& index = pattern.send_index(n);
+        int count = index.size();
+        for (int j = 0; j < count; ++j)
+            send_buffer[send_offset[i] + j] = values[index[j]];
+        requests[neighbours + i] = procinfo->Isend(
+            block(send_buffer, send_offset[i], count),
+            count * variables_per_node, n, 0, MPI_DOUBLE
+        );
+    }
+    procinfo->Waitall(requests, statuses);
+
+    // copy the external values
+    for (int i = 0; i < neighbours; ++i) {
+        const std::vector<int>& index = pattern.recv_index(pattern.neighbour(i));
+        for (int j = 0; j < int(index.size()); ++j)
+            values[index[j]] = recv_buffer[recv_offset[i] + j];
+    }
+}
+
+// Definition of static member
+template<typename ValueType>
+const int HaloCommunicator<ValueType>::variables_per_node;
+
+} // end namespace fvm
+
+#endif
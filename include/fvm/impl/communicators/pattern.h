@@ -86,7 +86,9 @@ inline
 void Pattern::add_neighbour( int n, std::vector<int>& send, std::vector<int>& recv ){
     // sanity check
     //assert(n>=0 && n<comm_.size()); // ensure that n is in the MPI group
-    assert(n>=0 && n<comm_->size()); // ensure that n is in the MPI group
+    // ensure that n is in the MPI group (patterns of thread domains have no
+    // MPI communicator)
+    assert(n>=0 && (!comm_ || n<comm_->size()));
     assert( !is_neighbour(n) ); // ensure that this neighbour has not already been added
 
     neighbours_.push_back(n);
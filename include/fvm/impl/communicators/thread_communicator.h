@@ -0,0 +1,269 @@
+#ifndef THREAD_COMMUNICATOR_H
+#define THREAD_COMMUNICATOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <sched.h>
+
+#include <fvm/impl/communicators/communicator.h>
+#include <fvm/impl/communicators/pattern.h>
+
+namespace mpi {
+
+    // The domains of a decomposition that are run by the threads of one
+    // process, one thread per domain, e.g. each thread of an OpenMP parallel
+    // region.  It plays the part of the MPI communicator for the
+    // ThreadCommunicators of the domains: it holds the Pattern of every
+    // domain and, for each domain and tag, where the vector with that tag is
+    // and how many times its values have been sent and read.  It is made
+    // before the threads start, and must outlive them.
+    class ThreadDomains{
+        public:
+            // patterns: the pattern of each domain, whose neighbours are the
+            //           indices of the other domains in patterns
+            // max_tags: the most vectors and groups a domain has at any one
+            //           time
+            ThreadDomains( const std::vector<mesh::Pattern>& patterns, int max_tags=16 )
+                : patterns_(patterns), max_tags_(max_tags), slots_(patterns.size()*max_tags) {};
+
+            int size() const {return patterns_.size();};
+            const mesh::Pattern& pattern( int domain ) const {return patterns_[domain];};
+
+        private:
+            template<typename Coord, typename Type> friend class ThreadCommunicator;
+
+            // written by the domain that owns it, read by its neighbours,
+            // each on its own cache line so that spinning on one does not
+            // slow the others
+            struct Slot{
+                Slot() : data(0), published(0), consumed(0) {};
+                const void* data;
+                volatile long published;
+                volatile long consumed;
+                char padding[64 - sizeof(const void*) - 2*sizeof(long)];
+            };
+            Slot& slot( int domain, int tag ){
+                assert( domain>=0 && domain<size() );
+                assert( tag>=1 && tag<=max_tags_ );
+                return slots_[domain*max_tags_ + tag-1];
+            };
+
+            std::vector<mesh::Pattern> patterns_;
+            int max_tags_;
+            std::vector<Slot> slots_;
+    };
+
+    // The counterpart of Communicator for a domain run by a thread of
+    // ThreadDomains.  A send publishes the vector to the neighbours, and a
+    // receive copies the halo values straight out of the vectors of the
+    // neighbours once they have been published, so halos are exchanged
+    // through the memory of the process with no MPI at all.  Every domain
+    // must add, send and receive its vectors in the same order, as with
+    // Communicator.  The values must not change between send() and
+    // recv(), which returns once the neighbours have read them.
+    // Only vectors on the host are supported.  The vectors of a group are
+    // sent one after the other, as there are no messages to save.
+    template <typename Coord, typename Type>
+    class ThreadCommunicator{
+        typedef typename block_traits<Type>::baseT baseT;
+        typedef typename lin::rebind<Coord, baseT>::type CoordT;
+        typedef lin::Vector<baseT, CoordT> TVec;
+        public:
+            ThreadCommunicator( ThreadDomains& domains, int rank );
+
+            int rank() const {return rank_;};
+            int size() const {return domains_.size();};
+            const mesh::Pattern& pattern() const {return domains_.pattern(rank_);};
+
+            // add and remove vectors to and from the communicator
+            int vec_add(TVec&);
+            int vec_remove(int);
+
+            // add and remove groups of vectors, whose tag is passed to send()
+            // and recv() like that of a vector.  A vector can only be removed
+            // when it is in no group.
+            int group_add(const std::vector<int>&);
+            int group_remove(int);
+
+            // send a vector or group to the neighbours, and receive its halo
+            int send(int);
+            int recv(int);
+            int recv_all();
+
+        private:
+            ThreadCommunicator( const ThreadCommunicator& );
+            ThreadCommunicator& operator=( const ThreadCommunicator& );
+
+            static void wait_for( volatile long* counter, long value );
+            int free_tag() const;
+            void send_vector( int );
+            void recv_vector( int );
+
+            ThreadDomains& domains_;
+            int rank_;
+            int block_size_;
+            std::set<int> vectors_;
+            std::map<int, std::vector<int> > groups_;
+            std::map<int,bool> busy_;
+            std::map<int,long> exchanges_;
+    };
+
+    template<typename Coord, typename Type>
+    ThreadCommunicator<Coord, Type>::ThreadCommunicator( ThreadDomains& domains, int rank )
+        : domains_(domains), rank_(rank), block_size_(block_traits<Type>::blocksize)
+    {
+        assert( rank>=0 && rank<domains.size() );
+        assert( !CoordTraits<Coord>::is_device() );
+    }
+
+    // the lowest tag that no vector or group has
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::free_tag() const {
+        int tag = 1;
+        while( vectors_.count(tag) || groups_.count(tag) )
+            tag++;
+        return tag;
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::vec_add( TVec &v ){
+        int new_tag = free_tag();
+        vectors_.insert(new_tag);
+        busy_[new_tag] = false;
+
+        // a tag used before carries on counting from where it stopped, as
+        // the neighbours do
+        ThreadDomains::Slot& slot = domains_.slot(rank_, new_tag);
+        slot.data = v.data();
+        exchanges_[new_tag] = slot.published;
+        return new_tag;
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::vec_remove( int tag ){
+        assert( vectors_.count(tag) );
+        for( std::map<int, std::vector<int> >::iterator g=groups_.begin(); g!=groups_.end(); g++ )
+            assert( std::find(g->second.begin(), g->second.end(), tag)==g->second.end() );
+        if( busy_[tag] )
+            recv(tag);
+        vectors_.erase(tag);
+        busy_.erase(tag);
+        exchanges_.erase(tag);
+        return 0;
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::group_add( const std::vector<int>& tags ){
+        for( int m=0; m<int(tags.size()); m++ )
+            assert( vectors_.count(tags[m]) );
+        int new_tag = free_tag();
+        groups_[new_tag] = tags;
+        busy_[new_tag] = false;
+        return new_tag;
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::group_remove( int tag ){
+        assert( groups_.count(tag) );
+        if( busy_[tag] )
+            recv(tag);
+        groups_.erase(tag);
+        busy_.erase(tag);
+        return tag;
+    }
+
+    // wait for a counter of a neighbour to reach value.  The wait spins, and
+    // yields after a while in case there are more domains than cores.
+    template<typename Coord, typename Type>
+    void ThreadCommunicator<Coord, Type>::wait_for( volatile long* counter, long value ){
+        for( int spins=0; *counter<value; spins++ ){
+            if( spins>100 )
+                sched_yield();
+            #pragma omp flush
+        }
+        #pragma omp flush
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::send( int tag ){
+        assert( vectors_.count(tag) || groups_.count(tag) );
+        assert( !busy_[tag] );
+        if( groups_.count(tag) ){
+            const std::vector<int>& members = groups_[tag];
+            for( int m=0; m<int(members.size()); m++ )
+                send_vector(members[m]);
+        }
+        else
+            send_vector(tag);
+        busy_[tag] = true;
+        return 0;
+    }
+
+    template<typename Coord, typename Type>
+    void ThreadCommunicator<Coord, Type>::send_vector( int tag ){
+        // the values must be visible before the counter
+        #pragma omp flush
+        domains_.slot(rank_, tag).published = ++exchanges_[tag];
+        #pragma omp flush
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::recv( int tag ){
+        assert( vectors_.count(tag) || groups_.count(tag) );
+        assert( busy_[tag] );
+        if( groups_.count(tag) ){
+            const std::vector<int>& members = groups_[tag];
+            for( int m=0; m<int(members.size()); m++ )
+                recv_vector(members[m]);
+        }
+        else
+            recv_vector(tag);
+        busy_[tag] = false;
+        return 0;
+    }
+
+    template<typename Coord, typename Type>
+    void ThreadCommunicator<Coord, Type>::recv_vector( int tag ){
+        const mesh::Pattern& p = pattern();
+        long count = exchanges_[tag];
+        baseT* v = static_cast<baseT*>(const_cast<void*>(domains_.slot(rank_, tag).data));
+
+        // copy the values out of the vector of each neighbour as soon as it
+        // has been published
+        for( int i=0; i<p.num_neighbours(); i++ ){
+            int n = p.neighbour(i);
+            ThreadDomains::Slot& from = domains_.slot(n, tag);
+            wait_for( &from.published, count );
+
+            const std::vector<int>& send_index = domains_.pattern(n).send_index(rank_);
+            const std::vector<int>& recv_index = p.recv_index(n);
+            assert( send_index.size()==recv_index.size() );
+            const baseT* nv = static_cast<const baseT*>(from.data);
+            for( int j=0; j<int(recv_index.size()); j++ )
+                for( int k=0; k<block_size_; k++ )
+                    v[recv_index[j]*block_size_+k] = nv[send_index[j]*block_size_+k];
+        }
+
+        // tell the neighbours that their values have been read, then wait
+        // until they have read ours, as the wait for a send to complete
+        #pragma omp flush
+        domains_.slot(rank_, tag).consumed = count;
+        #pragma omp flush
+        for( int i=0; i<p.num_neighbours(); i++ )
+            wait_for( &domains_.slot(p.neighbour(i), tag).consumed, count );
+    }
+
+    template<typename Coord, typename Type>
+    int ThreadCommunicator<Coord, Type>::recv_all(){
+        for( std::map<int,bool>::iterator i=busy_.begin(); i!=busy_.end(); i++ )
+            if( i->second )
+                recv(i->first);
+        return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef MESH_BINARY_MESH_H
+#define MESH_BINARY_MESH_H
+
+#include "exception.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mesh {
+
+// Binary parallel mesh file format (.bpmesh)
+//
+// Holds exactly the same information as a text .pmesh file, laid out so that
+// it can be memory mapped and read in place.  All values are stored in the
+// native byte order of the machine that wrote the file: the byte_order field
+// is used to detect files written on a machine with a different endianness.
+//
+// header                                   56 bytes, see BinaryMeshHeader
+// x y z                  (repeat)          double[3*nodes]
+// vtxdist                                  int[n_dom+1]
+// global-id              (repeat)          int[n_nodes_ext]
+// node boundary offsets                    int[nodes+1]
+// node boundary tags                       int[n_node_boundaries]
+// element offsets                          int[elements+1]
+// type physical-tag [node-ids] [boundary-tags] (repeat)
+//                                          int[n_element_entries]
+//
+// The coordinates directly follow the header so that they are correctly
+// aligned in the mapped file.  Boundary tags for node i are stored in
+// [offset[i], offset[i+1]), and similarly the entries for element i.
+// A file is checked against its header when it is opened: the sections must
+// fill the file exactly and the offsets must lie within their sections, so
+// that a truncated or corrupt file throws an IOException rather than being
+// read out of bounds.
+
+struct BinaryMeshHeader {
+    char magic[8];
+    int version;
+    int byte_order;
+    int n_dom, dom_id;
+    int n_nodes_gbl, n_nodes_int, n_nodes_bnd, n_nodes_ext;
+    int n_elements_int, n_elements_bnd;
+    int n_node_boundaries;
+    int n_element_entries;
+
+    int nodes() const {
+        return n_nodes_int + n_nodes_bnd + n_nodes_ext;
+    }
+    int elements() const {
+        return n_elements_int + n_elements_bnd;
+    }
+};
+
+// the header is part of the file format, so its size must not change
+// without a new version
+typedef char binary_mesh_header_size_check[sizeof(BinaryMeshHeader) == 56 ? 1 : -1];
+
+const char binary_mesh_magic[8] = {'F','V','M','B','M','E','S','H'};
+const int binary_mesh_version = 1;
+const int binary_mesh_byte_order = 0x01020304;
+
+// read-only view of a memory mapped .bpmesh file
+class BinaryMeshFile {
+public:
+    explicit BinaryMeshFile(const std::string& filename);
+    ~BinaryMeshFile();
+
+    const BinaryMeshHeader& header() const;
+
+    const double* coordinates() const;
+    const int* vtxdist() const;
+    const int* external_nodes() const;
+    const int* node_boundary_offsets() const;
+    const int* node_boundaries() const;
+    const int* element_offsets() const;
+    const int* element_entries() const;
+
+    // size in bytes of a file with the given header
+    static std::size_t file_size(const BinaryMeshHeader& h);
+private:
+    BinaryMeshFile(const BinaryMeshFile&);
+    BinaryMeshFile& operator=(const BinaryMeshFile&);
+
+    // returns a description of what is wrong with the mapped file, or an
+    // empty string if it is consistent with its header
+    std::string check() const;
+    static bool counts_are_valid(const BinaryMeshHeader& h);
+    static bool offsets_are_valid(const int* offsets, int n, int end);
+
+    std::string filename_;
+    void* data_;
+    std::size_t size_;
+};
+
+// write a .bpmesh file
+void write_binary_mesh(const std::string& filename,
+                       BinaryMeshHeader h,
+                       const std::vector<double>& coordinates,
+                       const std::vector<int>& vtxdist,
+                       const std::vector<int>& external_nodes,
+                       const std::vector<int>& node_boundary_offsets,
+                       const std::vector<int>& node_boundaries,
+                       const std::vector<int>& element_offsets,
+                       const std::vector<int>& element_entries);
+
+inline
+std::size_t BinaryMeshFile::file_size(const BinaryMeshHeader& h) {
+    return sizeof(BinaryMeshHeader)
+         + sizeof(double) * 3 * std::size_t(h.nodes())
+         + sizeof(int) * (  std::size_t(h.n_dom) + 1
+                          + std::size_t(h.n_nodes_ext)
+                          + std::size_t(h.nodes()) + 1
+                          + std::size_t(h.n_node_boundaries)
+                          + std::size_t(h.elements()) + 1
+                          + std::size_t(h.n_element_entries) );
+}
+
+// the counts must be non-negative, and small enough that the sections can
+// be indexed with an int
+inline
+bool BinaryMeshFile::counts_are_valid(const BinaryMeshHeader& h) {
+    const long long max = 0x7fffffff;
+    long long nodes = (long long)h.n_nodes_int + h.n_nodes_bnd + h.n_nodes_ext;
+    long long elements = (long long)h.n_elements_int + h.n_elements_bnd;
+    return h.n_dom > 0 && h.dom_id >= 0 && h.dom_id < h.n_dom
+        && h.n_nodes_gbl >= 0 && h.n_nodes_int >= 0
+        && h.n_nodes_bnd >= 0 && h.n_nodes_ext >= 0
+        && h.n_elements_int >= 0 && h.n_elements_bnd >= 0
+        && h.n_node_boundaries >= 0 && h.n_element_entries >= 0
+        && h.n_dom < max && nodes < max && elements < max;
+}
+
+// offsets[0..n] must start at 0, never decrease and finish at end
+inline
+bool BinaryMeshFile::offsets_are_valid(const int* offsets, int n, int end) {
+    if( offsets[0] != 0 || offsets[n] != end )
+        return false;
+    for( int i = 0; i < n; ++i )
+        if( offsets[i+1] < offsets[i] )
+            return false;
+    return true;
+}
+
+inline
+std::string BinaryMeshFile::check() const {
+    const BinaryMeshHeader& h = header();
+    if( std::memcmp(h.magic, binary_mesh_magic, sizeof(h.magic)) )
+        return "not a binary mesh file: ";
+    if( h.byte_order != binary_mesh_byte_order )
+        return "binary mesh file was written with a different byte order: ";
+    if( h.version != binary_mesh_version )
+        return "unsupported binary mesh file version: ";
+    if( !counts_are_valid(h) )
+        return "binary mesh file has invalid counts in its header: ";
+    if( file_size(h) != size_ )
+        return "binary mesh file size does not match its header: ";
+    if( !offsets_are_valid(vtxdist(), h.n_dom, h.n_nodes_gbl) )
+        return "binary mesh file has an invalid node distribution: ";
+    if( !offsets_are_valid(node_boundary_offsets(), h.nodes(), h.n_node_boundaries) )
+        return "binary mesh file has invalid node boundary offsets: ";
+    if( !offsets_are_valid(element_offsets(), h.elements(), h.n_element_entries) )
+        return "binary mesh file has invalid element offsets: ";
+    return std::string();
+}
+
+inline
+BinaryMeshFile::BinaryMeshFile(const std::string& filename)
+    : filename_(filename), data_(0), size_(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if( fd < 0 )
+        throw IOException("Couldn't open file: " + filename);
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 ){
+        close(fd);
+        throw IOException("Couldn't stat file: " + filename);
+    }
+    size_ = st.st_size;
+    if( size_ < sizeof(BinaryMeshHeader) ){
+        close(fd);
+        throw IOException("Binary mesh file is truncated: " + filename);
+    }
+
+    data_ = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( data_ == MAP_FAILED ){
+        data_ = 0;
+        throw IOException("Couldn't memory map file: " + filename);
+    }
+    // the file is read front to back exactly once
+    madvise(data_, size_, MADV_SEQUENTIAL);
+
+    std::string error = check();
+    if( !error.empty() ){
+        munmap(data_, size_);
+        data_ = 0;
+        throw IOException(error + filename);
+    }
+}
+
+inline
+BinaryMeshFile::~BinaryMeshFile() {
+    if( data_ )
+        munmap(data_, size_);
+}
+
+inline
+const BinaryMeshHeader& BinaryMeshFile::header() const {
+    return *static_cast<const BinaryMeshHeader*>(data_);
+}
+
+inline
+const double* BinaryMeshFile::coordinates() const {
+    return reinterpret_cast<const double*>(
+        static_cast<const char*>(data_) + sizeof(BinaryMeshHeader));
+}
+
+inline
+const int* BinaryMeshFile::vtxdist() const {
+    return reinterpret_cast<const int*>(coordinates() + 3*header().nodes());
+}
+
+inline
+const int* BinaryMeshFile::external_nodes() const {
+    return vtxdist() + header().n_dom + 1;
+}
+
+inline
+const int* BinaryMeshFile::node_boundary_offsets() const {
+    return external_nodes() + header().n_nodes_ext;
+}
+
+inline
+const int* BinaryMeshFile::node_boundaries() const {
+    return node_boundary_offsets() + header().nodes() + 1;
+}
+
+inline
+const int* BinaryMeshFile::element_offsets() const {
+    return node_boundaries() + header().n_node_boundaries;
+}
+
+inline
+const int* BinaryMeshFile::element_entries() const {
+    return element_offsets() + header().elements() + 1;
+}
+
+inline
+void write_binary_mesh(const std::string& filename,
+                       BinaryMeshHeader h,
+                       const std::vector<double>& coordinates,
+                       const std::vector<int>& vtxdist,
+                       const std::vector<int>& external_nodes,
+                       const std::vector<int>& node_boundary_offsets,
+                       const std::vector<int>& node_boundaries,
+                       const std::vector<int>& element_offsets,
+                       const std::vector<int>& element_entries)
+{
+    std::memcpy(h.magic, binary_mesh_magic, sizeof(h.magic));
+    h.version = binary_mesh_version;
+    h.byte_order = binary_mesh_byte_order;
+    h.n_node_boundaries = node_boundaries.size();
+    h.n_element_entries = element_entries.size();
+
+    if(    coordinates.size() != 3*std::size_t(h.nodes())
+        || vtxdist.size() != std::size_t(h.n_dom) + 1
+        || external_nodes.size() != std::size_t(h.n_nodes_ext)
+        || node_boundary_offsets.size() != std::size_t(h.nodes()) + 1
+        || element_offsets.size() != std::size_t(h.elements()) + 1 )
+        throw IOException("Inconsistent binary mesh data for file: " + filename);
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if( !out )
+        throw IOException("Couldn't open file: " + filename);
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    if( !coordinates.empty() )
+        out.write(reinterpret_cast<const char*>(&coordinates[0]),
+                  sizeof(double)*coordinates.size());
+
+    const std::vector<int>* sections[] = {
+        &vtxdist, &external_nodes, &node_boundary_offsets, &node_boundaries,
+        &element_offsets, &element_entries
+    };
+    for( int i = 0; i < 6; ++i )
+        if( !sections[i]->empty() )
+            out.write(reinterpret_cast<const char*>(&(*sections[i])[0]),
+                      sizeof(int)*sections[i]->size());
+
+    if( !out )
+        throw IOException("Couldn't write file: " + filename);
+}
+
+} // end namespace mesh
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef MESH_BOX_MESH_H
+#define MESH_BOX_MESH_H
+
+#include "exception.h"
+#include "forward.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mesh {
+
+// Description of a box shaped mesh that mesh::Mesh generates in memory,
+// without any mesh files, e.g.
+//
+//   mesh::BoxMesh box(5, 128, 128, 128); // 128^3 hexahedra in the unit cube
+//   box.add_zone(0.5, 1);                // physical tag 1 for z > 0.5
+//   mesh::Mesh m(box, mpicomm);
+//
+// The box is divided into nx*ny*nz cells (nx*ny in 2D), and each cell is
+// split into elements of the chosen type:
+//
+//   2 triangle       2 per cell
+//   3 quadrilateral  1 per cell
+//   4 tetrahedron    6 per cell, around the cell diagonal
+//   5 hexahedron     1 per cell
+//   6 prism          2 per cell, split in the x-y plane
+//
+// The faces on the sides of the box are given boundary tags 1 (x = lower),
+// 2 (x = upper), 3 (y = lower), 4 (y = upper), 5 (z = lower) and 6
+// (z = upper).  Elements are given the physical tag of the zone that their
+// centroid lies in, with zones stacked along the last axis (z in 3D, y in 2D).
+class BoxMesh {
+public:
+    BoxMesh(int type, int nx, int ny, int nz=1);
+    // type: element type, numbered as in the mesh files
+    // nx, ny, nz: number of cells along each axis, nz is ignored in 2D
+
+    void set_extent(const Point& lower, const Point& upper);
+    // corners of the box, the default is the unit square/cube
+
+    void add_zone(double height, int physical_tag);
+    // elements whose centroid lies above height (along the last axis) are
+    // given physical_tag, unless a higher zone has been added
+    // elements below every zone have physical tag 0
+
+    int type() const;
+    int dim() const;
+    int cells(int axis) const;
+    // number of cells along axis, 1 for the z axis in 2D
+    double cells() const;
+    // total number of cells in the box
+    int elements_per_cell() const;
+    const Point& lower() const;
+    const Point& upper() const;
+
+    int physical_tag(double height) const;
+    // physical tag of an element whose centroid is at height
+
+    std::string name() const;
+    // short description, e.g. "box_hex_64x64x64"
+private:
+    int type_;
+    int cells_[3];
+    Point lower_, upper_;
+    std::vector<std::pair<double, int> > zones_; // (height, tag), sorted by height
+};
+
+inline
+BoxMesh::BoxMesh(int type, int nx, int ny, int nz)
+    : type_(type), lower_(0., 0., 0.), upper_(1., 1., 1.)
+{
+    if (type < 2 || type > 6) {
+        std::ostringstream oss;
+        oss << "BoxMesh: invalid element type " << type;
+        throw IOException(oss.str());
+    }
+    cells_[0] = nx;
+    cells_[1] = ny;
+    cells_[2] = dim() == 3 ? nz : 1;
+    if (cells_[0] < 1 || cells_[1] < 1 || cells_[2] < 1)
+        throw IOException("BoxMesh: there must be at least one cell along each axis");
+    if (dim() == 2)
+        upper_.z = 0.;
+}
+
+inline
+void BoxMesh::set_extent(const Point& lower, const Point& upper) {
+    lower_ = lower;
+    upper_ = upper;
+    if (dim() == 2)
+        lower_.z = upper_.z = 0.;
+}
+
+inline
+void BoxMesh::add_zone(double height, int physical_tag) {
+    zones_.push_back(std::make_pair(height, physical_tag));
+    std::stable_sort(zones_.begin(), zones_.end());
+}
+
+inline
+int BoxMesh::type() const {
+    return type_;
+}
+
+inline
+int BoxMesh::dim() const {
+    return type_ <= 3 ? 2 : 3;
+}
+
+inline
+int BoxMesh::cells(int axis) const {
+    return cells_[axis];
+}
+
+inline
+double BoxMesh::cells() const {
+    return double(cells_[0]) * cells_[1] * cells_[2];
+}
+
+inline
+int BoxMesh::elements_per_cell() const {
+    switch (type_) {
+        case 2: return 2;
+        case 4: return 6;
+        case 6: return 2;
+        default: return 1;
+    }
+}
+
+inline
+const Point& BoxMesh::lower() const {
+    return lower_;
+}
+
+inline
+const Point& BoxMesh::upper() const {
+    return upper_;
+}
+
+inline
+int BoxMesh::physical_tag(double height) const {
+    int tag = 0;
+    for (int i = 0; i < int(zones_.size()) && zones_[i].first < height; ++i)
+        tag = zones_[i].second;
+    return tag;
+}
+
+inline
+std::string BoxMesh::name() const {
+    const char* names[] = {"", "", "tri", "quad", "tet", "hex", "prism"};
+    std::ostringstream oss;
+    oss << "box_" << names[type_] << "_" << cells_[0] << "x" << cells_[1];
+    if (dim() == 3)
+        oss << "x" << cells_[2];
+    return oss.str();
+}
+
+} // end namespace mesh
+
+#endif
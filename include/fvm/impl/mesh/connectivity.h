@@ -0,0 +1,182 @@
+#ifndef MESH_CONNECTIVITY_H
+#define MESH_CONNECTIVITY_H
+
+#include "exception.h"
+
+#include <vector>
+
+namespace mesh {
+
+// read-only view of a contiguous range of entity ids
+class IndexRange {
+public:
+    IndexRange(const int* first, const int* last);
+
+    int size() const;
+    bool empty() const;
+    int operator[](int i) const;
+    // pre: i in [0, size())
+
+    const int* begin() const;
+    const int* end() const;
+private:
+    const int* first_;
+    const int* last_;
+};
+
+// Compressed sparse row (CSR) storage for the connectivity between mesh
+// entities.  The ids connected to entity i are held in the range
+// [offsets_[i], offsets_[i+1]) of a single array, so that a whole mesh
+// worth of connectivity is held in two allocations.
+class Connectivity {
+public:
+    Connectivity();
+
+    int rows() const;
+    // number of entities
+
+    int entries() const;
+    // total number of ids over all entities
+
+    int size(int i) const;
+    // number of ids connected to entity i
+
+    int offset(int i) const;
+    // position of the first id for entity i in the underlying array
+
+    int operator()(int i, int j) const;
+    // jth id connected to entity i
+    // pre: i in [0, rows()), j in [0, size(i))
+
+    IndexRange row(int i) const;
+    // ids connected to entity i
+
+    void append(int id);
+    // add an id to the entity being built
+
+    void finish_row();
+    // finish the entity being built, so that rows() increases by one
+
+    void assign(int rows, const std::vector<int>& row,
+                const std::vector<int>& id);
+    // replace the contents with rows entities, where id[k] is appended
+    // to entity row[k], keeping the order in which ids are given
+
+    void renumber(const std::vector<int>& q);
+    // replace every id with q[id]
+
+private:
+    friend class Mesh;
+    std::vector<int> offsets_;
+    std::vector<int> indices_;
+};
+
+inline
+IndexRange::IndexRange(const int* first, const int* last)
+    : first_(first), last_(last) {}
+
+inline
+int IndexRange::size() const {
+    return last_ - first_;
+}
+
+inline
+bool IndexRange::empty() const {
+    return first_ == last_;
+}
+
+inline
+int IndexRange::operator[](int i) const {
+    #ifdef MESH_DEBUG
+    if (i < 0 || i >= size())
+        throw OutOfRangeException("IndexRange::operator[](int): out of range");
+    #endif
+    return first_[i];
+}
+
+inline
+const int* IndexRange::begin() const {
+    return first_;
+}
+
+inline
+const int* IndexRange::end() const {
+    return last_;
+}
+
+inline
+Connectivity::Connectivity() : offsets_(1, 0) {}
+
+inline
+int Connectivity::rows() const {
+    return offsets_.size() - 1;
+}
+
+inline
+int Connectivity::entries() const {
+    return indices_.size();
+}
+
+inline
+int Connectivity::size(int i) const {
+    return offsets_[i+1] - offsets_[i];
+}
+
+inline
+int Connectivity::offset(int i) const {
+    return offsets_[i];
+}
+
+inline
+int Connectivity::operator()(int i, int j) const {
+    #ifdef MESH_DEBUG
+    if (i < 0 || i >= rows() || j < 0 || j >= size(i))
+        throw OutOfRangeException("Connectivity::operator()(int, int): out of range");
+    #endif
+    return indices_[offsets_[i] + j];
+}
+
+inline
+IndexRange Connectivity::row(int i) const {
+    #ifdef MESH_DEBUG
+    if (i < 0 || i >= rows())
+        throw OutOfRangeException("Connectivity::row(int): out of range");
+    #endif
+    const int* first = indices_.empty() ? 0 : &indices_[0];
+    return IndexRange(first + offsets_[i], first + offsets_[i+1]);
+}
+
+inline
+void Connectivity::append(int id) {
+    indices_.push_back(id);
+}
+
+inline
+void Connectivity::finish_row() {
+    offsets_.push_back(indices_.size());
+}
+
+inline
+void Connectivity::assign(int rows, const std::vector<int>& row,
+                          const std::vector<int>& id) {
+    // counting sort, which is stable
+    offsets_.assign(rows+1, 0);
+    for (int k = 0; k < int(row.size()); ++k)
+        ++offsets_[row[k]+1];
+    for (int i = 0; i < rows; ++i)
+        offsets_[i+1] += offsets_[i];
+    std::vector<int> next(offsets_.begin(), offsets_.end()-1);
+    indices_.resize(id.size());
+    for (int k = 0; k < int(row.size()); ++k)
+        indices_[next[row[k]]++] = id[k];
+}
+
+inline
+void Connectivity::renumber(const std::vector<int>& q) {
+    for (int k = 0; k < entries(); ++k)
+        indices_[k] = q[indices_[k]];
+}
+
+} // end namespace mesh
+
+#endif
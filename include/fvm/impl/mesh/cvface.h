@@ -8,6 +8,7 @@ namespace mesh {
 
 class CVFace {
 public:
+    CVFace();
     CVFace(const Mesh& mesh, int id,
            int element_id, int front_id,
            int back_id, int boundary_id,
@@ -94,6 +94,12 @@ bool operator<(const CVFace& a, const CVFace& b) {
     */
 }
 
+inline
+CVFace::CVFace()
+    : m(0), my_id(-1), element_id(-1), front_id(-1), back_id(-1),
+      boundary_id(0), edge_id(-1), shape(), my_tag(-1), my_area(0.0),
+      my_normal(), my_centroid() {}
+
 inline
 CVFace::CVFace(const Mesh& mesh, int id, int element,
                int front_id, int back_id, int boundary,
@@ -11,6 +11,7 @@ namespace mesh {
 
 class CVFace_shape {
 public:
+    CVFace_shape() : points_(0) {}
     CVFace_shape(Point p0, Point p1, Point p2, Point p3) {
         p[0] = p0; p[1] = p1; p[2] = p2; p[3] = p3; points_ = 4;
         // assert coplanar
@@ -14,11 +14,9 @@ public:
 //            const std::vector<int>& nodevec,
 //            const std::vector<int>& edgevec,
 //            const std::vector<int>& facevec);
-    Element(const Mesh& mesh, int type, int id,
-            const std::vector<int>& nodevec,
-            const std::vector<int>& edgevec,
-            const std::vector<int>& facevec,
-            int physical_tag);
+    Element(const Mesh& mesh, int type, int id, int physical_tag);
+    // The node, edge and face ids of the element are held by the mesh, and
+    // its nodes must have been recorded there before it is constructed.
 
     int id() const;
     int physical_tag() const;
@@ -60,18 +58,9 @@ private:
     int my_id;
     int my_physical_tag;
     int my_type; // NEWMESH
-    std::vector<int> nodevec;
-    std::vector<int> edgevec;
-    std::vector<int> facevec;
-    std::vector<int> scvvec;
-    std::vector<int> cvfacevec;
-    std::vector<int> neighbourvec;
     Point my_centroid;
 
     friend class Mesh;
-    void add_scv(int id);
-    void add_cvface(int id);
-    void add_neighbour(int id);
 };
 
 } // end namespace mesh
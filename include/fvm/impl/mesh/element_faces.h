@@ -0,0 +1,36 @@
+#ifndef MESH_ELEMENT_FACES_H
+#define MESH_ELEMENT_FACES_H
+
+namespace mesh {
+
+// Nodes of the faces of each element type, with element types numbered as in
+// the mesh files.  The faces are in the order that the boundary tags of an
+// element are given (and Mesh::construct_edges_and_faces numbers them), and
+// unused entries are -1.
+const int element_face_nodes[7][6][4] = {
+    {}, {},
+    { {0,1,-1,-1}, {1,2,-1,-1}, {2,0,-1,-1} },                  // triangle
+    { {0,1,-1,-1}, {1,2,-1,-1}, {2,3,-1,-1}, {3,0,-1,-1} },     // quadrilateral
+    { {0,1,2,-1}, {0,1,3,-1}, {0,2,3,-1}, {1,2,3,-1} },         // tetrahedron
+    { {1,0,3,2}, {4,5,6,7}, {0,1,5,4},                          // hexahedron
+      {1,2,6,5}, {2,3,7,6}, {3,0,4,7} },
+    { {0,1,2,-1}, {3,4,5,-1}, {0,1,4,3}, {1,2,5,4}, {2,0,3,5} } // prism
+};
+
+// number of faces of an element of the given type
+inline
+int element_face_count(int type) {
+    const int count[7] = {0, 0, 3, 4, 4, 6, 5};
+    return count[type];
+}
+
+// number of nodes in face f of an element of the given type
+inline
+int element_face_size(int type, int f) {
+    return element_face_nodes[type][f][3] < 0 ?
+        (element_face_nodes[type][f][2] < 0 ? 2 : 3) : 4;
+}
+
+} // end namespace mesh
+
+#endif
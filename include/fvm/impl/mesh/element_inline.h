@@ -27,32 +27,33 @@ int Element::physical_tag() const {
 
 inline
 int Element::nodes() const {
-    return nodevec.size();
+    return m->element_nodes_.size(my_id);
 }
 
 inline
 int Element::edges() const {
-    return edgevec.size();
+    return m->element_edges_.size(my_id);
 }
 
 inline
 int Element::faces() const {
-    return facevec.size();
+    return m->element_faces_.size(my_id);
 }
 
 inline
 int Element::scvs() const {
-    return scvvec.size();
+    // there is one SCV for each node of the element
+    return nodes();
 }
 
 inline
 int Element::cvfaces() const {
-    return cvfacevec.size();
+    return m->element_cvfaces_.size(my_id);
 }
 
 inline
 int Element::neighbours() const {
-    return neighbourvec.size();
+    return m->element_neighbours_.size(my_id);
 }
 
 inline
@@ -68,7 +69,7 @@ const Node& Element::node(int i) const {
     if (i < 0 || i >= nodes())
         throw OutOfRangeException("Element::node(int): out of range");
     #endif
-    return mesh().node(nodevec[i]);
+    return mesh().node(m->element_nodes_(my_id, i));
 }
 
 inline
@@ -77,7 +78,7 @@ const Edge& Element::edge(int i) const {
     if (i < 0 || i >= edges())
         throw OutOfRangeException("Element::edge(int): out of range");
     #endif
-    return mesh().edge(edgevec[i]);
+    return mesh().edge(m->element_edges_(my_id, i));
 }
 
 inline
@@ -86,7 +87,7 @@ const Face& Element::face(int i) const {
     if (i < 0 || i >= faces())
         throw OutOfRangeException("Element::face(int): out of range");
     #endif
-    return mesh().face(facevec[i]);
+    return mesh().face(m->element_faces_(my_id, i));
 }
 
 inline
@@ -95,7 +96,8 @@ const SCV& Element::scv(int i) const {
     if (i < 0 || i >= scvs())
         throw OutOfRangeException("Element::scv(int): out of range");
     #endif
-    return mesh().scv(scvvec[i]);
+    // the SCVs of an element are numbered in the same order as its nodes
+    return mesh().scv(m->element_nodes_.offset(my_id) + i);
 }
 
 inline
@@ -104,7 +106,7 @@ const CVFace& Element::cvface(int i) const {
     if (i < 0 || i >= cvfaces())
         throw OutOfRangeException("Element::cvface(int): out of range");
     #endif
-    return mesh().cvface(cvfacevec[i]);
+    return mesh().cvface(m->element_cvfaces_(my_id, i));
 }
 
 inline
@@ -113,7 +115,7 @@ const Element& Element::neighbour(int i) const {
     if (i < 0 || i >= neighbours())
         throw OutOfRangeException("Element::neighbour(int): out of range");
     #endif
-    return mesh().element(neighbourvec[i]);
+    return mesh().element(m->element_neighbours_(my_id, i));
 }
 
 inline
@@ -122,25 +124,25 @@ int Element::node_id(int i) const {
     if (i < 0 || i >= nodes())
         throw OutOfRangeException("Element::node_id(int): out of range");
     #endif
-    return nodevec[i];
+    return m->element_nodes_(my_id, i);
 }
 
 inline
 int Element::edge_id(int i) const {
     #ifdef MESH_DEBUG
-    if (i < 0 || i >= nodes())
+    if (i < 0 || i >= edges())
         throw OutOfRangeException("Element::edge_id(int): out of range");
     #endif
-    return edgevec[i];
+    return m->element_edges_(my_id, i);
 }
 
 inline
 int Element::face_id(int i) const {
     #ifdef MESH_DEBUG
-    if (i < 0 || i >= nodes())
+    if (i < 0 || i >= faces())
         throw OutOfRangeException("Element::face_id(int): out of range");
     #endif
-    return facevec[i];
+    return m->element_faces_(my_id, i);
 }
 
 inline
@@ -148,32 +150,13 @@ Point Element::centroid() const {
     return my_centroid;
 }
 
-inline
-void Element::add_scv(int id) {
-    scvvec.push_back(id);
-}
-
-inline
-void Element::add_cvface(int id) {
-    cvfacevec.push_back(id);
-}
-
-inline
-void Element::add_neighbour(int id) {
-    neighbourvec.push_back(id);
-}
-
 inline
 Element::Element() : m(0), my_id(-1), my_centroid() {}
 
 inline
-Element::Element(const Mesh& mesh, int type, int id,
-                 const std::vector<int>& nodevec,
-                 const std::vector<int>& edgevec,
-                 const std::vector<int>& facevec,
-                 int physical_tag)
+Element::Element(const Mesh& mesh, int type, int id, int physical_tag)
     : m(&mesh), my_id(id), my_physical_tag(physical_tag), my_type(type),
-      nodevec(nodevec), edgevec(edgevec), facevec(facevec)
+      my_centroid()
 {
     for (int i = 0; i < nodes(); ++i)
         my_centroid += node(i).point();
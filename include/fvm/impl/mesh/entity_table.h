@@ -0,0 +1,134 @@
+#ifndef MESH_ENTITY_TABLE_H
+#define MESH_ENTITY_TABLE_H
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace mesh {
+
+// Open addressing hash table used to remove duplicate edges and faces while
+// a mesh is constructed.  Entities are identified by their (up to four) node
+// ids, irrespective of the order the nodes are given in.  Ids are handed out
+// in the order that distinct entities are first inserted, the same as
+// inserting into a std::set and taking its size as the id.
+class EntityTable {
+public:
+    explicit EntityTable(int expected=0);
+
+    std::pair<int, bool> insert(int n, const int* nodes);
+    // returns the id of the entity with nodes[0..n), and whether it was added
+    // pre: n in [2, 4]
+
+    int find(int n, const int* nodes) const;
+    // returns the id of the entity with nodes[0..n), or -1 if there is none
+    // pre: n in [2, 4]
+
+    int size() const;
+    // number of distinct entities in the table
+
+private:
+    struct Key {
+        int n[4];
+        bool operator==(const Key& other) const {
+            return n[0] == other.n[0] && n[1] == other.n[1]
+                && n[2] == other.n[2] && n[3] == other.n[3];
+        }
+    };
+
+    static Key make_key(int n, const int* nodes);
+    static std::size_t hash(const Key& key);
+    void rehash(std::size_t capacity);
+
+    std::vector<Key> keys_;  // key of each entity, indexed by id
+    std::vector<int> slots_; // entity id in each slot, -1 if empty
+    std::size_t mask_;
+};
+
+inline
+EntityTable::EntityTable(int expected) : mask_(0) {
+    keys_.reserve(expected);
+    std::size_t capacity = 16;
+    while (capacity < 2*std::size_t(expected))
+        capacity *= 2;
+    rehash(capacity);
+}
+
+inline
+int EntityTable::size() const {
+    return keys_.size();
+}
+
+inline
+std::size_t EntityTable::hash(const Key& key) {
+    unsigned long long h = 0;
+    for (int i = 0; i < 4; ++i) {
+        h ^= static_cast<unsigned int>(key.n[i]);
+        h *= 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    return static_cast<std::size_t>(h);
+}
+
+inline
+void EntityTable::rehash(std::size_t capacity) {
+    slots_.assign(capacity, -1);
+    mask_ = capacity - 1;
+    for (int id = 0; id < size(); ++id) {
+        std::size_t slot = hash(keys_[id]) & mask_;
+        while (slots_[slot] != -1)
+            slot = (slot + 1) & mask_;
+        slots_[slot] = id;
+    }
+}
+
+// the key is the sorted node ids, padded with -1
+inline
+EntityTable::Key EntityTable::make_key(int n, const int* nodes) {
+    assert(n >= 2 && n <= 4);
+    Key key;
+    for (int i = 0; i < 4; ++i)
+        key.n[i] = i < n ? nodes[i] : -1;
+    for (int i = 1; i < n; ++i)
+        for (int j = i; j > 0 && key.n[j] < key.n[j-1]; --j)
+            std::swap(key.n[j], key.n[j-1]);
+    return key;
+}
+
+inline
+int EntityTable::find(int n, const int* nodes) const {
+    Key key = make_key(n, nodes);
+    std::size_t slot = hash(key) & mask_;
+    while (slots_[slot] != -1) {
+        if (keys_[slots_[slot]] == key)
+            return slots_[slot];
+        slot = (slot + 1) & mask_;
+    }
+    return -1;
+}
+
+inline
+std::pair<int, bool> EntityTable::insert(int n, const int* nodes) {
+    Key key = make_key(n, nodes);
+
+    // linear probing
+    std::size_t slot = hash(key) & mask_;
+    while (slots_[slot] != -1) {
+        if (keys_[slots_[slot]] == key)
+            return std::make_pair(slots_[slot], false);
+        slot = (slot + 1) & mask_;
+    }
+
+    int id = size();
+    keys_.push_back(key);
+    slots_[slot] = id;
+
+    // keep the load factor below one half
+    if (2*keys_.size() > slots_.size())
+        rehash(2*slots_.size());
+    return std::make_pair(id, true);
+}
+
+} // end namespace mesh
+
+#endif
@@ -10,9 +10,9 @@ namespace mesh {
 class Face {
 public:
     Face();
-    Face(const Mesh& mesh, int id, int boundary,
-         const std::vector<int>& nodevec,
-         const std::vector<int>& edgevec);
+    Face(const Mesh& mesh, int id, int boundary);
+    // The node and edge ids of the face are held by the mesh, and its nodes
+    // must have been recorded there before it is constructed.
 
     int id() const;
     int boundary() const;
@@ -23,19 +23,6 @@ public:
     const Edge& edge(int i) const;
     Point centroid() const;
 
-    static Face line(const Mesh& mesh, int id, int boundary,
-                     int node0, int node1, int face0);
-
-    static Face triangular(const Mesh& mesh, int id, int boundary,
-                           int node0, int node1, int node2,
-                           int face0, int face1, int face2);
-
-    static Face rectangular(const Mesh& mesh, int id, int boundary,
-                            int node0, int node1,
-                            int node2, int node3,
-                            int face0, int face1,
-                            int face2, int face3);
-
     std::pair<int, int> edges_from_node(const Node&) const;
 
 private:
@@ -43,8 +30,6 @@ private:
     const Mesh* m;
     int my_id;
     int boundary_id;
-    std::vector<int> nodevec;
-    std::vector<int> edgevec;
     Point my_centroid;
     friend bool operator<(const Face&, const Face&);
 };
@@ -9,6 +9,9 @@ namespace mesh {
 using util::Point;
 
 class Mesh;
+class BoxMesh;
+class GlobalMesh;
+class ThreadPartition;
 class Node;
 class Edge;
 class Face;
@@ -16,6 +19,8 @@ class Element;
 class CVFace;
 class SCV;
 class Volume;
+class EntityTable;
+struct BinaryMeshHeader;
 
 }
 
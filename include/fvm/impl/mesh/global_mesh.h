@@ -0,0 +1,525 @@
+#ifndef MESH_GLOBAL_MESH_H
+#define MESH_GLOBAL_MESH_H
+
+#include "exception.h"
+#include "forward.h"
+#include "connectivity.h"
+#include "element_faces.h"
+#include "entity_table.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mesh {
+
+// A whole (not partitioned) mesh, which every domain reads before taking its
+// part of it.  Two file formats are read:
+//
+//  meshname.mesh  the global mesh written by meshing/Mesh.py for decomp
+//  meshname.msh   a gmsh file, in ASCII format version 2 or 4.1
+//
+// From a gmsh file the mesh holds what meshing/Mesh.py extracts:
+//
+//  - the elements of the mesh dimension (types 2-3 in 2D, 4-6 in 3D), with
+//    the physical tag of each element as given in the file
+//  - the boundary tag of each element face, which is the physical tag of the
+//    line (2D) or triangle/quadrilateral (3D) element that covers the face,
+//    or zero if there is none
+//  - the nodes that the elements use, in the order of the file, each with
+//    the boundary tags of the boundary faces that touch it
+//
+// The boundary faces are matched to the element faces with a hash table, so
+// reading takes time linear in the size of the mesh.
+class GlobalMesh {
+public:
+    explicit GlobalMesh(const std::string& filename);
+    // the format is chosen by the extension of filename
+
+    int dim() const;
+    int nodes() const;
+    int elements() const;
+
+    const Point& point(int i) const;
+    // coordinates of node i
+
+    IndexRange node_boundaries(int i) const;
+    // distinct boundary tags of node i, in the order they appear in the file
+
+    int element_type(int i) const;
+    int element_tag(int i) const;
+    // physical tag of element i
+
+    IndexRange element_nodes(int i) const;
+    IndexRange element_boundaries(int i) const;
+    // boundary tag of each face of element i, 0 for faces not on a boundary
+private:
+    void read_mesh_file(std::ifstream&);
+    void read_gmsh_file(std::ifstream&);
+    void read_format(std::ifstream&);
+    void read_entities(std::ifstream&);
+    void read_nodes_v2(std::ifstream&);
+    void read_nodes_v4(std::ifstream&);
+    void read_elements_v2(std::ifstream&);
+    void read_elements_v4(std::ifstream&);
+    void add_node(int tag, const Point& p);
+    void add_element(int type, int tag, const std::vector<int>& nodes);
+    void build();
+
+    static int nodes_of_type(int type);
+
+    std::string filename_;
+    int version_;
+    int dim_;
+    std::map<std::pair<int, int>, int> entity_tags_; // physical tag of (dim, entity)
+    std::vector<int> node_tags_;    // gmsh tags of the nodes in the file
+    std::vector<Point> file_points_;
+    std::vector<int> raw_types_, raw_tags_; // every element in the file
+    Connectivity raw_nodes_;                // with gmsh node tags
+
+    std::vector<Point> points_;
+    Connectivity node_boundaries_;
+    std::vector<int> element_types_, element_tags_;
+    Connectivity element_nodes_;
+    Connectivity element_boundaries_;
+};
+
+inline
+GlobalMesh::GlobalMesh(const std::string& filename)
+    : filename_(filename), version_(0), dim_(2)
+{
+    std::ifstream in(filename.c_str());
+    if (!in)
+        throw IOException("Couldn't open file: " + filename);
+    std::string::size_type dot = filename.rfind('.');
+    if (dot != std::string::npos && filename.substr(dot) == ".msh")
+        read_gmsh_file(in);
+    else
+        read_mesh_file(in);
+    if (elements() == 0)
+        throw IOException("No elements in mesh file: " + filename);
+}
+
+// n_nodes n_elements
+// x y z n_tags [boundary-tags] (repeat)
+// type physical-tag [node-ids] [face-boundary-tags] (repeat)
+inline
+void GlobalMesh::read_mesh_file(std::ifstream& in) {
+    int n_nodes, n_elements;
+    in >> n_nodes >> n_elements;
+    if (!in)
+        throw IOException("Couldn't read header of mesh file: " + filename_);
+
+    points_.reserve(n_nodes);
+    for (int i = 0; i < n_nodes; ++i) {
+        Point p;
+        int n;
+        in >> p.x >> p.y >> p.z >> n;
+        for (int j = 0; j < n; ++j) {
+            int tag;
+            in >> tag;
+            node_boundaries_.append(tag);
+        }
+        node_boundaries_.finish_row();
+        points_.push_back(p);
+    }
+    if (!in)
+        throw IOException("Couldn't read nodes of mesh file: " + filename_);
+
+    element_types_.reserve(n_elements);
+    element_tags_.reserve(n_elements);
+    for (int e = 0; e < n_elements; ++e) {
+        int type, tag;
+        in >> type >> tag;
+        if (type == 4 || type == 5 || type == 6)
+            dim_ = 3;
+        int n_nodes = type >= 2 && type <= 6 ? nodes_of_type(type) : 0;
+        if (!in || n_nodes == 0) {
+            std::ostringstream oss;
+            oss << "Couldn't read element " << e << " of mesh file: " << filename_;
+            throw IOException(oss.str());
+        }
+        element_types_.push_back(type);
+        element_tags_.push_back(tag);
+        for (int j = 0; j < n_nodes; ++j) {
+            int id;
+            in >> id;
+            element_nodes_.append(id);
+        }
+        element_nodes_.finish_row();
+        for (int f = 0; f < element_face_count(type); ++f) {
+            in >> tag;
+            element_boundaries_.append(tag);
+        }
+        element_boundaries_.finish_row();
+    }
+    if (!in)
+        throw IOException("Couldn't read elements of mesh file: " + filename_);
+}
+
+inline
+void GlobalMesh::read_gmsh_file(std::ifstream& in) {
+    std::string section;
+    while (in >> section) {
+        if (section == "$MeshFormat")
+            read_format(in);
+        else if (section == "$Entities" && version_ == 4)
+            read_entities(in);
+        else if (section == "$Nodes")
+            version_ == 4 ? read_nodes_v4(in) : read_nodes_v2(in);
+        else if (section == "$Elements")
+            version_ == 4 ? read_elements_v4(in) : read_elements_v2(in);
+        else if (section[0] != '$')
+            continue;
+        if (!in)
+            throw IOException("Couldn't read " + section + " in gmsh file: " + filename_);
+
+        // skip to the end of the section
+        std::string end = "$End" + section.substr(1);
+        while (section != end && in >> section) ;
+    }
+    if (version_ == 0)
+        throw IOException("No $MeshFormat in gmsh file: " + filename_);
+
+    build();
+}
+
+inline
+int GlobalMesh::dim() const {
+    return dim_;
+}
+
+inline
+int GlobalMesh::nodes() const {
+    return points_.size();
+}
+
+inline
+int GlobalMesh::elements() const {
+    return element_types_.size();
+}
+
+inline
+const Point& GlobalMesh::point(int i) const {
+    return points_[i];
+}
+
+inline
+IndexRange GlobalMesh::node_boundaries(int i) const {
+    return node_boundaries_.row(i);
+}
+
+inline
+int GlobalMesh::element_type(int i) const {
+    return element_types_[i];
+}
+
+inline
+int GlobalMesh::element_tag(int i) const {
+    return element_tags_[i];
+}
+
+inline
+IndexRange GlobalMesh::element_nodes(int i) const {
+    return element_nodes_.row(i);
+}
+
+inline
+IndexRange GlobalMesh::element_boundaries(int i) const {
+    return element_boundaries_.row(i);
+}
+
+// number of nodes of a gmsh element type, zero for types that are not
+// supported
+inline
+int GlobalMesh::nodes_of_type(int type) {
+    switch (type) {
+        case 1: return 2;   // line
+        case 2: return 3;   // triangle
+        case 3: return 4;   // quadrilateral
+        case 4: return 4;   // tetrahedron
+        case 5: return 8;   // hexahedron
+        case 6: return 6;   // prism
+        case 15: return 1;  // point
+        default: return 0;
+    }
+}
+
+inline
+void GlobalMesh::read_format(std::ifstream& in) {
+    double version;
+    int file_type, data_size;
+    in >> version >> file_type >> data_size;
+    if (!in)
+        throw IOException("Couldn't read $MeshFormat in gmsh file: " + filename_);
+    if (file_type != 0)
+        throw IOException("Binary gmsh files are not supported, save the mesh "
+                          "in ASCII format: " + filename_);
+    if (version >= 2.0 && version < 3.0)
+        version_ = 2;
+    else if (version >= 4.1 && version < 5.0)
+        version_ = 4;
+    else {
+        std::ostringstream oss;
+        oss << "Unsupported gmsh file version " << version
+            << " (versions 2 and 4.1 are supported): " << filename_;
+        throw IOException(oss.str());
+    }
+}
+
+// the physical tag of each geometric entity, used for the elements in
+// version 4 files
+inline
+void GlobalMesh::read_entities(std::ifstream& in) {
+    int counts[4];
+    in >> counts[0] >> counts[1] >> counts[2] >> counts[3];
+    for (int d = 0; d < 4 && in; ++d) {
+        for (int i = 0; i < counts[d]; ++i) {
+            int tag, n;
+            double x;
+            in >> tag;
+            // points have coordinates, the others a bounding box
+            for (int j = 0; j < (d == 0 ? 3 : 6); ++j)
+                in >> x;
+            in >> n;
+            int physical = 0;
+            for (int j = 0; j < n; ++j) {
+                int p;
+                in >> p;
+                if (j == 0)
+                    physical = p;
+            }
+            if (d > 0) {
+                // bounding entities
+                in >> n;
+                for (int j = 0; j < n; ++j) {
+                    int b;
+                    in >> b;
+                }
+            }
+            if (!in)
+                return;
+            entity_tags_[std::make_pair(d, tag)] = physical;
+        }
+    }
+}
+
+inline
+void GlobalMesh::add_node(int tag, const Point& p) {
+    node_tags_.push_back(tag);
+    file_points_.push_back(p);
+}
+
+inline
+void GlobalMesh::add_element(int type, int tag, const std::vector<int>& nodes) {
+    if (type == 4 || type == 5 || type == 6)
+        dim_ = 3;
+    raw_types_.push_back(type);
+    raw_tags_.push_back(tag);
+    for (int i = 0; i < int(nodes.size()); ++i)
+        raw_nodes_.append(nodes[i]);
+    raw_nodes_.finish_row();
+}
+
+inline
+void GlobalMesh::read_nodes_v2(std::ifstream& in) {
+    int n;
+    in >> n;
+    node_tags_.reserve(n);
+    file_points_.reserve(n);
+    for (int i = 0; i < n && in; ++i) {
+        int tag;
+        Point p;
+        in >> tag >> p.x >> p.y >> p.z;
+        add_node(tag, p);
+    }
+}
+
+inline
+void GlobalMesh::read_nodes_v4(std::ifstream& in) {
+    int blocks, n, min_tag, max_tag;
+    in >> blocks >> n >> min_tag >> max_tag;
+    node_tags_.reserve(n);
+    file_points_.reserve(n);
+    for (int b = 0; b < blocks && in; ++b) {
+        int entity_dim, entity, parametric, count;
+        in >> entity_dim >> entity >> parametric >> count;
+        std::vector<int> tags(count);
+        for (int i = 0; i < count; ++i)
+            in >> tags[i];
+        for (int i = 0; i < count; ++i) {
+            Point p;
+            in >> p.x >> p.y >> p.z;
+            // skip the parametric coordinates
+            for (int j = 0; parametric && j < entity_dim; ++j) {
+                double u;
+                in >> u;
+            }
+            add_node(tags[i], p);
+        }
+    }
+}
+
+inline
+void GlobalMesh::read_elements_v2(std::ifstream& in) {
+    int n;
+    in >> n;
+    std::vector<int> nodes;
+    for (int i = 0; i < n && in; ++i) {
+        int id, type, n_tags;
+        in >> id >> type >> n_tags;
+        std::vector<int> tags(n_tags);
+        for (int j = 0; j < n_tags; ++j)
+            in >> tags[j];
+        int n_nodes = nodes_of_type(type);
+        if (n_nodes == 0) {
+            std::ostringstream oss;
+            oss << "Unsupported element type " << type << " in gmsh file: " << filename_;
+            throw IOException(oss.str());
+        }
+        nodes.resize(n_nodes);
+        for (int j = 0; j < n_nodes; ++j)
+            in >> nodes[j];
+        // the first tag is the physical tag
+        add_element(type, n_tags ? tags[0] : 0, nodes);
+    }
+}
+
+inline
+void GlobalMesh::read_elements_v4(std::ifstream& in) {
+    int blocks, n, min_tag, max_tag;
+    in >> blocks >> n >> min_tag >> max_tag;
+    std::vector<int> nodes;
+    for (int b = 0; b < blocks && in; ++b) {
+        int entity_dim, entity, type, count;
+        in >> entity_dim >> entity >> type >> count;
+        int n_nodes = nodes_of_type(type);
+        if (n_nodes == 0) {
+            std::ostringstream oss;
+            oss << "Unsupported element type " << type << " in gmsh file: " << filename_;
+            throw IOException(oss.str());
+        }
+        std::map<std::pair<int, int>, int>::const_iterator it =
+            entity_tags_.find(std::make_pair(entity_dim, entity));
+        int tag = it == entity_tags_.end() ? 0 : it->second;
+        nodes.resize(n_nodes);
+        for (int i = 0; i < count; ++i) {
+            int id;
+            in >> id;
+            for (int j = 0; j < n_nodes; ++j)
+                in >> nodes[j];
+            add_element(type, tag, nodes);
+        }
+    }
+}
+
+inline
+void GlobalMesh::build() {
+    bool is_element[16] = {false};
+    bool is_face[16] = {false};
+    if (dim_ == 3) {
+        is_element[4] = is_element[5] = is_element[6] = true;
+        is_face[2] = is_face[3] = true;
+    } else {
+        is_element[2] = is_element[3] = true;
+        is_face[1] = true;
+    }
+
+    // index the nodes by gmsh tag
+    int max_tag = 0;
+    for (int i = 0; i < int(node_tags_.size()); ++i)
+        max_tag = std::max(max_tag, node_tags_[i]);
+    std::vector<int> file_index(max_tag+1, -1);
+    for (int i = 0; i < int(node_tags_.size()); ++i)
+        file_index[node_tags_[i]] = i;
+
+    // keep the nodes that are used by an element, in file order
+    std::vector<int> index(node_tags_.size(), -1);
+    int n_raw = raw_types_.size();
+    for (int e = 0; e < n_raw; ++e) {
+        if (!is_element[raw_types_[e]])
+            continue;
+        for (int j = 0; j < raw_nodes_.size(e); ++j) {
+            int tag = raw_nodes_(e, j);
+            if (tag < 0 || tag > max_tag || file_index[tag] < 0)
+                throw IOException("Element refers to an undefined node in gmsh file: " + filename_);
+            index[file_index[tag]] = 0;
+        }
+    }
+    for (int i = 0; i < int(index.size()); ++i) {
+        if (index[i] == 0) {
+            index[i] = points_.size();
+            points_.push_back(file_points_[i]);
+        }
+    }
+    std::vector<Point>().swap(file_points_);
+    std::vector<int>().swap(node_tags_);
+
+    // the boundary faces, with the boundary tags of the nodes that they touch
+    EntityTable facetable;
+    std::vector<int> face_tags;
+    std::vector<std::vector<int> > node_tags(points_.size());
+    for (int e = 0; e < n_raw; ++e) {
+        int tag = raw_tags_[e];
+        if (!is_face[raw_types_[e]] || tag == 0)
+            continue;
+        int n = raw_nodes_.size(e);
+        int ids[4];
+        bool used = true;
+        for (int j = 0; j < n; ++j) {
+            int k = raw_nodes_(e, j) <= max_tag ? file_index[raw_nodes_(e, j)] : -1;
+            ids[j] = k < 0 ? -1 : index[k];
+            used = used && ids[j] >= 0;
+        }
+        if (!used)
+            continue;
+        if (facetable.insert(n, ids).second)
+            face_tags.push_back(tag);
+        for (int j = 0; j < n; ++j) {
+            std::vector<int>& tags = node_tags[ids[j]];
+            if (std::find(tags.begin(), tags.end(), tag) == tags.end())
+                tags.push_back(tag);
+        }
+    }
+    for (int i = 0; i < nodes(); ++i) {
+        for (int j = 0; j < int(node_tags[i].size()); ++j)
+            node_boundaries_.append(node_tags[i][j]);
+        node_boundaries_.finish_row();
+    }
+
+    // the elements, with the boundary tag of each face
+    for (int e = 0; e < n_raw; ++e) {
+        int type = raw_types_[e];
+        if (!is_element[type])
+            continue;
+        element_types_.push_back(type);
+        element_tags_.push_back(raw_tags_[e]);
+        int ids[8];
+        for (int j = 0; j < raw_nodes_.size(e); ++j) {
+            ids[j] = index[file_index[raw_nodes_(e, j)]];
+            element_nodes_.append(ids[j]);
+        }
+        element_nodes_.finish_row();
+
+        for (int f = 0; f < element_face_count(type); ++f) {
+            int face[4];
+            int n = element_face_size(type, f);
+            for (int j = 0; j < n; ++j)
+                face[j] = ids[element_face_nodes[type][f][j]];
+            int id = facetable.find(n, face);
+            element_boundaries_.append(id < 0 ? 0 : face_tags[id]);
+        }
+        element_boundaries_.finish_row();
+    }
+    std::vector<int>().swap(raw_types_);
+    std::vector<int>().swap(raw_tags_);
+    raw_nodes_ = Connectivity();
+}
+
+} // end namespace mesh
+
+#endif
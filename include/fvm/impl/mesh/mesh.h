@@ -3,6 +3,7 @@
 
 #include <mpi/mpicomm.h>
 #include <fvm/impl/communicators/pattern.h>
+#include <fvm/impl/mesh/connectivity.h>
 
 #include <fstream>
 #include <set>
@@ -11,14 +12,48 @@
 
 namespace mesh {
 
+// orderings that can be applied to the local nodes of a mesh
+enum node_ordering {
+    ordering_rcm,     // reverse Cuthill-McKee, minimises matrix bandwidth
+    ordering_hilbert, // Hilbert space filling curve through the node coordinates
+    ordering_morton,  // Morton (Z-order) space filling curve
+    ordering_none     // the order of the mesh file
+};
+
 class Mesh {
 public:
-    Mesh(const std::string& meshname, mpi::MPICommPtr comm);
+    Mesh(const std::string& meshname, mpi::MPICommPtr comm,
+         bool use_snapshot=false, node_ordering ordering=ordering_rcm);
+    // use_snapshot: restore the mesh from a snapshot (meshname_<n>_<i>.msnap)
+    //               saved by an earlier run on the same input files, and
+    //               save one if there is none.  Setting FVM_MESH_SNAPSHOT
+    //               in the environment turns snapshots on for every mesh.
+    // ordering:     how the local nodes are numbered, the edges and CV faces
+    //               are numbered to follow the nodes.  The ordering is applied
+    //               separately to the halo-independent nodes, which come
+    //               first, and the halo-dependent nodes.
+    Mesh(const BoxMesh& box, mpi::MPICommPtr comm,
+         node_ordering ordering=ordering_rcm);
+    // generates this domain's part of a box mesh, see box_mesh.h
+    Mesh(const std::string& meshname, const std::vector<double>& weights,
+         mpi::MPICommPtr comm, node_ordering ordering=ordering_rcm);
+    // partitions the global mesh file meshname.msh (or meshname.mesh) so
+    // that the domains have equal total weight, to rebalance a run whose
+    // work has moved between the domains (see global_node_weights and
+    // import_node_values).  No snapshot is used.
+    // weights: one weight for each node of the global mesh, in file order
+    Mesh(ThreadPartition& partition, int domain,
+         node_ordering ordering=ordering_rcm);
+    // makes domain domain of a partition of a global mesh in memory, for a
+    // run whose domains are the threads of one process (see
+    // thread_partition.h).  No MPI is used: mpicomm() is null, and the node
+    // pattern is for an mpi::ThreadCommunicator.  The collective members,
+    // such as global_node_weights and total_vol, need MPI.
 private:
     Mesh(const Mesh&);
     Mesh& operator=(const Mesh&);
 public:
-    // the MPI communicator
+    // the MPI communicator, null for a domain of a ThreadPartition
     mpi::MPICommPtr mpicomm() const;
 
     int domains() const;
@@ -82,12 +117,59 @@ public:
     int scvs() const;
     // number of sub control volumes for this domain
 
+    int halo_independent_nodes() const;
+    // number of local nodes whose control volumes only involve local nodes
+    // notes: i in [0, halo_independent_nodes()) needs no external node values
+    //        i in [halo_independent_nodes(), local_nodes()) is halo-dependent
+
+    int halo_independent_edges() const;
+    // number of edges whose elements only involve local nodes
+    // notes: edges [0, halo_independent_edges()) need no external node values
+
+    int halo_independent_cvfaces() const;
+    // number of interior CV faces whose element only involves local nodes
+    // notes: CV faces [0, halo_independent_cvfaces()) need no external node
+    //        values, and include every CV face of the halo-independent nodes
+
     int global_node_id(int i) const;
     // global id of ith node
 
     int external_node_id(int i) const;
     // global id of ith external node
 
+    int node_source_id(int i) const;
+    // index of the ith local node in the global mesh (.mesh or .msh) file,
+    // which does not depend on the number of domains or the node ordering
+    // pre: i in [0, local_nodes())
+    // notes: for box meshes this is the lexicographic index of the lattice
+    //        node.  For .pmesh files it is only known if split's
+    //        meshname_p_<n>.txt file is kept, otherwise it is the global
+    //        id in the .pmesh files.
+
+    void global_node_weights(const std::vector<double>& weights,
+                             std::vector<double>& global) const;
+    // gathers the weights of the local nodes of every domain into one weight
+    // for each node of the global mesh, in file order (see node_source_id)
+    // notes: collective, every domain gets the global weights
+
+    void import_node_values(const Mesh& from, const std::vector<double>& values,
+                            int per_node, std::vector<double>& out) const;
+    // moves node values from the domains of another partition of the same
+    // global mesh to the domains of this one, matching the nodes by
+    // node_source_id.  values holds per_node values for each local node of
+    // from, and out is given per_node values for each local node of this mesh.
+    // notes: collective, both meshes must be partitioned over the same
+    //        processes
+
+    void save_node_weights(const std::string& filename,
+                           const std::vector<double>& weights) const;
+    // writes one weight for each node of the global mesh, in the order of
+    // the global mesh file, from the weights of the local nodes of every
+    // domain.  When a mesh is partitioned as it is loaded, the weights in
+    // meshname.weights are balanced between the domains, so a file written
+    // here from measured costs balances the work of the next run.
+    // notes: collective, the file is written by domain 0
+
     const Node& node(int i) const;
     // ith domain node
     // pre: i in [0, nodes())
@@ -145,11 +227,55 @@ public:
     int dim() const; 
     // dimsension of the mesh (=2 triangles etc) (=3 tets etc)
 
-    // number of distinct physical properties
-    const std::vector<int>& edge_cvface(int i) const;
+    node_ordering ordering() const;
+    // the ordering applied to the local nodes
+
+    IndexRange edge_cvface(int i) const;
+    // ids of the interior CV faces that bisect the ith edge
+    // pre: i in [0, edges())
+
+    int cvface_colours() const;
+    // number of colours of the CV faces
+    IndexRange cvface_colour(int c) const;
+    // ids of the CV faces of colour c, in ascending order.  No two CV faces
+    // of a colour have a front or back node in common, so a loop over one
+    // colour can scatter to the nodes of its CV faces from many threads
+    // without atomics.
+    // pre: c in [0, cvface_colours())
+
+    int edge_colours() const;
+    IndexRange edge_colour(int c) const;
+    // the same for the edges and their front and back nodes
+    // pre: c in [0, edge_colours())
+
+    // Geometry tables: the same information as the CVFace and Volume
+    // accessors, held as contiguous arrays indexed by CV face (or node) id,
+    // so that kernels can stream over them directly.
+    const std::vector<double>& cvface_area() const;
+    const std::vector<double>& cvface_normal_x() const;
+    const std::vector<double>& cvface_normal_y() const;
+    const std::vector<double>& cvface_normal_z() const;
+    // components of CVFace::normal(), i.e. scaled by the area
+    const std::vector<double>& cvface_centroid_x() const;
+    const std::vector<double>& cvface_centroid_y() const;
+    const std::vector<double>& cvface_centroid_z() const;
+    const std::vector<int>& cvface_front_id() const;
+    // front node ids, -1 for boundary CV faces
+    const std::vector<int>& cvface_back_id() const;
+    const std::vector<int>& cvface_element_id() const;
+    const std::vector<int>& cvface_boundary() const;
+    // boundary tags, 0 for interior CV faces
+    const std::vector<double>& volume_vol() const;
+    // control volume sizes, for each node
 
     const Pattern& node_pattern() const;
 private:
+    // the entities are views onto the connectivity held by the mesh
+    friend class Element;
+    friend class Face;
+    friend class SCV;
+    friend class Volume;
+
     mpi::MPICommPtr mpicomm_;
 
     int mesh_dim_;
@@ -163,8 +289,12 @@ private:
     int n_faces_int, n_faces_bnd;
     int n_cvfaces_int, n_cvfaces_bnd;
     int n_physical_props;
+    int n_nodes_indep_, n_edges_indep_, n_cvfaces_indep_; // halo-independent blocks
+    node_ordering ordering_;
     std::vector<int> vtx_dist;
     std::vector<int> nodes_ext;
+    std::vector<int> node_file_index_; // mesh file index of each local node
+    std::vector<int> node_source_id_;  // global mesh file index of each local node
     std::vector<Node> nodevec;
     std::vector<Edge> edgevec;
     std::vector<Face> facevec;
@@ -174,9 +304,31 @@ private:
     std::vector<Volume> volumevec;
     std::set<int> boundary_tags;
     std::vector< std::vector<double> > properties;
-    std::vector< std::vector<int> > edge_cvfaces;
     Pattern node_pattern_;
 
+    // connectivity, in compressed sparse row format
+    Connectivity element_nodes_;      // also gives the SCVs of each element
+    Connectivity element_edges_;
+    Connectivity element_faces_;
+    Connectivity element_cvfaces_;
+    Connectivity element_neighbours_;
+    Connectivity face_nodes_;
+    Connectivity face_edges_;
+    Connectivity scv_cvfaces_;
+    Connectivity volume_scvs_;
+    Connectivity edge_cvfaces_;
+    Connectivity cvface_colours_;     // CV faces of each colour
+    Connectivity edge_colours_;       // edges of each colour
+    std::vector<Point> scv_vertices_; // scv_vertex_count() for each SCV
+
+    // geometry tables
+    std::vector<double> cvface_area_;
+    std::vector<double> cvface_normal_x_, cvface_normal_y_, cvface_normal_z_;
+    std::vector<double> cvface_centroid_x_, cvface_centroid_y_, cvface_centroid_z_;
+    std::vector<int> cvface_front_id_, cvface_back_id_;
+    std::vector<int> cvface_element_id_, cvface_boundary_;
+    std::vector<double> volume_vol_;
+
     void open_mesh_file(const std::string&, std::ifstream&, std::ifstream&);
     void read_mesh_data(std::ifstream&, std::ifstream&);
     void read_header_data(std::ifstream&, int&, int&, int&);
@@ -184,27 +336,63 @@ private:
     void read_external_nodes(std::ifstream&, int);
     void read_nodes(std::ifstream&, int);
     void read_elements(std::ifstream&, int,
-        std::set<Edge>&, std::set<Face>&);
+        EntityTable&, EntityTable&);
+    void read_binary_mesh_data(const std::string&);
+    void build_domain_mesh(const BinaryMeshHeader&, const double*, const int*,
+        const int*, const int*, const int*, const int*, const int*,
+        const std::string&);
+    void read_global_mesh_data(const std::string&, const std::string&,
+        const std::vector<double>&);
+    void partition_nodes(const GlobalMesh*, const std::vector<double>&,
+        std::vector<int>&);
+    void read_node_source_ids(const std::string&);
+    void distribute_mesh_data(const GlobalMesh*, const std::vector<int>&);
+    void make_thread_domain(const ThreadPartition&, int);
+    void generate_box_mesh(const BoxMesh&);
+    bool snapshot_is_current(const std::string&,
+        const std::vector<std::string>&) const;
+    void write_snapshot(const std::string&,
+        const std::vector<std::string>&) const;
+    void read_snapshot(const std::string&);
+    void process_mesh_data();
+    void element_shape(int, int&, int&);
+    void add_element(int, int, int,
+        const std::vector<int>&, const std::vector<int>&,
+        EntityTable&, EntityTable&);
     void construct_edges_and_faces(int,
         const std::vector<int>&, const std::vector<int>&,
         std::vector<int>&, std::vector<int>&,
-        std::set<Edge>&, std::set<Face>&);
+        EntityTable&, EntityTable&);
     void set_element_neighbours();
-    void populate_edges_and_faces(const std::set<Edge>&, const std::set<Face>&);
     void face_edge_sanity_check();
     void element_cvface_sanity_check();
     void boundary_tag_sanity_check();
     void construct_control_volumes();
     void initialise_volumes_and_faces();
-    void construct_scv_faces_internal_3D();
-    void construct_scv_faces_boundary_3D();
-    void construct_scv_faces_internal_2D();
-    void construct_scv_faces_boundary_2D();
+    void construct_scv_faces_internal_3D(std::vector<int>&);
+    void construct_scv_faces_boundary_3D(std::vector<int>&);
+    void construct_scv_faces_internal_2D(std::vector<int>&);
+    void construct_scv_faces_boundary_2D(std::vector<int>&);
+    void interior_cvface_offsets(std::vector<int>&);
+    void boundary_cvface_offsets(std::vector<int>&);
+    void link_cvfaces(const std::vector<int>&, const std::vector<int>&);
+    int scv_vertex_count() const;
+    void set_scv_vertices(int, Point, Point, Point, Point);
+    void set_scv_vertices(int, Point, Point, Point, Point,
+        Point, Point, Point, Point);
     void construct_volumes();
+    void construct_geometry_tables();
+    void construct_colourings();
     void construct_node_pattern();
-    int insert_edge(std::set<Edge>&, const Edge&);
-    int insert_face(std::set<Face>&, const Face&);
-    void reorder_nodes_edges(std::set<Edge> &edgeset, std::set<Face> &faceset);
+    void construct_thread_node_pattern(ThreadPartition&);
+    int insert_edge(EntityTable&, int, int);
+    int insert_face(EntityTable&, int, int, const int*, const int*);
+    int insert_line_face(EntityTable&, int, int, int, int);
+    int insert_triangular_face(EntityTable&, int,
+        int, int, int, int, int, int);
+    int insert_rectangular_face(EntityTable&, int,
+        int, int, int, int, int, int, int, int);
+    void reorder_nodes_edges();
 };
 
 } // end namespace mesh
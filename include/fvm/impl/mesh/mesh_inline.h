@@ -23,6 +23,11 @@ int Mesh::dim() const {
     return mesh_dim_;
 }
 
+inline
+node_ordering Mesh::ordering() const {
+    return ordering_;
+}
+
 inline 
 int Mesh::domain_id() const {
     return dom_id;
@@ -118,6 +123,21 @@ int Mesh::scvs() const {
     return scvvec.size();
 }
 
+inline
+int Mesh::halo_independent_nodes() const {
+    return n_nodes_indep_;
+}
+
+inline
+int Mesh::halo_independent_edges() const {
+    return n_edges_indep_;
+}
+
+inline
+int Mesh::halo_independent_cvfaces() const {
+    return n_cvfaces_indep_;
+}
+
 inline
 int Mesh::external_node_id(int i) const {
     #ifdef MESH_DEBUG
@@ -140,6 +160,15 @@ int Mesh::global_node_id(int i) const {
     }
 }
 
+inline
+int Mesh::node_source_id(int i) const {
+    #ifdef MESH_DEBUG
+    if (i < 0 || i >= local_nodes())
+        throw OutOfRangeException("Mesh::node_source_id(int): out of range");
+    #endif
+    return node_source_id_[i];
+}
+
 inline
 const Node& Mesh::node(int i) const {
     #ifdef MESH_DEBUG
@@ -220,11 +249,105 @@ const std::vector<double>& Mesh::property(int i) const {
 }
 
 inline
-const std::vector<int>& Mesh::edge_cvface(int i) const{
+IndexRange Mesh::edge_cvface(int i) const{
     #ifdef MESH_DEBUG
-    assert(i<edge_cvfaces.size());
+    if (i < 0 || i >= edges())
+        throw OutOfRangeException("Mesh::edge_cvface(int): out of range");
     #endif
-    return edge_cvfaces[i];
+    return edge_cvfaces_.row(i);
+}
+
+inline
+int Mesh::cvface_colours() const {
+    return cvface_colours_.rows();
+}
+
+inline
+IndexRange Mesh::cvface_colour(int c) const {
+    #ifdef MESH_DEBUG
+    if (c < 0 || c >= cvface_colours())
+        throw OutOfRangeException("Mesh::cvface_colour(int): out of range");
+    #endif
+    return cvface_colours_.row(c);
+}
+
+inline
+int Mesh::edge_colours() const {
+    return edge_colours_.rows();
+}
+
+inline
+IndexRange Mesh::edge_colour(int c) const {
+    #ifdef MESH_DEBUG
+    if (c < 0 || c >= edge_colours())
+        throw OutOfRangeException("Mesh::edge_colour(int): out of range");
+    #endif
+    return edge_colours_.row(c);
+}
+
+inline
+const std::vector<double>& Mesh::cvface_area() const {
+    return cvface_area_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_normal_x() const {
+    return cvface_normal_x_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_normal_y() const {
+    return cvface_normal_y_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_normal_z() const {
+    return cvface_normal_z_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_centroid_x() const {
+    return cvface_centroid_x_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_centroid_y() const {
+    return cvface_centroid_y_;
+}
+
+inline
+const std::vector<double>& Mesh::cvface_centroid_z() const {
+    return cvface_centroid_z_;
+}
+
+inline
+const std::vector<int>& Mesh::cvface_front_id() const {
+    return cvface_front_id_;
+}
+
+inline
+const std::vector<int>& Mesh::cvface_back_id() const {
+    return cvface_back_id_;
+}
+
+inline
+const std::vector<int>& Mesh::cvface_element_id() const {
+    return cvface_element_id_;
+}
+
+inline
+const std::vector<int>& Mesh::cvface_boundary() const {
+    return cvface_boundary_;
+}
+
+inline
+const std::vector<double>& Mesh::volume_vol() const {
+    return volume_vol_;
+}
+
+inline
+int Mesh::scv_vertex_count() const {
+    return dim() == 3 ? 8 : 4;
 }
 
 } // end namespace mesh
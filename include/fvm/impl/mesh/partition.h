@@ -0,0 +1,484 @@
+#ifndef MESH_PARTITION_H
+#define MESH_PARTITION_H
+
+#include "exception.h"
+#include "forward.h"
+#include "connectivity.h"
+#include "global_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mesh {
+
+// Geometric partitioning of the nodes of a global mesh, which needs no
+// external library.  Recursive coordinate bisection (RCB) cuts the nodes in
+// two across the longest side of their bounding box, then cuts each half in
+// the same way, until there is one piece for each domain.  Recursive inertial
+// bisection cuts across the principal axis of inertia of the nodes instead,
+// which follows meshes that are not aligned with the coordinate axes.  Each
+// cut balances the node weights (or counts) of the two pieces in proportion
+// to the number of domains that each will be divided into, so any number of
+// domains can be used.
+//
+// The partition is a vector part, where part[i] is the domain that owns
+// node i, in the form that decomp passes to split in its .perm files.
+
+void rcb_partition(const std::vector<Point>& points, int dim,
+                   const std::vector<double>& weights, int parts,
+                   bool inertial, std::vector<int>& part);
+// points: node coordinates
+// weights: weight of each node, or empty for unit weights
+// inertial: cut across the principal axis instead of the longest side
+
+void node_graph(const GlobalMesh& mesh, Connectivity& graph);
+// the nodes joined to each node by an element (the sparsity pattern of the
+// Jacobian without the diagonal), in ascending order
+
+// measures of how good a partition is for the solver
+struct PartitionQuality {
+    long long edge_cut; // node graph edges between nodes in different domains
+    long long halo;     // external nodes, summed over the domains
+    int max_halo;       // external nodes of the domain with the most
+    double imbalance;   // heaviest domain weight over the mean domain weight
+};
+
+PartitionQuality partition_quality(const Connectivity& graph,
+                                   const std::vector<int>& part, int parts,
+                                   const std::vector<double>& weights);
+// weights: as for rcb_partition
+
+// the nodes of one domain of a partition and its halo, numbered as split
+// numbers the nodes of a .pmesh file: the nodes the domain owns first, then
+// its external nodes grouped by the domain that owns them
+struct DomainHalo {
+    std::vector<int> nodes;      // global id of each node of the domain
+    int local_nodes;             // number of nodes the domain owns
+    std::vector<int> neighbours; // domains that share a halo, ascending
+    std::vector<std::vector<int> > send; // local nodes each neighbour needs
+    std::vector<std::vector<int> > recv; // external nodes each neighbour owns
+};
+
+void domain_halos(const Connectivity& graph, const std::vector<int>& part,
+                  int parts, std::vector<DomainHalo>& domains);
+// graph: as made by node_graph
+// send and recv are in the same order on both sides of each halo (by global
+// id), so that send[i] of domain d fills recv[j] of its neighbour i, where
+// d is the jth neighbour of i, as in a mesh::Pattern
+
+void domain_numbering(const std::vector<int>& part, int parts,
+                      std::vector<int>& vtxdist, std::vector<int>& global_id);
+// numbers the nodes of each domain contiguously, in file order, as split
+// numbers the nodes of the .pmesh files: the nodes of domain d have the
+// global ids [vtxdist[d], vtxdist[d+1]), and node i has global id global_id[i]
+
+void domain_entities(const GlobalMesh& mesh, const std::vector<int>& part,
+                     int parts, Connectivity& nodes, Connectivity& elements);
+// the nodes owned by each domain, and the elements with a node owned by each
+// domain, in file order
+
+void write_partition(const std::string& filename, const std::vector<int>& part,
+                     int parts);
+void read_partition(const std::string& filename, std::vector<int>& part,
+                    int& parts);
+// partition files have the binary format of the meshname_<n>.perm files
+// written by decomp and read by split:
+//   int n_dom, int vtxdist[n_dom+1], int part[n_nodes]
+// where vtxdist is the block distribution of the nodes that decomp gave
+// ParMETIS, which split ignores
+
+void write_node_weights(const std::string& filename,
+                        const std::vector<double>& weights);
+void read_node_weights(const std::string& filename, int n,
+                       std::vector<double>& weights);
+// weights files are text, with one weight for each node of the global mesh
+// in node order, e.g. the measured cost of each node saved by
+// Mesh::save_node_weights()
+
+/*******************************************
+ * implementation
+ *******************************************/
+
+// weight of node i
+inline
+double partition_weight(const std::vector<double>& weights, int i) {
+    return weights.empty() ? 1.0 : weights[i];
+}
+
+// coordinate d of p
+inline
+double partition_coordinate(const Point& p, int d) {
+    return d == 0 ? p.x : (d == 1 ? p.y : p.z);
+}
+
+// direction to cut the nodes ids[first, last) across
+inline
+Point bisection_direction(const std::vector<Point>& points, int dim,
+                          const std::vector<double>& weights, bool inertial,
+                          const std::vector<int>& ids, int first, int last) {
+    // the longest side of the bounding box
+    double lo[3], hi[3];
+    for (int d = 0; d < 3; ++d) {
+        lo[d] = partition_coordinate(points[ids[first]], d);
+        hi[d] = lo[d];
+    }
+    for (int k = first; k < last; ++k) {
+        for (int d = 0; d < dim; ++d) {
+            lo[d] = std::min(lo[d], partition_coordinate(points[ids[k]], d));
+            hi[d] = std::max(hi[d], partition_coordinate(points[ids[k]], d));
+        }
+    }
+    int axis = 0;
+    for (int d = 1; d < dim; ++d)
+        if (hi[d] - lo[d] > hi[axis] - lo[axis])
+            axis = d;
+    double dir[3] = {0., 0., 0.};
+    dir[axis] = 1.;
+    if (!inertial)
+        return Point(dir[0], dir[1], dir[2]);
+
+    // the principal axis of the weighted inertia tensor, found by power
+    // iteration on the covariance of the node coordinates, starting from
+    // the longest side
+    double total = 0., centre[3] = {0., 0., 0.};
+    for (int k = first; k < last; ++k) {
+        double w = partition_weight(weights, ids[k]);
+        total += w;
+        for (int d = 0; d < dim; ++d)
+            centre[d] += w * partition_coordinate(points[ids[k]], d);
+    }
+    if (total <= 0.)
+        return Point(dir[0], dir[1], dir[2]);
+    for (int d = 0; d < dim; ++d)
+        centre[d] /= total;
+    double cov[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+    for (int k = first; k < last; ++k) {
+        double w = partition_weight(weights, ids[k]);
+        double x[3] = {0., 0., 0.};
+        for (int d = 0; d < dim; ++d)
+            x[d] = partition_coordinate(points[ids[k]], d) - centre[d];
+        for (int a = 0; a < dim; ++a)
+            for (int b = 0; b < dim; ++b)
+                cov[a][b] += w * x[a] * x[b];
+    }
+    for (int it = 0; it < 100; ++it) {
+        double next[3] = {0., 0., 0.};
+        for (int a = 0; a < dim; ++a)
+            for (int b = 0; b < dim; ++b)
+                next[a] += cov[a][b] * dir[b];
+        double norm = std::sqrt(next[0]*next[0] + next[1]*next[1] + next[2]*next[2]);
+        if (norm == 0.)
+            break;
+        double change = 0.;
+        for (int d = 0; d < 3; ++d) {
+            change += std::fabs(next[d] / norm - dir[d]);
+            dir[d] = next[d] / norm;
+        }
+        if (change < 1e-10)
+            break;
+    }
+    return Point(dir[0], dir[1], dir[2]);
+}
+
+// divide the nodes ids[first, last) among the domains [part0, part0+parts)
+inline
+void bisect_nodes(const std::vector<Point>& points, int dim,
+                  const std::vector<double>& weights, bool inertial,
+                  std::vector<int>& ids, int first, int last,
+                  int part0, int parts, std::vector<int>& part) {
+    if (parts == 1 || last - first <= 1) {
+        for (int k = first; k < last; ++k)
+            part[ids[k]] = part0;
+        return;
+    }
+
+    // order the nodes along the cut direction, ties broken by node id
+    Point dir = bisection_direction(points, dim, weights, inertial, ids, first, last);
+    int n = last - first;
+    std::vector<std::pair<double, int> > keys(n);
+    double total = 0.;
+    for (int k = 0; k < n; ++k) {
+        int i = ids[first+k];
+        keys[k] = std::make_pair(dot(dir, points[i]), i);
+        total += partition_weight(weights, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // the first left parts of the domains take their share of the weight
+    int left = parts / 2;
+    double target = total * left / parts;
+    double sum = 0.;
+    int cut = 0;
+    while (cut < n) {
+        double w = partition_weight(weights, keys[cut].second);
+        if (sum + w > target && target - sum < sum + w - target)
+            break;
+        sum += w;
+        ++cut;
+    }
+    // every domain gets at least one node if there are enough
+    if (n >= parts)
+        cut = std::max(left, std::min(cut, n - (parts - left)));
+
+    for (int k = 0; k < n; ++k)
+        ids[first+k] = keys[k].second;
+    bisect_nodes(points, dim, weights, inertial, ids, first, first + cut,
+                 part0, left, part);
+    bisect_nodes(points, dim, weights, inertial, ids, first + cut, last,
+                 part0 + left, parts - left, part);
+}
+
+inline
+void rcb_partition(const std::vector<Point>& points, int dim,
+                   const std::vector<double>& weights, int parts,
+                   bool inertial, std::vector<int>& part) {
+    int n = points.size();
+    if (!weights.empty() && int(weights.size()) != n)
+        throw IOException("rcb_partition: there must be one weight for each node");
+    part.assign(n, 0);
+    if (n == 0)
+        return;
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; ++i)
+        ids[i] = i;
+    bisect_nodes(points, dim, weights, inertial, ids, 0, n, 0, parts, part);
+}
+
+inline
+void node_graph(const GlobalMesh& mesh, Connectivity& graph) {
+    std::vector<std::pair<int, int> > adjacent;
+    for (int e = 0; e < mesh.elements(); ++e) {
+        IndexRange nodes = mesh.element_nodes(e);
+        for (int j = 0; j < nodes.size(); ++j)
+            for (int k = 0; k < nodes.size(); ++k)
+                if (k != j)
+                    adjacent.push_back(std::make_pair(nodes[j], nodes[k]));
+    }
+    std::sort(adjacent.begin(), adjacent.end());
+    adjacent.erase(std::unique(adjacent.begin(), adjacent.end()), adjacent.end());
+
+    std::vector<int> row(adjacent.size()), id(adjacent.size());
+    for (int k = 0; k < int(adjacent.size()); ++k) {
+        row[k] = adjacent[k].first;
+        id[k] = adjacent[k].second;
+    }
+    graph.assign(mesh.nodes(), row, id);
+}
+
+inline
+PartitionQuality partition_quality(const Connectivity& graph,
+                                   const std::vector<int>& part, int parts,
+                                   const std::vector<double>& weights) {
+    PartitionQuality q;
+    q.edge_cut = 0;
+    q.halo = 0;
+    std::vector<int> halo(parts, 0);
+    std::vector<double> load(parts, 0.);
+    std::vector<int> seen; // domains that node i is external to
+    for (int i = 0; i < graph.rows(); ++i) {
+        load[part[i]] += partition_weight(weights, i);
+        seen.clear();
+        for (int j = 0; j < graph.size(i); ++j) {
+            int d = part[graph(i, j)];
+            if (d == part[i])
+                continue;
+            if (graph(i, j) > i)
+                ++q.edge_cut;
+            if (std::find(seen.begin(), seen.end(), d) == seen.end()) {
+                seen.push_back(d);
+                ++halo[d];
+            }
+        }
+        q.halo += seen.size();
+    }
+    q.max_halo = *std::max_element(halo.begin(), halo.end());
+    double total = 0.;
+    for (int d = 0; d < parts; ++d)
+        total += load[d];
+    q.imbalance = total > 0. ? *std::max_element(load.begin(), load.end()) * parts / total : 1.;
+    return q;
+}
+
+inline
+void domain_halos(const Connectivity& graph, const std::vector<int>& part,
+                  int parts, std::vector<DomainHalo>& domains) {
+    // each node is owned by one domain, whose local numbering is in order
+    // of global id
+    std::vector<int> local_id(graph.rows());
+    domains.assign(parts, DomainHalo());
+    for (int i = 0; i < graph.rows(); ++i) {
+        DomainHalo& d = domains[part[i]];
+        local_id[i] = d.nodes.size();
+        d.nodes.push_back(i);
+    }
+
+    std::vector<std::pair<int, int> > external; // (owner, global id)
+    for (int p = 0; p < parts; ++p) {
+        DomainHalo& d = domains[p];
+        d.local_nodes = d.nodes.size();
+        external.clear();
+        for (int k = 0; k < d.local_nodes; ++k) {
+            int i = d.nodes[k];
+            for (int j = 0; j < graph.size(i); ++j)
+                if (part[graph(i, j)] != p)
+                    external.push_back(std::make_pair(part[graph(i, j)], graph(i, j)));
+        }
+        std::sort(external.begin(), external.end());
+        external.erase(std::unique(external.begin(), external.end()), external.end());
+
+        for (int k = 0; k < int(external.size()); ++k) {
+            int owner = external[k].first;
+            if (d.neighbours.empty() || d.neighbours.back() != owner) {
+                d.neighbours.push_back(owner);
+                d.recv.push_back(std::vector<int>());
+            }
+            d.recv.back().push_back(d.nodes.size());
+            d.nodes.push_back(external[k].second);
+        }
+    }
+
+    // the owner sends the nodes in the order that the neighbour receives them
+    for (int p = 0; p < parts; ++p) {
+        DomainHalo& d = domains[p];
+        d.send.resize(d.neighbours.size());
+        for (int i = 0; i < int(d.neighbours.size()); ++i) {
+            DomainHalo& n = domains[d.neighbours[i]];
+            int j = std::lower_bound(n.neighbours.begin(), n.neighbours.end(), p)
+                  - n.neighbours.begin();
+            n.send.resize(n.neighbours.size());
+            const std::vector<int>& recv = d.recv[i];
+            for (int k = 0; k < int(recv.size()); ++k)
+                n.send[j].push_back(local_id[d.nodes[recv[k]]]);
+        }
+    }
+}
+
+inline
+void domain_numbering(const std::vector<int>& part, int parts,
+                      std::vector<int>& vtxdist, std::vector<int>& global_id) {
+    int n = part.size();
+    vtxdist.assign(parts+1, 0);
+    for (int i = 0; i < n; ++i)
+        ++vtxdist[part[i]+1];
+    for (int d = 0; d < parts; ++d)
+        vtxdist[d+1] += vtxdist[d];
+    global_id.resize(n);
+    std::vector<int> next(vtxdist.begin(), vtxdist.end()-1);
+    for (int i = 0; i < n; ++i)
+        global_id[i] = next[part[i]]++;
+}
+
+inline
+void domain_entities(const GlobalMesh& mesh, const std::vector<int>& part,
+                     int parts, Connectivity& nodes, Connectivity& elements) {
+    std::vector<int> node_ids(mesh.nodes());
+    for (int i = 0; i < mesh.nodes(); ++i)
+        node_ids[i] = i;
+    nodes.assign(parts, part, node_ids);
+
+    std::vector<int> row, id, owners;
+    row.reserve(mesh.elements());
+    id.reserve(mesh.elements());
+    for (int e = 0; e < mesh.elements(); ++e) {
+        IndexRange element_nodes = mesh.element_nodes(e);
+        owners.clear();
+        for (int j = 0; j < element_nodes.size(); ++j)
+            owners.push_back(part[element_nodes[j]]);
+        std::sort(owners.begin(), owners.end());
+        owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+        for (int k = 0; k < int(owners.size()); ++k) {
+            row.push_back(owners[k]);
+            id.push_back(e);
+        }
+    }
+    elements.assign(parts, row, id);
+}
+
+inline
+void write_partition(const std::string& filename, const std::vector<int>& part,
+                     int parts) {
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out)
+        throw IOException("Couldn't open file: " + filename);
+    int n = part.size();
+    std::vector<int> vtxdist(parts+1);
+    for (int d = 0; d <= parts; ++d)
+        vtxdist[d] = int((long long)d * n / parts);
+    out.write(reinterpret_cast<const char*>(&parts), sizeof(int));
+    out.write(reinterpret_cast<const char*>(&vtxdist[0]), sizeof(int) * (parts+1));
+    if (n)
+        out.write(reinterpret_cast<const char*>(&part[0]), sizeof(int) * n);
+    if (!out)
+        throw IOException("Couldn't write file: " + filename);
+}
+
+inline
+void read_partition(const std::string& filename, std::vector<int>& part,
+                    int& parts) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in)
+        throw IOException("Couldn't open file: " + filename);
+    in.read(reinterpret_cast<char*>(&parts), sizeof(int));
+    if (!in || parts < 1)
+        throw IOException("Couldn't read number of domains in file: " + filename);
+    std::vector<int> vtxdist(parts+1);
+    in.read(reinterpret_cast<char*>(&vtxdist[0]), sizeof(int) * (parts+1));
+    if (!in)
+        throw IOException("Couldn't read vtxdist in file: " + filename);
+    // part has already been sized to the number of nodes in the mesh
+    if (!part.empty())
+        in.read(reinterpret_cast<char*>(&part[0]), sizeof(int) * part.size());
+    if (!in)
+        throw IOException("Couldn't read node domains in file: " + filename);
+    for (int i = 0; i < int(part.size()); ++i) {
+        if (part[i] < 0 || part[i] >= parts) {
+            std::ostringstream oss;
+            oss << "Invalid domain " << part[i] << " for node " << i
+                << " in file: " << filename;
+            throw IOException(oss.str());
+        }
+    }
+}
+
+inline
+void write_node_weights(const std::string& filename,
+                        const std::vector<double>& weights) {
+    std::ofstream out(filename.c_str());
+    if (!out)
+        throw IOException("Couldn't open file: " + filename);
+    out.precision(8);
+    for (int i = 0; i < int(weights.size()); ++i)
+        out << weights[i] << "\n";
+    if (!out)
+        throw IOException("Couldn't write file: " + filename);
+}
+
+inline
+void read_node_weights(const std::string& filename, int n,
+                       std::vector<double>& weights) {
+    std::ifstream in(filename.c_str());
+    if (!in)
+        throw IOException("Couldn't open file: " + filename);
+    weights.resize(n);
+    for (int i = 0; i < n; ++i)
+        in >> weights[i];
+    if (!in)
+        throw IOException("Couldn't read a weight for each node from file: " + filename);
+    for (int i = 0; i < n; ++i) {
+        if (!(weights[i] >= 0.)) {
+            std::ostringstream oss;
+            oss << "Invalid weight " << weights[i] << " for node " << i
+                << " in file: " << filename;
+            throw IOException(oss.str());
+        }
+    }
+}
+
+} // end namespace mesh
+
+#endif
@@ -29,17 +29,10 @@ private:
     int node_id;
     int boundary_faces;
     double my_vol;
-    std::vector<int> cvfacevec;
-    std::vector<Point> vertexvec;
     Point c;
 
     friend class Mesh;
-    void add_cvface(int id);
-    void add_boundary_cvface(int id);
     void add_volume(double vol);
-    void set_vertices2D(Point p1, Point p2, Point p3, Point p4);
-    void set_vertices3D(Point p1, Point p2, Point p3, Point p4,
-                      Point p5, Point p6, Point p7, Point p8);
     void set_centroid(Point c);
 };
 
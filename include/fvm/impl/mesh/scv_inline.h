@@ -25,7 +25,7 @@ const Node& SCV::node() const {
 
 inline
 int SCV::cvfaces() const {
-    return cvfacevec.size();
+    return m->scv_cvfaces_.size(my_id);
 }
 
 inline
@@ -35,7 +35,7 @@ int SCV::boundary_cvfaces() const {
 
 inline
 int SCV::vertices() const {
-    return vertexvec.size();
+    return m->scv_vertex_count();
 }
 
 inline
@@ -44,7 +44,7 @@ const CVFace& SCV::cvface(int i) const {
     if (i < 0 || i >= cvfaces())
         throw OutOfRangeException("SCV::cvface(int): out of range");
     #endif
-    return mesh().cvface(cvfacevec[i]);
+    return mesh().cvface(m->scv_cvfaces_(my_id, i));
 }
 
 inline
@@ -54,7 +54,7 @@ Point SCV::vertex(int i) const {
         throw OutOfRangeException("SCV::vertex(int): out of range");
 }
     #endif
-    return vertexvec[i];
+    return m->scv_vertices_[my_id*vertices() + i];
 }
 
 inline
@@ -67,46 +67,11 @@ Point SCV::centroid() const {
     return c;
 }
 
-inline
-void SCV::add_cvface(int id) {
-    cvfacevec.push_back(id);
-}
-
-inline
-void SCV::add_boundary_cvface(int id) {
-    cvfacevec.push_back(id);
-    ++boundary_faces;
-}
-
 inline
 void SCV::add_volume(double vol) {
     my_vol += vol;
 }
 
-inline
-void SCV::set_vertices2D(Point p1, Point p2, Point p3, Point p4) {
-    if (vertexvec.empty()) {
-        vertexvec.push_back(p1);
-        vertexvec.push_back(p2);
-        vertexvec.push_back(p3);
-        vertexvec.push_back(p4);
-    }
-}
-
-inline
-void SCV::set_vertices3D(Point p1, Point p2, Point p3, Point p4, Point p5, Point p6, Point p7, Point p8) {
-    if (vertexvec.empty()) {
-        vertexvec.push_back(p1);
-        vertexvec.push_back(p2);
-        vertexvec.push_back(p3);
-        vertexvec.push_back(p4);
-        vertexvec.push_back(p5);
-        vertexvec.push_back(p6);
-        vertexvec.push_back(p7);
-        vertexvec.push_back(p8);
-    }
-}
-
 inline
 void SCV::set_centroid(Point centroid) {
     c = centroid;
@@ -0,0 +1,181 @@
+#ifndef MESH_THREAD_PARTITION_H
+#define MESH_THREAD_PARTITION_H
+
+#include "exception.h"
+#include "forward.h"
+#include "connectivity.h"
+#include "global_mesh.h"
+#include "partition.h"
+
+#include <cassert>
+#include <vector>
+
+#include <sched.h>
+
+namespace mesh {
+
+// A partition of a global mesh held in memory, whose domains are made by the
+// threads of one process, one thread per domain, e.g. each thread of an
+// OpenMP parallel region:
+//
+//   mesh::ThreadPartition partition(global, part, domains);
+//   #pragma omp parallel num_threads(domains)
+//   {
+//       mesh::Mesh m(partition, omp_get_thread_num());
+//       ...
+//   }
+//
+// It plays the part of the root domain of Mesh::distribute_mesh_data: each
+// domain is numbered as the root domain would number it for the processes of
+// an MPI run, and the node pattern of each domain is its halo from
+// domain_halos(), so no MPI is needed.  Once a domain has ordered its nodes it
+// gives their global ids to the partition, from which its neighbours take the
+// global ids of their external nodes, so every domain must be made at the
+// same time by its own thread.  The global mesh and the partition must
+// outlive the constructors of the domains.
+class ThreadPartition {
+public:
+    ThreadPartition(const GlobalMesh& mesh, const std::vector<int>& part,
+                    int domains);
+    // part: the domain that owns each node of mesh, e.g. from rcb_partition
+
+    const GlobalMesh& mesh() const;
+    const std::vector<int>& part() const;
+    int domains() const;
+
+    const std::vector<int>& vtxdist() const;
+    const std::vector<int>& global_ids() const;
+    // the global id of each node of mesh, before the domains order their
+    // nodes: the nodes of domain d have the ids [vtxdist[d], vtxdist[d+1])
+    // in the order of the mesh file
+
+    IndexRange owned_nodes(int d) const;
+    // the nodes of mesh owned by domain d, in file order
+    IndexRange domain_elements(int d) const;
+    // the elements of mesh with a node owned by domain d, in file order
+
+    const DomainHalo& halo(int d) const;
+    // the nodes of domain d, numbered as its Mesh numbers them before it
+    // orders its nodes, with the nodes it sends to and receives from each
+    // neighbour
+
+    void number_nodes(int d, const std::vector<int>& source_ids);
+    // called by domain d once it has ordered its nodes, where source_ids[k]
+    // is the node of mesh that has global id vtxdist[d]+k
+    int node_id(int i) const;
+    // global id of node i of mesh once its domain has ordered its nodes,
+    // waiting for the domain to call number_nodes()
+private:
+    ThreadPartition(const ThreadPartition&);
+    ThreadPartition& operator=(const ThreadPartition&);
+
+    // set by the domain that owns it, on its own cache line so that spinning
+    // on one does not slow the others
+    struct Numbered {
+        Numbered() : done(0) {}
+        volatile long done;
+        char padding[64 - sizeof(long)];
+    };
+
+    const GlobalMesh& mesh_;
+    std::vector<int> part_;
+    int domains_;
+    std::vector<int> vtxdist_;
+    std::vector<int> global_ids_;
+    Connectivity owned_, elements_;
+    std::vector<DomainHalo> halos_;
+    std::vector<int> node_ids_;
+    std::vector<Numbered> numbered_;
+};
+
+inline
+ThreadPartition::ThreadPartition(const GlobalMesh& mesh,
+                                 const std::vector<int>& part, int domains)
+    : mesh_(mesh), part_(part), domains_(domains),
+      node_ids_(mesh.nodes(), -1), numbered_(domains)
+{
+    if (domains < 1 || int(part.size()) != mesh.nodes())
+        throw IOException("ThreadPartition: there must be a domain for each node of the mesh");
+    for (int i = 0; i < mesh.nodes(); ++i)
+        if (part[i] < 0 || part[i] >= domains)
+            throw IOException("ThreadPartition: invalid domain in the partition");
+
+    domain_numbering(part, domains, vtxdist_, global_ids_);
+    domain_entities(mesh, part, domains, owned_, elements_);
+
+    // the external nodes of a domain are the nodes that share an element
+    // with its nodes, as in the node graph
+    Connectivity graph;
+    node_graph(mesh, graph);
+    domain_halos(graph, part, domains, halos_);
+}
+
+inline
+const GlobalMesh& ThreadPartition::mesh() const {
+    return mesh_;
+}
+
+inline
+const std::vector<int>& ThreadPartition::part() const {
+    return part_;
+}
+
+inline
+int ThreadPartition::domains() const {
+    return domains_;
+}
+
+inline
+const std::vector<int>& ThreadPartition::vtxdist() const {
+    return vtxdist_;
+}
+
+inline
+const std::vector<int>& ThreadPartition::global_ids() const {
+    return global_ids_;
+}
+
+inline
+IndexRange ThreadPartition::owned_nodes(int d) const {
+    assert(d >= 0 && d < domains_);
+    return owned_.row(d);
+}
+
+inline
+IndexRange ThreadPartition::domain_elements(int d) const {
+    assert(d >= 0 && d < domains_);
+    return elements_.row(d);
+}
+
+inline
+const DomainHalo& ThreadPartition::halo(int d) const {
+    assert(d >= 0 && d < domains_);
+    return halos_[d];
+}
+
+inline
+void ThreadPartition::number_nodes(int d, const std::vector<int>& source_ids) {
+    assert(d >= 0 && d < domains_);
+    assert(int(source_ids.size()) == vtxdist_[d+1] - vtxdist_[d]);
+    for (int k = 0; k < int(source_ids.size()); ++k)
+        node_ids_[source_ids[k]] = vtxdist_[d] + k;
+    #pragma omp flush
+    numbered_[d].done = 1;
+    #pragma omp flush
+}
+
+inline
+int ThreadPartition::node_id(int i) const {
+    const Numbered& owner = numbered_[part_[i]];
+    for (int spins = 0; !owner.done; spins++) {
+        if (spins > 100)
+            sched_yield();
+        #pragma omp flush
+    }
+    #pragma omp flush
+    return node_ids_[i];
+}
+
+} // end namespace mesh
+
+#endif
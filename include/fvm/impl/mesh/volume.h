@@ -22,10 +22,8 @@ private:
     int my_id;
     double my_vol;
     Point my_centroid;
-    std::vector<int> scvvec;
 
     friend class Mesh;
-    void add_scv(int id);
     void compute_volume();
     void compute_centroid();
 };
@@ -20,7 +20,7 @@ const Node& Volume::node() const {
 
 inline
 int Volume::scvs() const {
-    return scvvec.size();
+    return m->volume_scvs_.size(my_id);
 }
 
 inline
@@ -29,7 +29,7 @@ const SCV& Volume::scv(int i) const {
     if (i < 0 || i >= scvs())
         throw OutOfRangeException("Volume::scv(int): out of range");
     #endif
-    return mesh().scv(scvvec[i]);
+    return mesh().scv(m->volume_scvs_(my_id, i));
 }
 
 inline
@@ -42,11 +42,6 @@ Point Volume::centroid() const {
     return my_centroid;
 }
 
-inline
-void Volume::add_scv(int id) {
-    scvvec.push_back(id);
-}
-
 inline
 void Volume::compute_volume() {
     for (int i = 0; i < scvs(); ++i)
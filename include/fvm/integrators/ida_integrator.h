@@ -51,6 +51,11 @@ public:
 
     void initialise(double& t, TVecDevice &u, TVecDevice &up, Callback compute_residual);
 
+    // restarts IDA from the current values of u and up, e.g. after the
+    // solver has replaced them with the state migrated from another
+    // partition of the mesh
+    void reinitialise();
+
     const Mesh& mesh() const;
     Preconditioner& preconditioner();
 
@@ -265,6 +270,22 @@ initialise(double& tt, TVecDevice &y, TVecDevice &yp, Callback callback)
     }
 }
 
+// The integration history is discarded, so IDA restarts with a first order
+// step, as it does at the start of a run.
+template<class Physics, class Preconditioner>
+void IDAIntegrator<Physics, Preconditioner>::reinitialise()
+{
+    *procinfo << "\tIDAIntegrator<Physics, Preconditioner>::reinitialise()" << std::endl;
+    assert(ida_mem);
+
+    int localSize = mesh().local_nodes()*variables_per_node;
+    ulocal_store.at(lin::all)  = u.at(0,localSize-1);
+    uplocal_store.at(lin::all) = up.at(0,localSize-1);
+
+    int flag = IDAReInit(ida_mem, *t, ulocal, uplocal);
+    assert(flag == IDA_SUCCESS);
+}
+
 template<class Physics, class Preconditioner>
 IDAIntegrator<Physics, Preconditioner>::~IDAIntegrator()
 {
@@ -3,6 +3,7 @@
 
 #include "impl/mesh/forward.h"
 #include "impl/mesh/exception.h"
+#include "impl/mesh/box_mesh.h"
 
 #include "impl/mesh/node.h"
 #include "impl/mesh/edge.h"
@@ -4,8 +4,13 @@
 #include <lin/impl/rebind.h>
 #include <lin/lin.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <cassert>
+
 #include "fvm.h"
 #include "mesh.h"
+#include "impl/assemblers/block_assembler.h"
 
 namespace fvm {
 
@@ -23,7 +28,7 @@ public:
     //typedef typename fvm::ConstIterator<value_type>::type const_iterator;
     // Device
     typedef typename lin::rebind<coordinator,double>::type CoordDevice;
-    typedef typename lin::Vector<CoordDevice, double> TVecDevice;
+    typedef typename lin::Vector<double, CoordDevice> TVecDevice;
     
 
     void initialise(double& t,
@@ -33,6 +38,9 @@ public:
                     TVecDevice &sol, TVecDevice &deriv, TVecDevice &temp,
                     Callback compute_residual)
     {
+        // the tables of the default residual_evaluation are for the mesh
+        // of the solver, which is a new one when a run is rebalanced
+        assembler_.reset();
         static_cast<Physics*>(this)->init(t, m, sol, deriv);
     }
 
@@ -72,6 +80,26 @@ public:
         // Do nothing
     }
 
+    // The evaluation can be split in two phases, so that the exchange of the
+    // values at the external nodes overlaps the first (see
+    // FVMAssembler::compute_residual_interior).  The interior phase may only
+    // use the values at the local nodes, e.g. for the CV faces in
+    // [0, m.halo_independent_cvfaces()), and the halo phase does the rest.
+    // By default the halo phase does all of preprocess_evaluation().
+    void preprocess_evaluation_interior(double t,
+                                        const mesh::Mesh& m,
+                                        const TVecDevice &sol, const TVecDevice &deriv)
+    {
+        // Do nothing
+    }
+
+    void preprocess_evaluation_halo(double t,
+                                    const mesh::Mesh& m,
+                                    const TVecDevice &sol, const TVecDevice &deriv)
+    {
+        static_cast<Physics*>(this)->preprocess_evaluation(t, m, sol, deriv);
+    }
+
     void postprocess_evaluation(double t,
                                 const mesh::Mesh& m,
                                 //DEVICE
@@ -128,6 +156,57 @@ public:
         return value_type();
     }
 
+    // Batched forms of lhs, source, flux and boundary_flux, which the
+    // BlockAssembler calls for the control volumes (or CV faces) with ids in
+    // [begin, end), writing the value for id i to out[i-begin].  Physics can
+    // replace them with loops over the geometry tables of the mesh that the
+    // compiler vectorises; by default they call the functions above.
+    // They are called concurrently for different blocks.
+    void lhs_block(double t, const mesh::Mesh& m, int begin, int end,
+                   const TVecDevice &sol, const TVecDevice &deriv,
+                   value_type* out)
+    {
+        for (int i = begin; i < end; ++i)
+            out[i-begin] = static_cast<Physics*>(this)->lhs(t, m.volume(i), sol, deriv);
+    }
+
+    void source_block(double t, const mesh::Mesh& m, int begin, int end,
+                      const TVecDevice &sol, value_type* out)
+    {
+        for (int i = begin; i < end; ++i)
+            out[i-begin] = static_cast<Physics*>(this)->source(t, m.volume(i), sol);
+    }
+
+    void flux_block(double t, const mesh::Mesh& m, int begin, int end,
+                    const TVecDevice &sol, value_type* out)
+    {
+        for (int i = begin; i < end; ++i)
+            out[i-begin] = static_cast<Physics*>(this)->flux(t, m.cvface(i), sol);
+    }
+
+    void boundary_flux_block(double t, const mesh::Mesh& m, int begin, int end,
+                             const TVecDevice &sol, value_type* out)
+    {
+        for (int i = begin; i < end; ++i)
+            out[i-begin] = static_cast<Physics*>(this)->boundary_flux(t, m.cvface(i), sol);
+    }
+
+    // The residual from the functions above, assembled by the library's
+    // BlockAssembler.  Physics with their own assembly replace it.
+    void residual_evaluation(double t,
+                             const mesh::Mesh& m,
+                             const TVecDevice &sol, const TVecDevice &deriv,
+                             TVecDevice &res)
+    {
+        if (!assembler_)
+            assembler_.reset(new BlockAssembler<Physics>(m));
+        assert(&assembler_->mesh() == &m);
+        assembler_->residual(t, *static_cast<Physics*>(this), sol, deriv, res);
+    }
+
+private:
+    boost::shared_ptr<BlockAssembler<Physics> > assembler_;
+
 };
 
 } // end namespace fvm
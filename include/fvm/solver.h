@@ -6,11 +6,26 @@
 #include <fvm/impl/assemblers/fvm_assembler.h>
 #include <fvm/impl/communicators/communicator.h>
 
+#include <boost/shared_ptr.hpp>
+
+#include <cassert>
 #include <vector>
 
 namespace fvm {
 
+// the communicator that exchanges the node halos of a solver by default
 template<class Physics>
+struct NodeCommunicator {
+    typedef mpi::Communicator<typename Physics::TVecDevice::coordinator_type,
+                              typename Physics::value_type> type;
+};
+
+// NodeComm exchanges the halos of the solution, and must have the vec_add(),
+// group_add(), send() and recv() of mpi::Communicator.  It can be an
+// mpi::ThreadCommunicator, for a domain run by a thread of mpi::ThreadDomains.
+// With the mesh of a domain of a mesh::ThreadPartition the solver uses no MPI
+// at all, though the integrators in fvm/integrators take their norms with MPI.
+template<class Physics, class NodeComm = typename NodeCommunicator<Physics>::type>
 class SolverBase :
     private FVMAssembler<Physics>{
 
@@ -24,9 +39,13 @@ public:
     typedef typename Physics::TVecDevice TVecDevice;
     typedef typename Physics::TVecDevice::coordinator_type CoordDevice;
 
-    // Constructor
+    // Constructor, with a NodeComm of its own for the node pattern of m
     SolverBase(const Mesh& m, Physics& p, double t0);
 
+    // Constructor, with node_comm for the node pattern of m, which must
+    // outlive the solver
+    SolverBase(const Mesh& m, Physics& p, double t0, NodeComm& node_comm);
+
     // Returns the current solution time
     double time() const;
 
@@ -39,17 +58,37 @@ public:
     // returns a reference to the solution vector
     const TVecDevice& solution() const;
 
+    // copies the solution and its derivative at the local nodes,
+    // VariableTraits<value_type>::number values for each node
+    void state(std::vector<double>& u_local, std::vector<double>& up_local) const;
+
+    // time spent computing residuals on this domain, without the
+    // communication, since the solver was made or reset_residual_time()
+    double residual_time() const;
+    void reset_residual_time();
+
+    // writes the communication profile of the halo exchange, see
+    // mpi::CommProfile, if it is enabled
+    // notes: collective, only for an mpi::Communicator
+    void report_communication(std::ostream& out, const std::string& csvname) const;
+
 private:
     SolverBase(const SolverBase&);
     SolverBase& operator=(const SolverBase&);
 
+    void initialise();
+
 protected:
     const mesh::Mesh& m;
     mpi::MPICommPtr mpicomm_;
-    mpi::Communicator<CoordDevice, value_type> node_comm_;
+    boost::shared_ptr<NodeComm> own_node_comm_;
+    NodeComm& node_comm_;
     int u_comm_tag_, up_comm_tag_;
+    // u and up are exchanged together, in one message to each neighbour
+    int uup_comm_tag_;
     Physics& p;
     double t;
+    double residual_time_;
     // DEVICE
     // use minlin to store these vectors
     TVecDevice u;
@@ -62,15 +101,17 @@ protected:
     friend class Callback<Physics>;
 };
 
-template<class Physics, class Integrator>
-class Solver : public SolverBase<Physics> {
+template<class Physics, class Integrator,
+         class NodeComm = typename NodeCommunicator<Physics>::type>
+class Solver : public SolverBase<Physics, NodeComm> {
     typedef typename Physics::TVecDevice TVecDevice;
 public:
-    typedef SolverBase<Physics> Base;
+    typedef SolverBase<Physics, NodeComm> Base;
     typedef mesh::Mesh Mesh;
 
-    // Constructor
-    Solver(const Mesh& m, Physics& p, Integrator& i, double tt);
+    // Constructors, see SolverBase
+    Solver(const Mesh& m, Physics& p, Integrator& i, double tt=0.);
+    Solver(const Mesh& m, Physics& p, Integrator& i, double tt, NodeComm& node_comm);
 
     // Advances solution in time
     void advance();                  // by one internal timestep
@@ -79,20 +120,41 @@ public:
     // Returns a reference to the integrator
     Integrator& integrator() const;
 
+    // Restarts the integrator at time tt from the solution and derivative
+    // at the local nodes, e.g. the state of a run on another partition of the
+    // mesh moved to this one by Mesh::import_node_values()
+    void restart(double tt, const std::vector<double>& u_local,
+                 const std::vector<double>& up_local);
+
 private:
     Solver(const Solver&);
     Solver& operator=(const Solver&);
     Integrator& i;
 };
 
-template<class Physics>
-SolverBase<Physics>::SolverBase(const Mesh& m, Physics& p, double t0)
+template<class Physics, class NodeComm>
+SolverBase<Physics, NodeComm>::SolverBase(const Mesh& m, Physics& p, double t0)
     : Assembler(m, p),
-      m(m), p(p),
-      t(t0)
+      m(m), own_node_comm_(new NodeComm()), node_comm_(*own_node_comm_),
+      p(p), t(t0), residual_time_(0.)
 {
-    mpicomm_ = m.mpicomm();
     node_comm_.set_pattern( "NP_Type", m.node_pattern() );
+    initialise();
+}
+
+template<class Physics, class NodeComm>
+SolverBase<Physics, NodeComm>::SolverBase(const Mesh& m, Physics& p, double t0,
+                                          NodeComm& node_comm)
+    : Assembler(m, p),
+      m(m), node_comm_(node_comm),
+      p(p), t(t0), residual_time_(0.)
+{
+    initialise();
+}
+
+template<class Physics, class NodeComm>
+void SolverBase<Physics, NodeComm>::initialise() {
+    mpicomm_ = m.mpicomm();
 
     temp = TVecDevice( m.local_nodes()*value_type::variables );
     u = TVecDevice( m.nodes()*value_type::variables );
@@ -100,6 +162,10 @@ SolverBase<Physics>::SolverBase(const Mesh& m, Physics& p, double t0)
 
     u_comm_tag_ = node_comm_.vec_add(u);
     up_comm_tag_ = node_comm_.vec_add(up);
+    std::vector<int> uup_tags;
+    uup_tags.push_back(u_comm_tag_);
+    uup_tags.push_back(up_comm_tag_);
+    uup_comm_tag_ = node_comm_.group_add(uup_tags);
 
     physics().initialise(
         t, mesh(),
@@ -108,9 +174,9 @@ SolverBase<Physics>::SolverBase(const Mesh& m, Physics& p, double t0)
     );
 }
 
-template<class Physics, class Integrator>
-Solver<Physics, Integrator>::Solver(const Mesh& m, Physics& p, Integrator& I, double t0=0.)
-    : SolverBase<Physics>(m, p, t0), i(I)
+template<class Physics, class Integrator, class NodeComm>
+Solver<Physics, Integrator, NodeComm>::Solver(const Mesh& m, Physics& p, Integrator& I, double t0)
+    : Base(m, p, t0), i(I)
 {
     integrator().initialise(
         Base::t,
@@ -119,61 +185,121 @@ Solver<Physics, Integrator>::Solver(const Mesh& m, Physics& p, Integrator& I, do
     );
 }
 
-template<class Physics>
-int SolverBase<Physics>::compute_residual(TVecDevice &res, bool communicate) {
+template<class Physics, class Integrator, class NodeComm>
+Solver<Physics, Integrator, NodeComm>::Solver(const Mesh& m, Physics& p, Integrator& I, double t0,
+                                              NodeComm& node_comm)
+    : Base(m, p, t0, node_comm), i(I)
+{
+    integrator().initialise(
+        Base::t,
+        Base::u, Base::up,
+        Callback<Physics>(this)
+    );
+}
+
+template<class Physics, class NodeComm>
+int SolverBase<Physics, NodeComm>::compute_residual(TVecDevice &res, bool communicate) {
     util::Timer timer;
-    if (communicate) {
-        node_comm_.send(u_comm_tag_);
-        node_comm_.send(up_comm_tag_);
-        node_comm_.recv_all();
+    if (!communicate) {
+        timer.tic();
+        int retval = Assembler::compute_residual( t, u, up, res );
+        residual_time_ += timer.toc();
+        return retval;
     }
 
-    int retval = Assembler::compute_residual( t, u, up, res );
+    // the work that needs no external node values hides the exchange
+    node_comm_.send(uup_comm_tag_);
+    timer.tic();
+    Assembler::compute_residual_interior( t, u, up, res );
+    residual_time_ += timer.toc();
+    node_comm_.recv(uup_comm_tag_);
+
+    timer.tic();
+    int retval = Assembler::compute_residual_halo( t, u, up, res );
+    residual_time_ += timer.toc();
     return retval;
 }
 
-template<class Physics>
-double SolverBase<Physics>::time() const {
+template<class Physics, class NodeComm>
+double SolverBase<Physics, NodeComm>::time() const {
     return t;
 }
 
-template<class Physics>
-const mesh::Mesh& SolverBase<Physics>::mesh() const {
+template<class Physics, class NodeComm>
+const mesh::Mesh& SolverBase<Physics, NodeComm>::mesh() const {
     return m;
 }
 
-template<class Physics>
-Physics& SolverBase<Physics>::physics() const {
+template<class Physics, class NodeComm>
+Physics& SolverBase<Physics, NodeComm>::physics() const {
     return p;
 }
 
-template<class Physics, class Integrator>
-Integrator& Solver<Physics, Integrator>::integrator() const {
+template<class Physics, class Integrator, class NodeComm>
+Integrator& Solver<Physics, Integrator, NodeComm>::integrator() const {
     return i;
 }
 
-template<class Physics>
+template<class Physics, class NodeComm>
 const typename Physics::TVecDevice&
-SolverBase<Physics>::solution() const {
+SolverBase<Physics, NodeComm>::solution() const {
     return u;
 }
 
-template<class Physics>
-int Callback<Physics>::operator()(TVecDevice &y, bool communicate) {
-    assert(solver);
-    return solver->compute_residual(y, communicate);
+template<class Physics, class NodeComm>
+void SolverBase<Physics, NodeComm>::state(std::vector<double>& u_local,
+                                std::vector<double>& up_local) const {
+    int n = m.local_nodes()*VariableTraits<value_type>::number;
+    u_local.resize(n);
+    up_local.resize(n);
+    for (int i = 0; i < n; ++i) {
+        u_local[i] = u[i];
+        up_local[i] = up[i];
+    }
+}
+
+template<class Physics, class NodeComm>
+double SolverBase<Physics, NodeComm>::residual_time() const {
+    return residual_time_;
+}
+
+template<class Physics, class NodeComm>
+void SolverBase<Physics, NodeComm>::reset_residual_time() {
+    residual_time_ = 0.;
+}
+
+template<class Physics, class NodeComm>
+void SolverBase<Physics, NodeComm>::report_communication(std::ostream& out, const std::string& csvname) const {
+    node_comm_.report_profile(out, csvname);
+}
+
+template<class Physics, class Integrator, class NodeComm>
+void Solver<Physics, Integrator, NodeComm>::restart(double tt,
+                                          const std::vector<double>& u_local,
+                                          const std::vector<double>& up_local) {
+    int n = Base::m.local_nodes()*VariableTraits<typename Physics::value_type>::number;
+    assert(int(u_local.size()) == n && int(up_local.size()) == n);
+    Base::t = tt;
+    for (int i = 0; i < n; ++i) {
+        Base::u[i] = u_local[i];
+        Base::up[i] = up_local[i];
+    }
+    Base::node_comm_.send(Base::uup_comm_tag_);
+    Base::node_comm_.recv(Base::uup_comm_tag_);
+
+    integrator().reinitialise();
 }
 
-template<class Physics, class Integrator>
-void Solver<Physics, Integrator>::advance() {
+template<class Physics, class Integrator, class NodeComm>
+void Solver<Physics, Integrator, NodeComm>::advance() {
     integrator().advance();
 
     Base::node_comm_.send(Base::u_comm_tag_);
     Base::node_comm_.recv(Base::u_comm_tag_);
 }
 
-template<class Physics, class Integrator>
-void Solver<Physics, Integrator>::advance(double next_time) {
+template<class Physics, class Integrator, class NodeComm>
+void Solver<Physics, Integrator, NodeComm>::advance(double next_time) {
     integrator().advance(next_time);
 
     Base::node_comm_.send(Base::u_comm_tag_);
@@ -221,6 +221,32 @@ public:
         return request;
     }
 
+    // send count items of type data_type starting at dat, which may be null
+    // when count is zero
+    template <typename T>
+    MPI_Request Isend( T *dat, int count, int destination, int tag, MPI_Datatype data_type ){
+        *this << "Isend : block of length " << count << ", destination " << destination << ", tag " << tag << std::flush;
+        MPI_Request request;
+        int flag = MPI_Isend( reinterpret_cast<void*>(dat), count, data_type, destination, tag, comm_, &request );
+        *this << "\t: sent with request " << request  << " and flag " << flag_string(flag) << std::endl;
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Isend() : flag = " + flag_string(flag), flag );
+        return request;
+    }
+
+    // receive count items of type data_type starting at dat, which may be
+    // null when count is zero
+    template <typename T>
+    MPI_Request Irecv( T *dat, int count, int source, int tag, MPI_Datatype data_type ){
+        *this << "Irecv : block of length " << count << ", source " << source << ", tag " << tag << std::flush;
+        MPI_Request request;
+        int flag = MPI_Irecv( reinterpret_cast<void*>(dat), count, data_type, source, tag, comm_, &request );
+        *this << "\t: received with request " << request << " and flag " << flag_string(flag) << std::endl;
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Irecv() : flag = " + flag_string(flag), flag );
+        return request;
+    }
+
     // wait for a send/receive to complete
     int Wait( MPI_Request* request, MPI_Status* status ){
         *this << "Wait : request " << *request << std::flush;
@@ -234,11 +260,62 @@ public:
         return flag;
     }
 
+    // create a persistent send of a single item of type data_type, which is
+    // started by Startall() and completed by Wait()/Waitall() as often as
+    // needed, then released by Request_free()
+    template<typename T>
+    MPI_Request Send_init(T *dat, int destination, int tag, MPI_Datatype data_type ){
+        *this << "Send_init : destination " << destination << " tag " << tag << std::flush;
+        MPI_Request request;
+        int flag = MPI_Send_init( reinterpret_cast<void *>(dat), 1, data_type, destination, tag, comm_, &request );
+        *this << "\t: created request " << request << " with flag " << flag_string(flag) << std::endl;
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Send_init() : flag = " + flag_string(flag), flag );
+        return request;
+    }
+
+    // create a persistent receive of a single item of type data_type
+    template<typename T>
+    MPI_Request Recv_init(T *dat, int source, int tag, MPI_Datatype data_type ){
+        *this << "Recv_init : source " << source << " tag " << tag << std::flush;
+        MPI_Request request;
+        int flag = MPI_Recv_init( reinterpret_cast<void *>(dat), 1, data_type, source, tag, comm_, &request );
+        *this << "\t: created request " << request << " with flag " << flag_string(flag) << std::endl;
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Recv_init() : flag = " + flag_string(flag), flag );
+        return request;
+    }
+
+    // start persistent sends/receives
+    void Startall( std::vector<MPI_Request>& request ){
+        if( request.empty() )
+            return;
+        int flag = MPI_Startall( request.size(), &request[0] );
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Startall() : flag = " + flag_string(flag), flag );
+    }
+
+    // release a persistent request, which must not be active
+    void Request_free( MPI_Request& request ){
+        *this << "Request_free : request " << request << std::endl;
+        if( request==MPI_REQUEST_NULL )
+            return;
+        int flag = MPI_Request_free( &request );
+        if(flag!=MPI_SUCCESS)
+            throw_with_message( this->name() + " : Request_free() : flag = " + flag_string(flag), flag );
+    }
+
     // wait for a send/receive to complete
-    int Waitall( std::vector<MPI_Request> request, std::vector<MPI_Status> status ){
+    // the requests are updated in place, so that persistent requests
+    // can be started again
+    int Waitall( std::vector<MPI_Request>& request, std::vector<MPI_Status>& status ){
         *this << "Waitall : " << request.size() << " requests" << std::flush;
-        assert(request.size() == status.size());
-        int flag = MPI_Waitall( request.size(), const_cast<MPI_Request*>(&request[0]), const_cast<MPI_Status*>(&status[0]) );
+        assert(request.size() <= status.size());
+        if( request.empty() ){
+            *this << std::endl;
+            return MPI_SUCCESS;
+        }
+        int flag = MPI_Waitall( request.size(), &request[0], &status[0] );
         *this << "\t: finished with flag " << flag_string(flag) << std::endl;
         if(flag!=MPI_SUCCESS){
             if( flag==MPI_ERR_IN_STATUS ){
@@ -0,0 +1,118 @@
+#ifndef COST_RECORDER_H
+#define COST_RECORDER_H
+
+#include <mpi.h>
+
+#include <vector>
+
+namespace util{
+
+    // Records the time spent on each node of a domain over a calibration
+    // window of residual evaluations.  The clock runs from start(), and each
+    // charge charges the time since the previous charge (or start) to a node,
+    // a list of nodes or every node, so that the whole evaluation is shared
+    // out between the nodes that caused it.  When the window is over, or if
+    // no window was opened, start and charge do nothing.
+    //
+    // The mean cost of each node per evaluation can be passed to
+    // mesh::Mesh::save_node_weights(), so that the next run is partitioned
+    // to balance the measured work rather than the node counts.
+    class CostRecorder{
+        public:
+            CostRecorder() : evaluations_(0), remaining_(0), t_(0.) {};
+
+            // record the next evaluations residual evaluations of nodes nodes
+            void calibrate(int nodes, int evaluations){
+                cost_.assign(nodes, 0.);
+                evaluations_ = 0;
+                remaining_ = evaluations;
+            };
+
+            // true during the calibration window
+            bool recording() const{
+                return remaining_>0;
+            };
+
+            // start the clock at the beginning of an evaluation
+            void start(){
+                if(recording())
+                    t_ = MPI_Wtime();
+            };
+
+            // charge the time since the last charge to node i
+            // nodes outside [0, nodes) are not charged
+            void charge(int i){
+                if(!recording())
+                    return;
+                double t = lap();
+                if(i>=0 && i<int(cost_.size()))
+                    cost_[i] += t;
+            };
+
+            // charge the time since the last charge to the nodes in index,
+            // in equal shares
+            template <typename IndexVector>
+            void charge(const IndexVector& index){
+                if(!recording())
+                    return;
+                double t = lap();
+                int n = index.size();
+                if(n==0)
+                    return;
+                t /= n;
+                for(int k=0; k<n; k++)
+                    if(index[k]>=0 && index[k]<int(cost_.size()))
+                        cost_[index[k]] += t;
+            };
+
+            // charge the time since the last charge to every node, in equal
+            // shares
+            void charge_all(){
+                if(!recording())
+                    return;
+                double t = lap();
+                if(cost_.empty())
+                    return;
+                t /= cost_.size();
+                for(int i=0; i<int(cost_.size()); i++)
+                    cost_[i] += t;
+            };
+
+            // end of an evaluation, which closes the window after the
+            // requested number of evaluations
+            void finish_evaluation(){
+                if(!recording())
+                    return;
+                evaluations_++;
+                remaining_--;
+            };
+
+            // number of evaluations recorded
+            int evaluations() const{
+                return evaluations_;
+            };
+
+            // mean time in seconds spent on each node per evaluation
+            std::vector<double> cost() const{
+                std::vector<double> c(cost_);
+                if(evaluations_)
+                    for(int i=0; i<int(c.size()); i++)
+                        c[i] /= evaluations_;
+                return c;
+            };
+
+        private:
+            double lap(){
+                double t = MPI_Wtime();
+                double elapsed = t-t_;
+                t_ = t;
+                return elapsed;
+            };
+
+            std::vector<double> cost_;
+            int evaluations_;
+            int remaining_;
+            double t_;
+    };
+}
+#endif
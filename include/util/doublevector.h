@@ -86,6 +86,10 @@ public:
     void permute_add_weighted_inverse(const DoubleVector &, const IntVector &, const DoubleVector &);
     void permute_add_weighted_pq(const DoubleVector &, const IntVector &, const IntVector &, const DoubleVector &);
     void permute_add_weighted_pqr(const DoubleVector &, const IntVector &, const IntVector &, const IntVector &,const DoubleVector &);
+    // as above, for a p (lhs_p) in which no index is repeated, so that the
+    // loop is shared between the OpenMP threads
+    void permute_add_weighted_inverse_distinct(const DoubleVector &, const IntVector &, const DoubleVector &);
+    void permute_add_weighted_pqr_distinct(const DoubleVector &, const IntVector &, const IntVector &, const IntVector &,const DoubleVector &);
     void scal_assign(double, const DoubleVector &);
     void axpy(double, const DoubleVector &);
 
@@ -44,9 +44,24 @@ else
 fi
 
 # perform domain decomposition if the user has requested it
-if [ $# -eq 2 ]
+# an optional third argument, rcb or inertial, partitions the mesh with
+# ../partition instead of decomp: it writes the compiled mesh and the
+# partition that split reads, so ParMETIS is not needed.
+# If there is a file of measured node costs, saved by a run with -cost,
+# it is balanced by an inertial partition unless rcb is asked for.
+if [ $# -ge 2 ]
 then
     nProcs=$2
+    partitioner=$3
+    weightOpt=""
+    if [ -f ${baseFile}.weights ]
+    then
+        weightOpt="-weights ${baseFile}.weights"
+        if [ -z "${partitioner}" ]
+        then
+            partitioner=inertial
+        fi
+    fi
     echo
     echo -----------------------------------------------------------------------
     echo Performing domain decomposition with ${nProcs} domains
@@ -55,17 +70,38 @@ then
 
     decompLog=${baseFile}_decomp_${nProcs}.log
     splitLog=${baseFile}_split_${nProcs}.log
-    echo calling decomp \(see logfile ${decompLog} for details\)...
-    #mpirun -np ${nProcs} ../decomp/bin/decomp ${baseFile} > ${decompLog}
-    mpirun -np ${nProcs} ../decomp/bin/decomp ${baseFile}
-    echo "     finished"
+    if [ "${partitioner}" = "rcb" ] || [ "${partitioner}" = "inertial" ]
+    then
+        echo calling partition with ${partitioner}...
+        if [ "${partitioner}" = "inertial" ]
+        then
+            ../partition -inertial ${weightOpt} ${baseFile} ${nProcs}
+        else
+            ../partition ${weightOpt} ${baseFile} ${nProcs}
+        fi
+        echo "     finished"
+    else
+        echo calling decomp \(see logfile ${decompLog} for details\)...
+        #mpirun -np ${nProcs} ../decomp/bin/decomp ${baseFile} > ${decompLog}
+        mpirun -np ${nProcs} ../decomp/bin/decomp ${baseFile}
+        echo "     finished"
+    fi
     echo calling split \(see logfile ${splitLog} for details\)...
     #mpirun -np ${nProcs} ../decomp/bin/split ${baseFile} > ${splitLog}
     mpirun -np ${nProcs} ../decomp/bin/split ${baseFile}
     echo "     finished"
 
+    # convert the text mesh files to the binary format read by Mesh
+    if [ -x ../pmesh2bpmesh ]
+    then
+        echo calling pmesh2bpmesh...
+        ../pmesh2bpmesh ${baseFile} ${nProcs}
+        echo "     finished"
+    fi
+
     #cleanup intermediate files
-    rm ${baseFile}_p_${nProcs}.txt
+    # the node permutation in _p_ is kept, Mesh uses it to save node
+    # weights in the order of the .mesh file
     rm ${baseFile}_q_${nProcs}.txt
     rm ${baseFile}_${nProcs}.bmesh
     rm ${baseFile}_${nProcs}.perm
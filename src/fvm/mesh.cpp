@@ -1,4 +1,10 @@
 #include <fvm/mesh.h>
+#include <fvm/impl/mesh/binary_mesh.h>
+#include <fvm/impl/mesh/element_faces.h>
+#include <fvm/impl/mesh/entity_table.h>
+#include <fvm/impl/mesh/global_mesh.h>
+#include <fvm/impl/mesh/partition.h>
+#include <fvm/impl/mesh/thread_partition.h>
 #include <util/quadrature3d.h>
 
 #include <algorithm>
@@ -11,11 +17,22 @@
 #include <map>
 #include <vector>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+
 #include <boost/config.hpp>
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/cuthill_mckee_ordering.hpp>
 #include <boost/graph/properties.hpp>
 #include <boost/graph/bandwidth.hpp>
+#include <boost/shared_ptr.hpp>
+
+#ifdef MESH_PARMETIS
+#include <parmetis.h>
+#endif
 
 namespace mesh {
 
@@ -39,6 +56,10 @@ struct Z {
 
 template<typename T>
 std::string to_string(const T& t);
+std::string domain_file_name(const std::string& meshname, int size, int rank,
+                             const std::string& extension);
+bool file_exists(const std::string& filename);
+bool file_is_newer(const std::string& filename, const std::string& than);
 double pyramid_volume(CVFace_shape face, Point apex);
 double triangle_volume(Point p1, Point p2, Point p3);
 std::pair<int, std::pair<int, int> >
@@ -46,6 +67,9 @@ get_back_face_and_edges(const Element& e, const Edge& edge, const Node& node);
 std::pair<CVFace_shape, CVFace_shape>
 make_back_faces(const Element& e, const Edge& edge);
 std::pair<int, int> find_RCM_from_edges( const std::vector<std::pair<int, int> > &edges, std::vector<int> &p );
+void find_SFC_from_points( const std::vector<Point> &points, int dim, bool hilbert, std::vector<int> &p );
+void colour_by_nodes(const std::vector<int>& front, const std::vector<int>& back,
+                     int nodes, Connectivity& colours);
 
 // Mesh file format:
 // n_dom dom_id
@@ -54,6 +78,16 @@ std::pair<int, int> find_RCM_from_edges( const std::vector<std::pair<int, int> >
 // global-id (repeat)
 // x y z boundary-tag (repeat)
 // n_nodes n_edges n_faces [node-ids] [boundary-tags] (repeat)
+//
+// If a binary version of the file (.bpmesh, see binary_mesh.h) has been
+// generated with pmesh2bpmesh it is memory mapped and used instead.  If there
+// are no mesh files for the number of domains, the global mesh is read from a
+// gmsh file meshname.msh, or else from the meshname.mesh file written by
+// meshing/Mesh.py, by the root domain, which partitions it and sends each
+// domain its part when it is loaded (see read_global_mesh_data), so that
+// decomp and split need not be run for each number of domains.  If
+// there is a file meshname.weights, written by save_node_weights(), the
+// partition balances the node weights rather than the node counts.
 
 // basic idea:
 //  internal stuff is stuff that belongs to and is referenced by this domain only
@@ -67,25 +101,142 @@ std::pair<int, int> find_RCM_from_edges( const std::vector<std::pair<int, int> >
 // n_elements_int: number of elements not repeated by any other domain
 // n_elements_bnd: number of elements repeated by at least one other domain
 
-Mesh::Mesh(const std::string& meshname, mpi::MPICommPtr comm)
+Mesh::Mesh(const std::string& meshname, mpi::MPICommPtr comm,
+           bool use_snapshot, node_ordering ordering)
     : n_faces_int(0), n_faces_bnd(0),
-      n_cvfaces_int(0), n_cvfaces_bnd(0)
+      n_cvfaces_int(0), n_cvfaces_bnd(0), n_physical_props(0),
+      n_nodes_indep_(0), n_edges_indep_(0), n_cvfaces_indep_(0),
+      ordering_(ordering)
 {
     mpicomm_ = comm->duplicate("MESH");
-    std::ifstream infile, propfile;
-    open_mesh_file(meshname, infile, propfile);
-    read_mesh_data(infile, propfile);
+
+    // use the binary version of the mesh file if one has been generated
+    // since the text version was last written
+    std::string binname = domain_file_name(
+        meshname, mpicomm_->size(), mpicomm_->rank(), ".bpmesh");
+    std::string textname = domain_file_name(
+        meshname, mpicomm_->size(), mpicomm_->rank(), ".pmesh");
+    std::string gmshname = meshname + ".msh";
+    std::string globalname = meshname + ".mesh";
+    std::string weightname = meshname + ".weights";
+    std::string source = textname;
+    if (file_is_newer(binname, textname))
+        source = binname;
+    else if (!file_exists(textname) && file_exists(gmshname))
+        source = gmshname;
+    else if (!file_exists(textname) && file_exists(globalname))
+        source = globalname;
+
+    // Restore the mesh from a snapshot if one was saved from the same input
+    // files by a previous run.  Either every domain restores or none do,
+    // because constructing the node pattern requires communication.
+    // Snapshots can also be requested for every mesh with FVM_MESH_SNAPSHOT.
+    if (std::getenv("FVM_MESH_SNAPSHOT"))
+        use_snapshot = true;
+    std::string snapname = domain_file_name(
+        meshname, mpicomm_->size(), mpicomm_->rank(), ".msnap");
+    std::vector<std::string> inputs;
+    inputs.push_back(source);
+    inputs.push_back(meshname + ".prop");
+    inputs.push_back(meshname + "_p_" + to_string(mpicomm_->size()) + ".txt");
+    inputs.push_back(weightname);
+    int restore = use_snapshot && snapshot_is_current(snapname, inputs);
+    MPI_Allreduce(MPI_IN_PLACE, &restore, 1, MPI_INT, MPI_MIN,
+                  mpicomm_->communicator());
+    if (restore) {
+        *mpicomm_ << "Mesh: restoring mesh from snapshot " << snapname << std::endl;
+        read_snapshot(snapname);
+        construct_geometry_tables();
+        return;
+    }
+
+    if (source == binname) {
+        *mpicomm_ << "Mesh: reading binary mesh file " << binname << std::endl;
+        read_binary_mesh_data(binname);
+        read_node_source_ids(meshname);
+    } else if (source == gmshname || source == globalname) {
+        *mpicomm_ << "Mesh: reading global mesh file " << source << std::endl;
+        read_global_mesh_data(source, weightname, std::vector<double>());
+    } else {
+        std::ifstream infile, propfile;
+        open_mesh_file(meshname, infile, propfile);
+        read_mesh_data(infile, propfile);
+        read_node_source_ids(meshname);
+    }
     construct_control_volumes();
+    construct_geometry_tables();
     construct_node_pattern();
+
+    // failing to save a snapshot only costs time on the next run
+    if (use_snapshot) {
+        try {
+            write_snapshot(snapname, inputs);
+        } catch (const IOException& e) {
+            *mpicomm_ << "Mesh: unable to save snapshot : " << e.what() << std::endl;
+        }
+    }
+}
+
+Mesh::Mesh(const BoxMesh& box, mpi::MPICommPtr comm, node_ordering ordering)
+    : n_faces_int(0), n_faces_bnd(0),
+      n_cvfaces_int(0), n_cvfaces_bnd(0), n_physical_props(0),
+      n_nodes_indep_(0), n_edges_indep_(0), n_cvfaces_indep_(0),
+      ordering_(ordering)
+{
+    mpicomm_ = comm->duplicate("MESH");
+
+    *mpicomm_ << "Mesh: generating " << box.name() << std::endl;
+    generate_box_mesh(box);
+    construct_control_volumes();
+    construct_geometry_tables();
+    construct_node_pattern();
+}
+
+Mesh::Mesh(const std::string& meshname, const std::vector<double>& weights,
+           mpi::MPICommPtr comm, node_ordering ordering)
+    : n_faces_int(0), n_faces_bnd(0),
+      n_cvfaces_int(0), n_cvfaces_bnd(0), n_physical_props(0),
+      n_nodes_indep_(0), n_edges_indep_(0), n_cvfaces_indep_(0),
+      ordering_(ordering)
+{
+    mpicomm_ = comm->duplicate("MESH");
+
+    std::string source = meshname + ".msh";
+    if (!file_exists(source))
+        source = meshname + ".mesh";
+    if (!file_exists(source))
+        throw IOException("Couldn't open global mesh file " + meshname + ".msh or " + source);
+
+    *mpicomm_ << "Mesh: repartitioning global mesh file " << source << std::endl;
+    read_global_mesh_data(source, "", weights);
+    construct_control_volumes();
+    construct_geometry_tables();
+    construct_node_pattern();
+}
+
+// The domains of a ThreadPartition have no MPI communicator, so nothing is
+// logged.
+Mesh::Mesh(ThreadPartition& partition, int domain, node_ordering ordering)
+    : n_faces_int(0), n_faces_bnd(0),
+      n_cvfaces_int(0), n_cvfaces_bnd(0), n_physical_props(0),
+      n_nodes_indep_(0), n_edges_indep_(0), n_cvfaces_indep_(0),
+      ordering_(ordering)
+{
+    if (domain < 0 || domain >= partition.domains())
+        throw IOException("Mesh: invalid domain of a thread partition");
+
+    make_thread_domain(partition, domain);
+    construct_control_volumes();
+    construct_geometry_tables();
+    construct_thread_node_pattern(partition);
 }
 
 void Mesh::open_mesh_file(const std::string& meshname,
                           std::ifstream& infile,
                           std::ifstream& propfile) {
 
-    std::string filename = meshname + "_" +
-                           to_string(mpicomm_->size()) + "_" +
-                           to_string(mpicomm_->rank()) + ".pmesh";
+    std::string filename = domain_file_name(
+        meshname, mpicomm_->size(), mpicomm_->rank(), ".pmesh");
 
     infile.open(filename.c_str());
     if (!infile)
@@ -104,36 +255,1477 @@ void Mesh::read_mesh_data(std::ifstream& infile, std::ifstream& propfile) {
     read_header_data(infile, n_nodes_ext, n_nodes, n_elements);
     read_external_nodes(infile, n_nodes_ext);
     read_nodes(infile, n_nodes);
-    std::set<Edge> edgeset;
-    std::set<Face> faceset;
-    read_elements(infile, n_elements, edgeset, faceset);
-    reorder_nodes_edges(edgeset, faceset);
-    //populate_edges_and_faces(edgeset, faceset);
+    EntityTable edgetable(2*n_elements), facetable(2*n_elements);
+    read_elements(infile, n_elements, edgetable, facetable);
+    process_mesh_data();
+}
+
+/*******************************************
+ * Mesh snapshots
+ *
+ * A snapshot holds the fully constructed
+ * mesh for one domain, so that repeated runs
+ * on the same mesh skip the reordering and
+ * control volume construction.  Snapshots
+ * are written in native binary format and
+ * are only valid for the input files (and
+ * number of domains, node ordering and
+ * build of this library) they were made
+ * from.
+ *******************************************/
+namespace {
+
+struct SnapshotHeader {
+    char magic[8];
+    int version;
+    int byte_order;
+    int domains, domain_id;
+    int ordering;
+    char build[24];
+};
+
+const char snapshot_magic[8] = {'F','V','M','S','N','A','P','\0'};
+const int snapshot_version = 6;
+// when this file was compiled, so that a rebuilt library never restores
+// a snapshot written by an older one
+const char snapshot_build[] = __DATE__ " " __TIME__;
+
+// size and modification time of each of the input files, or -1 for files
+// that do not exist, so that adding one also invalidates the snapshot
+std::vector<long long> source_stamps(const std::vector<std::string>& inputs) {
+    std::vector<long long> stamps(2*inputs.size(), -1);
+    for (int i = 0; i < int(inputs.size()); ++i) {
+        struct stat st;
+        if (stat(inputs[i].c_str(), &st) == 0) {
+            stamps[2*i] = st.st_size;
+            stamps[2*i+1] = st.st_mtime;
+        }
+    }
+    return stamps;
+}
+
+template<typename T>
+void write_pod(std::ostream& out, const T& t) {
+    out.write(reinterpret_cast<const char*>(&t), sizeof(T));
+}
+
+template<typename T>
+void write_vector(std::ostream& out, const std::vector<T>& v) {
+    write_pod(out, int(v.size()));
+    if (!v.empty())
+        out.write(reinterpret_cast<const char*>(&v[0]), sizeof(T)*v.size());
+}
+
+template<typename T>
+void read_pod(std::istream& in, T& t) {
+    in.read(reinterpret_cast<char*>(&t), sizeof(T));
+    if (!in)
+        throw IOException("Couldn't read mesh snapshot");
+}
+
+template<typename T>
+void read_vector(std::istream& in, std::vector<T>& v) {
+    int n = 0;
+    read_pod(in, n);
+    v.resize(n);
+    if (n)
+        in.read(reinterpret_cast<char*>(&v[0]), sizeof(T)*n);
+    if (!in)
+        throw IOException("Couldn't read mesh snapshot");
+}
+
+// true for nodes that are not flagged as halo-dependent
+struct NodeIsIndependent {
+    explicit NodeIsIndependent(const std::vector<char>& halo) : halo(halo) {}
+    bool operator()(int i) const { return !halo[i]; }
+    const std::vector<char>& halo;
+};
+
+// orders CV faces whose element is not flagged as halo-dependent first,
+// then by the usual CV face ordering
+struct CVFaceIsIndependentFirst {
+    explicit CVFaceIsIndependentFirst(const std::vector<char>& halo) : halo(halo) {}
+    bool operator()(const CVFace& a, const CVFace& b) const {
+        char ha = halo[a.element().id()];
+        char hb = halo[b.element().id()];
+        if (ha != hb) return ha < hb;
+        return a < b;
+    }
+    const std::vector<char>& halo;
+};
+
+} // end anonymous namespace
+
+// Returns true if snapname is a snapshot of the mesh for this domain made
+// from the input files as they are now
+bool Mesh::snapshot_is_current(const std::string& snapname,
+                               const std::vector<std::string>& inputs) const {
+    std::ifstream in(snapname.c_str(), std::ios::binary);
+    SnapshotHeader h;
+    if (!in || !in.read(reinterpret_cast<char*>(&h), sizeof(h)))
+        return false;
+    if (!std::equal(snapshot_magic, snapshot_magic+8, h.magic)
+        || h.version != snapshot_version
+        || h.byte_order != binary_mesh_byte_order
+        || h.domains != mpicomm_->size()
+        || h.domain_id != mpicomm_->rank()
+        || h.ordering != ordering_
+        || std::strncmp(h.build, snapshot_build, sizeof(h.build)))
+        return false;
+    std::vector<long long> stamps;
+    try {
+        read_vector(in, stamps);
+    } catch (const IOException&) {
+        return false;
+    }
+    return stamps == source_stamps(inputs);
+}
+
+void Mesh::write_snapshot(const std::string& snapname,
+                          const std::vector<std::string>& inputs) const {
+    SnapshotHeader h;
+    std::copy(snapshot_magic, snapshot_magic+8, h.magic);
+    h.version = snapshot_version;
+    h.byte_order = binary_mesh_byte_order;
+    h.domains = mpicomm_->size();
+    h.domain_id = mpicomm_->rank();
+    h.ordering = ordering_;
+    std::fill(h.build, h.build+sizeof(h.build), '\0');
+    std::strncpy(h.build, snapshot_build, sizeof(h.build)-1);
+
+    // write to a temporary file first, so that an interrupted run
+    // never leaves a partial snapshot behind
+    std::string tmpname = snapname + ".tmp";
+    std::ofstream out(tmpname.c_str(), std::ios::binary);
+    if (!out)
+        throw IOException("Couldn't open file: " + tmpname);
+    write_pod(out, h);
+    write_vector(out, source_stamps(inputs));
+
+    // counts and domain information
+    int counts[] = {
+        mesh_dim_, n_dom, dom_id,
+        n_nodes_gbl_, n_nodes_loc_, n_nodes_int_, n_nodes_bnd_, n_nodes_ext_,
+        n_elements_int, n_elements_bnd, n_faces_int, n_faces_bnd,
+        n_cvfaces_int, n_cvfaces_bnd, n_physical_props,
+        n_nodes_indep_, n_edges_indep_, n_cvfaces_indep_
+    };
+    out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    write_vector(out, vtx_dist);
+    write_vector(out, nodes_ext);
+    write_vector(out, node_source_id_);
+    write_vector(out, std::vector<int>(boundary_tags.begin(), boundary_tags.end()));
+    write_pod(out, int(properties.size()));
+    for (int i = 0; i < int(properties.size()); ++i)
+        write_vector(out, properties[i]);
+
+    // nodes
+    write_pod(out, nodes());
+    for (int i = 0; i < nodes(); ++i) {
+        const Node& n = nodevec[i];
+        write_pod(out, n.my_id);
+        write_vector(out, n.boundary_id);
+        write_pod(out, n.p);
+    }
+
+    // edges
+    write_pod(out, edges());
+    for (int i = 0; i < edges(); ++i) {
+        const Edge& e = edgevec[i];
+        write_pod(out, e.my_id);
+        write_pod(out, e.front_id);
+        write_pod(out, e.back_id);
+        write_pod(out, e.my_midpoint);
+    }
+
+    // faces
+    write_pod(out, faces());
+    for (int i = 0; i < faces(); ++i) {
+        const Face& f = facevec[i];
+        write_pod(out, f.my_id);
+        write_pod(out, f.boundary_id);
+        write_pod(out, f.my_centroid);
+    }
+
+    // elements
+    write_pod(out, elements());
+    for (int i = 0; i < elements(); ++i) {
+        const Element& e = elementvec[i];
+        write_pod(out, e.my_id);
+        write_pod(out, e.my_physical_tag);
+        write_pod(out, e.my_type);
+        write_pod(out, e.my_centroid);
+    }
+
+    // CV faces
+    write_pod(out, cvfaces());
+    for (int i = 0; i < cvfaces(); ++i) {
+        const CVFace& f = cvfacevec[i];
+        write_pod(out, f.my_id);
+        write_pod(out, f.element_id);
+        write_pod(out, f.front_id);
+        write_pod(out, f.back_id);
+        write_pod(out, f.boundary_id);
+        write_pod(out, f.edge_id);
+        write_pod(out, f.my_tag);
+        write_pod(out, f.shape.points());
+        for (int j = 0; j < f.shape.points(); ++j)
+            write_pod(out, f.shape.point(j));
+        write_pod(out, f.my_area);
+        write_pod(out, f.my_normal);
+        write_pod(out, f.my_centroid);
+    }
+
+    // sub control volumes
+    write_pod(out, scvs());
+    for (int i = 0; i < scvs(); ++i) {
+        const SCV& s = scvvec[i];
+        write_pod(out, s.my_id);
+        write_pod(out, s.element_id);
+        write_pod(out, s.node_id);
+        write_pod(out, s.boundary_faces);
+        write_pod(out, s.my_vol);
+        write_pod(out, s.c);
+    }
+
+    // control volumes
+    for (int i = 0; i < nodes(); ++i) {
+        const Volume& v = volumevec[i];
+        write_pod(out, v.my_id);
+        write_pod(out, v.my_vol);
+        write_pod(out, v.my_centroid);
+    }
+
+    // connectivity
+    const Connectivity* connectivity[] = {
+        &element_nodes_, &element_edges_, &element_faces_, &element_cvfaces_,
+        &element_neighbours_, &face_nodes_, &face_edges_, &scv_cvfaces_,
+        &volume_scvs_, &edge_cvfaces_
+    };
+    for (int i = 0; i < 10; ++i) {
+        write_vector(out, connectivity[i]->offsets_);
+        write_vector(out, connectivity[i]->indices_);
+    }
+    write_vector(out, scv_vertices_);
+
+    // node pattern
+    const std::vector<int>& neighbours = node_pattern_.neighbour_list();
+    write_vector(out, neighbours);
+    for (int i = 0; i < int(neighbours.size()); ++i) {
+        write_vector(out, node_pattern_.send_index(neighbours[i]));
+        write_vector(out, node_pattern_.recv_index(neighbours[i]));
+    }
+
+    out.close();
+    if (!out || std::rename(tmpname.c_str(), snapname.c_str()) != 0) {
+        std::remove(tmpname.c_str());
+        throw IOException("Couldn't write file: " + snapname);
+    }
+}
+
+void Mesh::read_snapshot(const std::string& snapname) {
+    std::ifstream in(snapname.c_str(), std::ios::binary);
+    if (!in)
+        throw IOException("Couldn't open file: " + snapname);
+    SnapshotHeader h;
+    read_pod(in, h);
+    std::vector<long long> stamps;
+    read_vector(in, stamps);
+
+    // counts and domain information
+    int counts[18];
+    for (int i = 0; i < 18; ++i)
+        read_pod(in, counts[i]);
+    mesh_dim_ = counts[0];
+    n_dom = counts[1];
+    dom_id = counts[2];
+    n_nodes_gbl_ = counts[3];
+    n_nodes_loc_ = counts[4];
+    n_nodes_int_ = counts[5];
+    n_nodes_bnd_ = counts[6];
+    n_nodes_ext_ = counts[7];
+    n_elements_int = counts[8];
+    n_elements_bnd = counts[9];
+    n_faces_int = counts[10];
+    n_faces_bnd = counts[11];
+    n_cvfaces_int = counts[12];
+    n_cvfaces_bnd = counts[13];
+    n_physical_props = counts[14];
+    n_nodes_indep_ = counts[15];
+    n_edges_indep_ = counts[16];
+    n_cvfaces_indep_ = counts[17];
+    read_vector(in, vtx_dist);
+    read_vector(in, nodes_ext);
+    read_vector(in, node_source_id_);
+    std::vector<int> tags;
+    read_vector(in, tags);
+    boundary_tags.insert(tags.begin(), tags.end());
+    int n = 0;
+    read_pod(in, n);
+    properties.resize(n);
+    for (int i = 0; i < n; ++i)
+        read_vector(in, properties[i]);
+
+    // nodes
+    read_pod(in, n);
+    nodevec.resize(n);
+    for (int i = 0; i < n; ++i) {
+        Node& node = nodevec[i];
+        node.m = this;
+        read_pod(in, node.my_id);
+        read_vector(in, node.boundary_id);
+        read_pod(in, node.p);
+    }
+
+    // edges
+    read_pod(in, n);
+    edgevec.resize(n);
+    for (int i = 0; i < n; ++i) {
+        Edge& e = edgevec[i];
+        e.m = this;
+        read_pod(in, e.my_id);
+        read_pod(in, e.front_id);
+        read_pod(in, e.back_id);
+        read_pod(in, e.my_midpoint);
+    }
+
+    // faces
+    read_pod(in, n);
+    facevec.resize(n);
+    for (int i = 0; i < n; ++i) {
+        Face& f = facevec[i];
+        f.m = this;
+        read_pod(in, f.my_id);
+        read_pod(in, f.boundary_id);
+        read_pod(in, f.my_centroid);
+    }
+
+    // elements
+    read_pod(in, n);
+    elementvec.resize(n);
+    for (int i = 0; i < n; ++i) {
+        Element& e = elementvec[i];
+        e.m = this;
+        read_pod(in, e.my_id);
+        read_pod(in, e.my_physical_tag);
+        read_pod(in, e.my_type);
+        read_pod(in, e.my_centroid);
+    }
+
+    // CV faces
+    read_pod(in, n);
+    cvfacevec.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        int id, element_id, front_id, back_id, boundary_id, edge_id, tag, points;
+        read_pod(in, id);
+        read_pod(in, element_id);
+        read_pod(in, front_id);
+        read_pod(in, back_id);
+        read_pod(in, boundary_id);
+        read_pod(in, edge_id);
+        read_pod(in, tag);
+        read_pod(in, points);
+        if (points != 2 && points != 4)
+            throw IOException("Invalid CV face in mesh snapshot");
+        Point p[4];
+        for (int j = 0; j < points; ++j)
+            read_pod(in, p[j]);
+        CVFace_shape shape = (points == 2) ?
+            CVFace_shape(p[0], p[1]) : CVFace_shape(p[0], p[1], p[2], p[3]);
+        cvfacevec.push_back(CVFace(*this, id, element_id, front_id, back_id,
+                                   boundary_id, shape, tag, edge_id));
+        // use the stored geometry rather than recomputing it
+        CVFace& f = cvfacevec.back();
+        read_pod(in, f.my_area);
+        read_pod(in, f.my_normal);
+        read_pod(in, f.my_centroid);
+    }
+
+    // sub control volumes
+    read_pod(in, n);
+    scvvec.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        int id, element_id, node_id;
+        read_pod(in, id);
+        read_pod(in, element_id);
+        read_pod(in, node_id);
+        scvvec.push_back(SCV(*this, id, element_id, node_id));
+        SCV& s = scvvec.back();
+        read_pod(in, s.boundary_faces);
+        read_pod(in, s.my_vol);
+        read_pod(in, s.c);
+    }
+
+    // control volumes
+    volumevec.reserve(nodes());
+    for (int i = 0; i < nodes(); ++i) {
+        int id;
+        read_pod(in, id);
+        volumevec.push_back(Volume(*this, id));
+        Volume& v = volumevec.back();
+        read_pod(in, v.my_vol);
+        read_pod(in, v.my_centroid);
+    }
+
+    // connectivity
+    Connectivity* connectivity[] = {
+        &element_nodes_, &element_edges_, &element_faces_, &element_cvfaces_,
+        &element_neighbours_, &face_nodes_, &face_edges_, &scv_cvfaces_,
+        &volume_scvs_, &edge_cvfaces_
+    };
+    for (int i = 0; i < 10; ++i) {
+        read_vector(in, connectivity[i]->offsets_);
+        read_vector(in, connectivity[i]->indices_);
+        if (connectivity[i]->offsets_.empty())
+            throw IOException("Invalid connectivity in mesh snapshot");
+    }
+    read_vector(in, scv_vertices_);
+
+    // node pattern
+    node_pattern_ = Pattern(mpicomm_);
+    std::vector<int> neighbours;
+    read_vector(in, neighbours);
+    for (int i = 0; i < int(neighbours.size()); ++i) {
+        std::vector<int> send_index, recv_index;
+        read_vector(in, send_index);
+        read_vector(in, recv_index);
+        node_pattern_.add_neighbour(neighbours[i], send_index, recv_index);
+    }
+}
+
+// Reads the same information as read_mesh_data() from a memory mapped
+// .bpmesh file.  No parsing is required: the node and element data is
+// copied straight out of the mapped file.
+void Mesh::read_binary_mesh_data(const std::string& filename) {
+    BinaryMeshFile file(filename);
+    build_domain_mesh(file.header(), file.coordinates(), file.vtxdist(),
+                      file.external_nodes(), file.node_boundary_offsets(),
+                      file.node_boundaries(), file.element_offsets(),
+                      file.element_entries(), "binary mesh file " + filename);
+}
+
+// Builds the domain from the sections of a .bpmesh file (see binary_mesh.h),
+// whose offsets are known to lie within their sections.  source names where
+// the sections came from, for errors.
+void Mesh::build_domain_mesh(const BinaryMeshHeader& h, const double* x,
+                             const int* vtxdist, const int* external_nodes,
+                             const int* bc_offsets, const int* bcs,
+                             const int* offsets, const int* entries,
+                             const std::string& source) {
+    // domain and count info
+    n_dom = h.n_dom;
+    dom_id = h.dom_id;
+    vtx_dist.assign(vtxdist, vtxdist + n_dom + 1);
+    n_nodes_gbl_ = h.n_nodes_gbl;
+    n_nodes_int_ = h.n_nodes_int;
+    n_nodes_bnd_ = h.n_nodes_bnd;
+    n_nodes_ext_ = h.n_nodes_ext;
+    n_nodes_loc_ = n_nodes_int_ + n_nodes_bnd_;
+    n_elements_int = h.n_elements_int;
+    n_elements_bnd = h.n_elements_bnd;
+
+    // external nodes
+    nodes_ext.assign(external_nodes, external_nodes + n_nodes_ext_);
+    for (int i = 0; i < n_nodes_ext_; ++i)
+        if (nodes_ext[i] < 0 || nodes_ext[i] >= n_nodes_gbl_)
+            throw IOException("Invalid external node id in " + source);
+
+    // nodes
+    nodevec.reserve(h.nodes());
+    for (int id = 0; id < h.nodes(); ++id) {
+        std::vector<int> node_bcs(bcs + bc_offsets[id], bcs + bc_offsets[id+1]);
+        Point p(x[3*id], x[3*id+1], x[3*id+2]);
+        nodevec.push_back(Node(*this, id, node_bcs, p));
+    }
+
+    // elements
+    EntityTable edgetable(2*h.elements()), facetable(2*h.elements());
+    elementvec.reserve(h.elements());
+    mesh_dim_ = 3;
+    for (int element_id = 0; element_id < h.elements(); ++element_id) {
+        const int* entry = entries + offsets[element_id];
+        int length = offsets[element_id+1] - offsets[element_id];
+        if (length < 2)
+            throw IOException("Inconsistent element entries in " + source);
+        int type = entry[0];
+        int physical_tag = entry[1] - 100;
+        int n_nodes, n_faces;
+        element_shape(type, n_nodes, n_faces);
+        if (length != 2 + n_nodes + n_faces)
+            throw IOException("Inconsistent element entries in " + source);
+
+        std::vector<int> node_ids(entry + 2, entry + 2 + n_nodes);
+        for (int j = 0; j < n_nodes; ++j)
+            if (node_ids[j] < 0 || node_ids[j] >= h.nodes())
+                throw IOException("Invalid element node id in " + source);
+        std::vector<int> boundary_ids(entry + 2 + n_nodes,
+                                      entry + 2 + n_nodes + n_faces);
+        add_element(type, element_id, physical_tag, node_ids, boundary_ids,
+                    edgetable, facetable);
+    }
+    process_mesh_data();
+}
+
+namespace {
+
+// One domain's part of a global mesh, as the root domain sends it: the
+// sections of a .bpmesh file, and the index in the global mesh file of each
+// node the domain owns.
+struct DomainMeshData {
+    BinaryMeshHeader header;
+    std::vector<double> coordinates;
+    std::vector<int> vtxdist;
+    std::vector<int> external_nodes;
+    std::vector<int> node_boundary_offsets;
+    std::vector<int> node_boundaries;
+    std::vector<int> element_offsets;
+    std::vector<int> element_entries;
+    std::vector<int> source_ids;
+};
+
+const int domain_data_tag = 10;
+const int domain_coordinates_tag = 11;
+
+template<typename T>
+const T* data_or_null(const std::vector<T>& v) {
+    return v.empty() ? 0 : &v[0];
+}
+
+template<typename T>
+T* data_or_null(std::vector<T>& v) {
+    return v.empty() ? 0 : &v[0];
+}
+
+// Makes the data of domain d, as split writes it to a .pmesh file: the nodes
+// the domain owns, then the nodes of other domains that share an element with
+// them in order of global id, and the elements with only owned nodes, then
+// those with external nodes.
+// local: -1 for every node of the global mesh, and left that way
+void make_domain_data(const GlobalMesh& mesh, const std::vector<int>& part,
+                      const std::vector<int>& global_id, const std::vector<int>& vtxdist,
+                      IndexRange owned, IndexRange elements, int d,
+                      std::vector<int>& local, DomainMeshData& data) {
+    int n_loc = owned.size();
+    for (int k = 0; k < n_loc; ++k)
+        local[owned[k]] = k;
+
+    // element_kind is 1 for elements with only owned nodes, and 2 for
+    // elements with external nodes
+    std::vector<char> element_kind(elements.size(), 1);
+    std::vector<char> boundary_node(n_loc, 0);
+    std::vector<std::pair<int, int> > external; // (global id, file index)
+    for (int k = 0; k < elements.size(); ++k) {
+        IndexRange nodes = mesh.element_nodes(elements[k]);
+        for (int j = 0; j < nodes.size(); ++j)
+            if (part[nodes[j]] != d)
+                element_kind[k] = 2;
+        if (element_kind[k] == 1)
+            continue;
+        for (int j = 0; j < nodes.size(); ++j) {
+            if (part[nodes[j]] == d)
+                boundary_node[local[nodes[j]]] = 1;
+            else
+                external.push_back(std::make_pair(global_id[nodes[j]], nodes[j]));
+        }
+    }
+    std::sort(external.begin(), external.end());
+    external.erase(std::unique(external.begin(), external.end()), external.end());
+    int n_ext = external.size();
+    for (int k = 0; k < n_ext; ++k)
+        local[external[k].second] = n_loc + k;
+
+    BinaryMeshHeader& h = data.header;
+    h.n_dom = vtxdist.size() - 1;
+    h.dom_id = d;
+    h.n_nodes_gbl = mesh.nodes();
+    h.n_nodes_bnd = std::count(boundary_node.begin(), boundary_node.end(), 1);
+    h.n_nodes_int = n_loc - h.n_nodes_bnd;
+    h.n_nodes_ext = n_ext;
+    h.n_elements_bnd = std::count(element_kind.begin(), element_kind.end(), 2);
+    h.n_elements_int = elements.size() - h.n_elements_bnd;
+    data.vtxdist = vtxdist;
+
+    // owned nodes, then external nodes
+    data.coordinates.clear();
+    data.node_boundary_offsets.assign(1, 0);
+    data.node_boundaries.clear();
+    data.external_nodes.resize(n_ext);
+    for (int k = 0; k < n_loc + n_ext; ++k) {
+        int i = k < n_loc ? owned[k] : external[k - n_loc].second;
+        if (k >= n_loc)
+            data.external_nodes[k - n_loc] = external[k - n_loc].first;
+        const Point& p = mesh.point(i);
+        data.coordinates.push_back(p.x);
+        data.coordinates.push_back(p.y);
+        data.coordinates.push_back(p.z);
+        IndexRange bcs = mesh.node_boundaries(i);
+        data.node_boundaries.insert(data.node_boundaries.end(), bcs.begin(), bcs.end());
+        data.node_boundary_offsets.push_back(data.node_boundaries.size());
+    }
+    data.source_ids.assign(owned.begin(), owned.end());
+
+    // elements with only owned nodes, then elements with external nodes
+    data.element_offsets.assign(1, 0);
+    data.element_entries.clear();
+    for (int kind = 1; kind <= 2; ++kind) {
+        for (int k = 0; k < elements.size(); ++k) {
+            if (element_kind[k] != kind)
+                continue;
+            int e = elements[k];
+            data.element_entries.push_back(mesh.element_type(e));
+            data.element_entries.push_back(mesh.element_tag(e));
+            IndexRange nodes = mesh.element_nodes(e);
+            for (int j = 0; j < nodes.size(); ++j)
+                data.element_entries.push_back(local[nodes[j]]);
+            IndexRange bcs = mesh.element_boundaries(e);
+            data.element_entries.insert(data.element_entries.end(), bcs.begin(), bcs.end());
+            data.element_offsets.push_back(data.element_entries.size());
+        }
+    }
+    h.n_node_boundaries = data.node_boundaries.size();
+    h.n_element_entries = data.element_entries.size();
+
+    for (int k = 0; k < n_loc; ++k)
+        local[owned[k]] = -1;
+    for (int k = 0; k < n_ext; ++k)
+        local[external[k].second] = -1;
+}
+
+// The counts of the header and the integer sections are sent in one message,
+// and the coordinates in another.
+void send_domain_data(const DomainMeshData& data, int dest, MPI_Comm comm) {
+    const BinaryMeshHeader& h = data.header;
+    int counts[] = {h.n_dom, h.dom_id, h.n_nodes_gbl, h.n_nodes_int, h.n_nodes_bnd,
+                    h.n_nodes_ext, h.n_elements_int, h.n_elements_bnd,
+                    h.n_node_boundaries, h.n_element_entries};
+    std::vector<int> ints(counts, counts + 10);
+    const std::vector<int>* sections[] = {
+        &data.vtxdist, &data.external_nodes, &data.node_boundary_offsets,
+        &data.node_boundaries, &data.element_offsets, &data.element_entries,
+        &data.source_ids
+    };
+    for (int i = 0; i < 7; ++i)
+        ints.insert(ints.end(), sections[i]->begin(), sections[i]->end());
+    MPI_Send(const_cast<int*>(&ints[0]), ints.size(), MPI_INT, dest,
+             domain_data_tag, comm);
+    MPI_Send(const_cast<double*>(data_or_null(data.coordinates)), data.coordinates.size(),
+             MPI_DOUBLE, dest, domain_coordinates_tag, comm);
+}
+
+void recv_domain_data(DomainMeshData& data, int source, MPI_Comm comm) {
+    MPI_Status status;
+    int n = 0;
+    MPI_Probe(source, domain_data_tag, comm, &status);
+    MPI_Get_count(&status, MPI_INT, &n);
+    std::vector<int> ints(n);
+    MPI_Recv(&ints[0], n, MPI_INT, source, domain_data_tag, comm, MPI_STATUS_IGNORE);
+
+    BinaryMeshHeader& h = data.header;
+    h.n_dom = ints[0];
+    h.dom_id = ints[1];
+    h.n_nodes_gbl = ints[2];
+    h.n_nodes_int = ints[3];
+    h.n_nodes_bnd = ints[4];
+    h.n_nodes_ext = ints[5];
+    h.n_elements_int = ints[6];
+    h.n_elements_bnd = ints[7];
+    h.n_node_boundaries = ints[8];
+    h.n_element_entries = ints[9];
+    int sizes[] = {h.n_dom + 1, h.n_nodes_ext, h.nodes() + 1, h.n_node_boundaries,
+                   h.elements() + 1, h.n_element_entries, h.n_nodes_int + h.n_nodes_bnd};
+    std::vector<int>* sections[] = {
+        &data.vtxdist, &data.external_nodes, &data.node_boundary_offsets,
+        &data.node_boundaries, &data.element_offsets, &data.element_entries,
+        &data.source_ids
+    };
+    std::vector<int>::const_iterator next = ints.begin() + 10;
+    for (int i = 0; i < 7; ++i) {
+        sections[i]->assign(next, next + sizes[i]);
+        next += sizes[i];
+    }
+    assert(next == ints.end());
+
+    data.coordinates.resize(3*h.nodes());
+    MPI_Recv(data_or_null(data.coordinates), data.coordinates.size(), MPI_DOUBLE, source,
+             domain_coordinates_tag, comm, MPI_STATUS_IGNORE);
+}
+
+} // end anonymous namespace
+
+// The root domain reads the whole mesh, the domains partition it, then the
+// root domain sends each domain its own nodes, halo and elements, so that
+// only the root domain ever holds the whole mesh.  weights are balanced
+// between the domains if given, otherwise the weights in the file weightname
+// if there is one.
+void Mesh::read_global_mesh_data(const std::string& filename,
+                                 const std::string& weightname,
+                                 const std::vector<double>& node_weights) {
+    boost::shared_ptr<GlobalMesh> mesh;
+    std::vector<double> weights;
+    boost::shared_ptr<IOException> error;
+    if (mpicomm_->rank() == 0) {
+        try {
+            mesh.reset(new GlobalMesh(filename));
+            weights = node_weights;
+            if (!weights.empty() && int(weights.size()) != mesh->nodes())
+                throw IOException("Mesh: there must be a weight for each node of " + filename);
+            if (weights.empty() && file_exists(weightname)) {
+                *mpicomm_ << "Mesh: balancing the node weights in " << weightname << std::endl;
+                read_node_weights(weightname, mesh->nodes(), weights);
+            }
+        } catch (const IOException& e) {
+            error.reset(new IOException(e));
+        } catch (const std::exception& e) {
+            error.reset(new IOException("Mesh: couldn't read " + filename + " : " + e.what()));
+        }
+    }
+    // the other domains would wait forever for a mesh that could not be read
+    int ok = !error;
+    MPI_Bcast(&ok, 1, MPI_INT, 0, mpicomm_->communicator());
+    if (error)
+        throw *error;
+    if (!ok)
+        throw IOException("Mesh: the root domain couldn't read " + filename);
+
+    std::vector<int> part;
+    partition_nodes(mesh.get(), weights, part);
+    distribute_mesh_data(mesh.get(), part);
+}
+
+// The .pmesh files number the nodes in the order that split gives them, and
+// split saves the global mesh index of each in meshname_p_<n>.txt, where
+// line k holds the index of the node with global id k.  If the file has not
+// been kept the global ids are used.
+void Mesh::read_node_source_ids(const std::string& meshname) {
+    node_source_id_.resize(local_nodes());
+    for (int i = 0; i < local_nodes(); ++i)
+        node_source_id_[i] = vtx_dist[dom_id] + node_file_index_[i];
+
+    std::string filename = meshname + "_p_" + to_string(mpicomm_->size()) + ".txt";
+    std::ifstream in(filename.c_str());
+    if (!in)
+        return;
+    std::vector<int> p(global_nodes());
+    for (int k = 0; k < global_nodes(); ++k)
+        in >> p[k];
+    if (!in)
+        throw IOException("Couldn't read node permutation from file: " + filename);
+    for (int i = 0; i < local_nodes(); ++i)
+        node_source_id_[i] = p[node_source_id_[i]];
+}
+
+void Mesh::global_node_weights(const std::vector<double>& weights,
+                               std::vector<double>& global) const {
+    if (int(weights.size()) < local_nodes())
+        throw IOException("Mesh: there must be a weight for each local node");
+
+    // gather the weights of every domain, with their source ids
+    int n = local_nodes();
+    int size = mpicomm_->size();
+    MPI_Comm comm = mpicomm_->communicator();
+    std::vector<int> counts(size), displs(size+1, 0);
+    MPI_Allgather(&n, 1, MPI_INT, &counts[0], 1, MPI_INT, comm);
+    for (int d = 0; d < size; ++d)
+        displs[d+1] = displs[d] + counts[d];
+    std::vector<int> ids(std::max(displs[size], 1));
+    std::vector<double> all(std::max(displs[size], 1));
+    std::vector<int> source_id(node_source_id_.begin(), node_source_id_.end());
+    std::vector<double> local(weights.begin(), weights.begin() + n);
+    MPI_Allgatherv(source_id.empty() ? 0 : &source_id[0], n, MPI_INT,
+                   &ids[0], &counts[0], &displs[0], MPI_INT, comm);
+    MPI_Allgatherv(local.empty() ? 0 : &local[0], n, MPI_DOUBLE,
+                   &all[0], &counts[0], &displs[0], MPI_DOUBLE, comm);
+
+    global.assign(global_nodes(), 0.);
+    for (int k = 0; k < displs[size]; ++k)
+        if (ids[k] >= 0 && ids[k] < global_nodes())
+            global[ids[k]] = all[k];
+}
+
+void Mesh::save_node_weights(const std::string& filename,
+                             const std::vector<double>& weights) const {
+    std::vector<double> global;
+    global_node_weights(weights, global);
+
+    int ok = 1;
+    if (mpicomm_->rank() == 0) {
+        try {
+            write_node_weights(filename, global);
+            *mpicomm_ << "Mesh: saved node weights to " << filename << std::endl;
+        } catch (const IOException&) {
+            ok = 0;
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, mpicomm_->communicator());
+    if (!ok)
+        throw IOException("Couldn't write file: " + filename);
+}
+
+// The values are sent straight from the domain that owns each node in from to
+// the domain that owns it here, which every domain can look up from the
+// source ids of the nodes of this mesh.
+void Mesh::import_node_values(const Mesh& from, const std::vector<double>& values,
+                              int per_node, std::vector<double>& out) const {
+    int size = mpicomm_->size();
+    if (from.mpicomm()->size() != size || from.global_nodes() != global_nodes())
+        throw IOException("Mesh::import_node_values: the meshes must be partitions of the same mesh");
+    if (int(values.size()) < from.local_nodes()*per_node)
+        throw IOException("Mesh::import_node_values: there must be values for each local node");
+    MPI_Comm comm = mpicomm_->communicator();
+
+    // the domain that owns each node here
+    int n = local_nodes();
+    std::vector<int> counts(size), displs(size+1, 0);
+    MPI_Allgather(&n, 1, MPI_INT, &counts[0], 1, MPI_INT, comm);
+    for (int d = 0; d < size; ++d)
+        displs[d+1] = displs[d] + counts[d];
+    std::vector<int> ids(std::max(displs[size], 1));
+    std::vector<int> source_id(node_source_id_.begin(), node_source_id_.end());
+    MPI_Allgatherv(source_id.empty() ? 0 : &source_id[0], n, MPI_INT,
+                   &ids[0], &counts[0], &displs[0], MPI_INT, comm);
+    std::vector<int> owner(global_nodes(), -1);
+    for (int d = 0; d < size; ++d)
+        for (int k = displs[d]; k < displs[d+1]; ++k)
+            owner[ids[k]] = d;
+
+    // pack the source id and values of each local node of from, by owner
+    std::vector<int> send_counts(size, 0), send_displs(size+1, 0);
+    for (int i = 0; i < from.local_nodes(); ++i) {
+        int d = owner[from.node_source_id(i)];
+        if (d < 0)
+            throw IOException("Mesh::import_node_values: a node has no owner");
+        ++send_counts[d];
+    }
+    for (int d = 0; d < size; ++d)
+        send_displs[d+1] = send_displs[d] + send_counts[d];
+    std::vector<int> send_ids(std::max(send_displs[size], 1));
+    std::vector<double> send_values(std::max(send_displs[size]*per_node, 1));
+    std::vector<int> next(send_displs.begin(), send_displs.end()-1);
+    for (int i = 0; i < from.local_nodes(); ++i) {
+        int k = next[owner[from.node_source_id(i)]]++;
+        send_ids[k] = from.node_source_id(i);
+        std::copy(values.begin() + i*per_node, values.begin() + (i+1)*per_node,
+                  send_values.begin() + k*per_node);
+    }
+
+    std::vector<int> recv_counts(size), recv_displs(size+1, 0);
+    MPI_Alltoall(&send_counts[0], 1, MPI_INT, &recv_counts[0], 1, MPI_INT, comm);
+    for (int d = 0; d < size; ++d)
+        recv_displs[d+1] = recv_displs[d] + recv_counts[d];
+    if (recv_displs[size] != n)
+        throw IOException("Mesh::import_node_values: received the wrong number of nodes");
+    std::vector<int> recv_ids(std::max(n, 1));
+    std::vector<double> recv_values(std::max(n*per_node, 1));
+    MPI_Alltoallv(&send_ids[0], &send_counts[0], &send_displs[0], MPI_INT,
+                  &recv_ids[0], &recv_counts[0], &recv_displs[0], MPI_INT, comm);
+    for (int d = 0; d < size; ++d) {
+        send_counts[d] *= per_node;
+        send_displs[d] *= per_node;
+        recv_counts[d] *= per_node;
+        recv_displs[d] *= per_node;
+    }
+    MPI_Alltoallv(&send_values[0], &send_counts[0], &send_displs[0], MPI_DOUBLE,
+                  &recv_values[0], &recv_counts[0], &recv_displs[0], MPI_DOUBLE, comm);
+
+    // unpack into the local node order
+    std::vector<int> local(global_nodes(), -1);
+    for (int i = 0; i < n; ++i)
+        local[node_source_id_[i]] = i;
+    out.assign(n*per_node, 0.);
+    for (int k = 0; k < n; ++k)
+        std::copy(recv_values.begin() + k*per_node, recv_values.begin() + (k+1)*per_node,
+                  out.begin() + local[recv_ids[k]]*per_node);
+}
+
+#ifdef MESH_PARMETIS
+// the integer and real types of the ParMETIS interface changed in version 4
+#if PARMETIS_MAJOR_VERSION >= 4
+typedef idx_t parmetis_idx;
+typedef real_t parmetis_real;
+#else
+typedef idxtype parmetis_idx;
+typedef float parmetis_real;
+#endif
+#endif
+
+// Finds the domain that owns each node of a global mesh, which only the root
+// domain holds (mesh is null on the others).  With ParMETIS (compiled with
+// -DMESH_PARMETIS) the node graph is partitioned in parallel to minimise the
+// edge cut, as decomp does: the root domain sends each domain the adjacency
+// of a contiguous slice of the nodes, and gathers the partition of the
+// slices.  Otherwise the root domain partitions the nodes by recursive
+// inertial bisection (see partition.h), which gives compact, though not
+// minimal, domain boundaries.  If there are weights, one for each node, the
+// domains are given equal total weight rather than equal numbers of nodes.
+// part is only filled on the root domain.
+void Mesh::partition_nodes(const GlobalMesh* mesh, const std::vector<double>& weights,
+                           std::vector<int>& part) {
+    int rank = mpicomm_->rank();
+    int size = mpicomm_->size();
+    int n = mesh ? mesh->nodes() : 0;
+    MPI_Comm comm = mpicomm_->communicator();
+    MPI_Bcast(&n, 1, MPI_INT, 0, comm);
+    part.assign(rank == 0 ? n : 0, 0);
+    if (size == 1)
+        return;
+
+#ifdef MESH_PARMETIS
+    if (n >= size) {
+        std::vector<parmetis_idx> vtxdist(size+1);
+        for (int d = 0; d <= size; ++d)
+            vtxdist[d] = parmetis_idx((long long)d * n / size);
+        int lo = vtxdist[rank], hi = vtxdist[rank+1];
+
+        // The slice of each domain is sent as its xadj, relative to the
+        // start of its adjncy, then adjncy, then the node weights, which
+        // ParMETIS takes as integers, so they are scaled to a mean of 100.
+        std::vector<int> slice_data;
+        int weighted = !weights.empty();
+        MPI_Bcast(&weighted, 1, MPI_INT, 0, comm);
+        if (rank == 0) {
+            Connectivity graph;
+            node_graph(*mesh, graph);
+            double scale = 0.;
+            if (weighted) {
+                double total = 0.;
+                for (int i = 0; i < n; ++i)
+                    total += weights[i];
+                scale = total > 0. ? 100. * n / total : 0.;
+            }
+            for (int d = size-1; d >= 0; --d) {
+                int first = vtxdist[d], last = vtxdist[d+1];
+                slice_data.clear();
+                for (int i = first; i <= last; ++i)
+                    slice_data.push_back(graph.offset(i) - graph.offset(first));
+                slice_data.insert(slice_data.end(), graph.row(first).begin(),
+                                  graph.row(first).begin() + slice_data.back());
+                if (weighted)
+                    for (int i = first; i < last; ++i)
+                        slice_data.push_back(std::max(1, int(weights[i] * scale + 0.5)));
+                if (d > 0)
+                    MPI_Send(&slice_data[0], slice_data.size(), MPI_INT, d,
+                             domain_data_tag, comm);
+            }
+        } else {
+            MPI_Status status;
+            int count = 0;
+            MPI_Probe(0, domain_data_tag, comm, &status);
+            MPI_Get_count(&status, MPI_INT, &count);
+            slice_data.resize(count);
+            MPI_Recv(&slice_data[0], count, MPI_INT, 0, domain_data_tag, comm,
+                     MPI_STATUS_IGNORE);
+        }
+        int edges = slice_data[hi - lo];
+        std::vector<parmetis_idx> xadj(slice_data.begin(), slice_data.begin() + (hi - lo + 1));
+        std::vector<parmetis_idx> adjncy(slice_data.begin() + (hi - lo + 1),
+                                         slice_data.begin() + (hi - lo + 1 + edges));
+        std::vector<parmetis_idx> vwgt;
+        if (weighted) {
+            vwgt.assign(slice_data.begin() + (hi - lo + 1 + edges), slice_data.end());
+            vwgt.resize(std::max(hi - lo, 1));
+        }
+        slice_data.clear();
+
+        parmetis_idx wgtflag = weighted ? 2 : 0;
+        parmetis_idx numflag = 0, ncon = 1, nparts = size, edgecut = 0;
+        parmetis_idx options[3] = {0, 0, 0};
+        std::vector<parmetis_real> tpwgts(size, parmetis_real(1) / size);
+        parmetis_real ubvec = parmetis_real(1.05);
+        std::vector<parmetis_idx> slice(std::max(hi - lo, 1));
+        ParMETIS_V3_PartKway(&vtxdist[0], &xadj[0], adjncy.empty() ? 0 : &adjncy[0],
+                             vwgt.empty() ? 0 : &vwgt[0], 0, &wgtflag, &numflag, &ncon, &nparts,
+                             &tpwgts[0], &ubvec, options, &edgecut, &slice[0], &comm);
+
+        std::vector<int> mine(slice.begin(), slice.begin() + (hi - lo));
+        std::vector<int> counts(size), displs(size);
+        for (int d = 0; d < size; ++d) {
+            displs[d] = vtxdist[d];
+            counts[d] = vtxdist[d+1] - vtxdist[d];
+        }
+        MPI_Gatherv(mine.empty() ? 0 : &mine[0], hi - lo, MPI_INT,
+                    rank == 0 ? &part[0] : 0, &counts[0], &displs[0], MPI_INT, 0, comm);
+        *mpicomm_ << "Mesh: partitioned " << n << " nodes with ParMETIS, edge cut "
+                  << edgecut << std::endl;
+        return;
+    }
+#endif
+
+    if (rank == 0) {
+        std::vector<Point> points(n);
+        for (int i = 0; i < n; ++i)
+            points[i] = mesh->point(i);
+        rcb_partition(points, mesh->dim(), weights, size, true, part);
+    }
+    *mpicomm_ << "Mesh: partitioned " << n << " nodes by inertial bisection" << std::endl;
+}
+
+// Takes this domain's part of a global mesh, which only the root domain holds
+// (mesh is null on the others), where part[i] is the domain that owns node i.
+// The root domain sends each domain the data that split would write to its
+// .pmesh file (see make_domain_data), and the index in the mesh file of each
+// node it owns, so every domain other than the root only ever holds its own
+// nodes, halo and elements.
+void Mesh::distribute_mesh_data(const GlobalMesh* mesh, const std::vector<int>& part) {
+    int rank = mpicomm_->rank();
+    int size = mpicomm_->size();
+    MPI_Comm comm = mpicomm_->communicator();
+
+    DomainMeshData data;
+    if (rank == 0) {
+        std::vector<int> vtxdist, global_id;
+        domain_numbering(part, size, vtxdist, global_id);
+        Connectivity owned, elements;
+        domain_entities(*mesh, part, size, owned, elements);
+        std::vector<int> local(mesh->nodes(), -1);
+        // the root domain's own data is made last, so that it is what is left
+        for (int d = size-1; d >= 0; --d) {
+            make_domain_data(*mesh, part, global_id, vtxdist, owned.row(d),
+                             elements.row(d), d, local, data);
+            if (d > 0)
+                send_domain_data(data, d, comm);
+        }
+    } else {
+        recv_domain_data(data, 0, comm);
+    }
+
+    node_source_id_ = data.source_ids;
+    build_domain_mesh(data.header, data_or_null(data.coordinates), &data.vtxdist[0],
+                      data_or_null(data.external_nodes), &data.node_boundary_offsets[0],
+                      data_or_null(data.node_boundaries), &data.element_offsets[0],
+                      data_or_null(data.element_entries), "the mesh sent by the root domain");
+}
+
+// Takes domain d of a partition held in memory, as distribute_mesh_data
+// takes the domain of a process from the data sent by the root domain.
+void Mesh::make_thread_domain(const ThreadPartition& partition, int d) {
+    const GlobalMesh& mesh = partition.mesh();
+    DomainMeshData data;
+    std::vector<int> local(mesh.nodes(), -1);
+    make_domain_data(mesh, partition.part(), partition.global_ids(), partition.vtxdist(),
+                     partition.owned_nodes(d), partition.domain_elements(d), d,
+                     local, data);
+
+    node_source_id_ = data.source_ids;
+    build_domain_mesh(data.header, data_or_null(data.coordinates), &data.vtxdist[0],
+                      data_or_null(data.external_nodes), &data.node_boundary_offsets[0],
+                      data_or_null(data.node_boundaries), &data.element_offsets[0],
+                      data_or_null(data.element_entries),
+                      "domain " + to_string(d) + " of a thread partition");
+}
+
+/*******************************************
+ * Box mesh generation
+ *
+ * The nodes of the box form a lattice, which
+ * is divided into px*py*pz blocks, one for
+ * each domain.  Each domain owns the nodes in
+ * its block, numbered lexicographically, and
+ * holds every element that has one of its
+ * nodes, so that the domain data is the same
+ * as would be read from a .pmesh file.
+ *******************************************/
+namespace {
+
+// split the domains into a grid of blocks over the node lattice, choosing
+// the factorisation with the smallest area of cuts between blocks
+void box_blocks(int domains, const int nodes[3], int blocks[3]) {
+    double best = -1.;
+    for (int px = 1; px <= domains; ++px) {
+        if (domains % px) continue;
+        for (int py = 1; py <= domains/px; ++py) {
+            if ((domains/px) % py) continue;
+            int pz = domains/(px*py);
+            int p[3] = {px, py, pz};
+            bool fits = true;
+            double cut = 0.;
+            for (int a = 0; a < 3; ++a) {
+                if (p[a] > nodes[a])
+                    fits = false;
+                cut += double(p[a]-1) * nodes[(a+1)%3] * nodes[(a+2)%3];
+            }
+            if (fits && (best < 0. || cut < best)) {
+                best = cut;
+                std::copy(p, p+3, blocks);
+            }
+        }
+    }
+    if (best < 0.)
+        throw IOException("BoxMesh: too many domains for the number of cells");
+}
+
+// lattice node ranges and global numbering of a block partition
+class BoxPartition {
+public:
+    BoxPartition(const BoxMesh& box, int domains, int domain_id) {
+        for (int a = 0; a < 3; ++a)
+            nodes_[a] = box.cells(a) + (box.dim() == 3 || a < 2 ? 1 : 0);
+        box_blocks(domains, nodes_, blocks_);
+
+        // first lattice node of each block along each axis
+        for (int a = 0; a < 3; ++a) {
+            start_[a].resize(blocks_[a]+1);
+            for (int b = 0; b <= blocks_[a]; ++b)
+                start_[a][b] = int((long long)b * nodes_[a] / blocks_[a]);
+        }
+
+        // vertex distribution, the nodes of each block are contiguous
+        vtxdist_.assign(domains+1, 0);
+        for (int d = 0; d < domains; ++d) {
+            int b[3];
+            block_of_domain(d, b);
+            long long n = 1;
+            for (int a = 0; a < 3; ++a)
+                n *= start_[a][b[a]+1] - start_[a][b[a]];
+            if (vtxdist_[d] + n > 2147483647LL)
+                throw IOException("BoxMesh: too many nodes for 32 bit node ids");
+            vtxdist_[d+1] = int(vtxdist_[d] + n);
+        }
+
+        int b[3];
+        block_of_domain(domain_id, b);
+        for (int a = 0; a < 3; ++a) {
+            lo_[a] = start_[a][b[a]];
+            hi_[a] = start_[a][b[a]+1];
+        }
+    }
+
+    const std::vector<int>& vtxdist() const { return vtxdist_; }
+
+    // first and one past the last lattice node owned along axis a
+    int lo(int a) const { return lo_[a]; }
+    int hi(int a) const { return hi_[a]; }
+
+    int local_nodes() const {
+        return (hi_[0]-lo_[0]) * (hi_[1]-lo_[1]) * (hi_[2]-lo_[2]);
+    }
+
+    bool is_local(const int* ijk) const {
+        for (int a = 0; a < 3; ++a)
+            if (ijk[a] < lo_[a] || ijk[a] >= hi_[a])
+                return false;
+        return true;
+    }
+
+    // global id of the lattice node ijk
+    int global_id(const int* ijk) const {
+        int b[3], lo[3], width[3];
+        for (int a = 0; a < 3; ++a) {
+            b[a] = std::upper_bound(start_[a].begin(), start_[a].end(), ijk[a])
+                 - start_[a].begin() - 1;
+            lo[a] = start_[a][b[a]];
+            width[a] = start_[a][b[a]+1] - lo[a];
+        }
+        int d = b[0] + blocks_[0]*(b[1] + blocks_[1]*b[2]);
+        return vtxdist_[d] + (ijk[0]-lo[0])
+             + width[0]*((ijk[1]-lo[1]) + width[1]*(ijk[2]-lo[2]));
+    }
+private:
+    void block_of_domain(int d, int* b) const {
+        b[0] = d % blocks_[0];
+        b[1] = (d / blocks_[0]) % blocks_[1];
+        b[2] = d / (blocks_[0]*blocks_[1]);
+    }
+
+    int nodes_[3], blocks_[3];
+    std::vector<int> start_[3];
+    std::vector<int> vtxdist_;
+    int lo_[3], hi_[3];
+};
+
+// corners of a cell, as offsets along each axis: the bottom face (0-1-2-3)
+// counter clockwise, then the top face (4-5-6-7) above it
+const int box_corner[8][3] = {
+    {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}
+};
+
+// the elements that a cell is split into, as cell corners
+const int box_triangles[2][3] = { {0,1,2}, {0,2,3} };
+const int box_quadrilaterals[1][4] = { {0,1,2,3} };
+const int box_tetrahedra[6][4] = {
+    {0,1,2,6}, {0,2,3,6}, {0,3,7,6}, {0,7,4,6}, {0,4,5,6}, {0,5,1,6}
+};
+const int box_hexahedra[1][8] = { {0,1,2,3,4,5,6,7} };
+const int box_prisms[2][6] = { {0,1,2,4,5,6}, {0,2,3,4,6,7} };
+
+// a lattice node that is referenced by, but not local to, a domain
+struct BoxNode {
+    int id;
+    int ijk[3];
+    bool operator<(const BoxNode& other) const { return id < other.id; }
+    bool operator==(const BoxNode& other) const { return id == other.id; }
+};
+
+// coordinate of lattice node i along axis a
+double box_coordinate(const BoxMesh& box, int a, int i) {
+    double lower[3] = {box.lower().x, box.lower().y, box.lower().z};
+    double upper[3] = {box.upper().x, box.upper().y, box.upper().z};
+    return lower[a] + (upper[a] - lower[a]) * i / box.cells(a);
+}
+
+// the node at lattice position ijk, tagged with the sides of the box
+// that it lies on
+Node box_node(const Mesh& m, const BoxMesh& box, int id, const int* ijk) {
+    std::vector<int> bcs;
+    double x[3] = {0., 0., 0.};
+    for (int a = 0; a < box.dim(); ++a) {
+        if (ijk[a] == 0)
+            bcs.push_back(2*a+1);
+        if (ijk[a] == box.cells(a))
+            bcs.push_back(2*a+2);
+        x[a] = box_coordinate(box, a, ijk[a]);
+    }
+    return Node(m, id, bcs, Point(x[0], x[1], x[2]));
+}
+
+// the cell corners of element k of a cell
+const int* box_element_corners(int type, int k) {
+    switch (type) {
+        case 2: return box_triangles[k];
+        case 3: return box_quadrilaterals[k];
+        case 4: return box_tetrahedra[k];
+        case 5: return box_hexahedra[k];
+        default: return box_prisms[k];
+    }
+}
+
+} // end anonymous namespace
+
+void Mesh::generate_box_mesh(const BoxMesh& box) {
+    n_dom = mpicomm_->size();
+    dom_id = mpicomm_->rank();
+    mesh_dim_ = box.dim();
+    BoxPartition part(box, n_dom, dom_id);
+    vtx_dist = part.vtxdist();
+    n_nodes_gbl_ = vtx_dist.back();
+    n_nodes_loc_ = part.local_nodes();
+
+    int type = box.type();
+    int n_nodes, n_faces;
+    element_shape(type, n_nodes, n_faces);
+    int dim = box.dim();
+
+    // the cells that have a local node as a corner
+    int cell_lo[3], cell_hi[3];
+    for (int a = 0; a < 3; ++a) {
+        cell_lo[a] = std::max(part.lo(a)-1, 0);
+        cell_hi[a] = std::min(part.hi(a), box.cells(a));
+    }
+
+    /*******************************************
+     * The elements are visited three times:
+     * to find the external nodes, then to add
+     * the elements that only have local nodes,
+     * then the elements with external nodes.
+     *******************************************/
+    std::vector<BoxNode> external;
+    std::vector<int> external_ids;
+    std::vector<char> boundary_node(n_nodes_loc_, 0);
+    n_elements_int = n_elements_bnd = 0;
+    int n_elements = 0;
+    int element_id = 0;
+    EntityTable edgetable, facetable;
+    for (int pass = 0; pass < 3; ++pass) {
+        if (pass == 1) {
+            // external nodes, in global id order
+            std::sort(external.begin(), external.end());
+            external.erase(std::unique(external.begin(), external.end()), external.end());
+            n_nodes_ext_ = external.size();
+            nodes_ext.resize(n_nodes_ext_);
+            for (int k = 0; k < n_nodes_ext_; ++k)
+                nodes_ext[k] = external[k].id;
+            external_ids = nodes_ext;
+            n_nodes_bnd_ = std::count(boundary_node.begin(), boundary_node.end(), 1);
+            n_nodes_int_ = n_nodes_loc_ - n_nodes_bnd_;
+
+            // local nodes, in lattice order, then the external nodes
+            nodevec.reserve(nodes());
+            node_source_id_.reserve(n_nodes_loc_);
+            int nx = box.cells(0) + 1, ny = box.cells(1) + 1;
+            int ijk[3];
+            for (ijk[2] = part.lo(2); ijk[2] < part.hi(2); ++ijk[2])
+                for (ijk[1] = part.lo(1); ijk[1] < part.hi(1); ++ijk[1])
+                    for (ijk[0] = part.lo(0); ijk[0] < part.hi(0); ++ijk[0]) {
+                        nodevec.push_back(box_node(*this, box, nodevec.size(), ijk));
+                        node_source_id_.push_back(ijk[0] + nx*(ijk[1] + ny*ijk[2]));
+                    }
+            for (int k = 0; k < n_nodes_ext_; ++k)
+                nodevec.push_back(box_node(*this, box, nodevec.size(), external[k].ijk));
+            std::vector<BoxNode>().swap(external);
+
+            edgetable = EntityTable(2*n_elements);
+            facetable = EntityTable(2*n_elements);
+            elementvec.reserve(n_elements);
+        }
+
+        int cell[3];
+        for (cell[2] = cell_lo[2]; cell[2] < cell_hi[2]; ++cell[2])
+        for (cell[1] = cell_lo[1]; cell[1] < cell_hi[1]; ++cell[1])
+        for (cell[0] = cell_lo[0]; cell[0] < cell_hi[0]; ++cell[0])
+        for (int e = 0; e < box.elements_per_cell(); ++e) {
+            // lattice coordinates of the element nodes
+            const int* corners = box_element_corners(type, e);
+            int ijk[8][3];
+            int n_local = 0;
+            for (int j = 0; j < n_nodes; ++j) {
+                for (int a = 0; a < 3; ++a)
+                    ijk[j][a] = cell[a] + box_corner[corners[j]][a];
+                if (part.is_local(ijk[j]))
+                    ++n_local;
+            }
+            if (n_local == 0)
+                continue;
+            bool has_external = n_local < n_nodes;
+
+            if (pass == 0) {
+                ++n_elements;
+                if (!has_external) {
+                    ++n_elements_int;
+                    continue;
+                }
+                ++n_elements_bnd;
+                for (int j = 0; j < n_nodes; ++j) {
+                    int id = part.global_id(ijk[j]);
+                    if (part.is_local(ijk[j])) {
+                        boundary_node[id - vtx_dist[dom_id]] = 1;
+                    } else {
+                        BoxNode node;
+                        node.id = id;
+                        std::copy(ijk[j], ijk[j]+3, node.ijk);
+                        external.push_back(node);
+                    }
+                }
+                continue;
+            }
+            if (has_external != (pass == 2))
+                continue;
+
+            // node ids, local nodes first then external nodes
+            std::vector<int> node_ids(n_nodes);
+            double height = 0.;
+            for (int j = 0; j < n_nodes; ++j) {
+                int id = part.global_id(ijk[j]);
+                if (part.is_local(ijk[j]))
+                    node_ids[j] = id - vtx_dist[dom_id];
+                else
+                    node_ids[j] = n_nodes_loc_ + (std::lower_bound(
+                        external_ids.begin(), external_ids.end(), id) - external_ids.begin());
+                height += box_coordinate(box, dim-1, ijk[j][dim-1]);
+            }
+            height /= n_nodes;
+
+            // faces that lie on a side of the box are boundary faces
+            std::vector<int> boundary_ids(n_faces, 0);
+            for (int f = 0; f < n_faces; ++f) {
+                const int* face = element_face_nodes[type][f];
+                for (int a = 0; a < dim; ++a) {
+                    bool lower = true, upper = true;
+                    for (int j = 0; j < element_face_size(type, f); ++j) {
+                        lower = lower && ijk[face[j]][a] == 0;
+                        upper = upper && ijk[face[j]][a] == box.cells(a);
+                    }
+                    if (lower) boundary_ids[f] = 2*a+1;
+                    if (upper) boundary_ids[f] = 2*a+2;
+                }
+            }
+
+            add_element(type, element_id++, box.physical_tag(height),
+                        node_ids, boundary_ids, edgetable, facetable);
+        }
+    }
+    process_mesh_data();
+}
+
+// Completes the mesh once the nodes and elements have been read, whatever
+// format they were read from.
+void Mesh::process_mesh_data() {
+    reorder_nodes_edges();
     set_element_neighbours();
     face_edge_sanity_check();
-    element_cvface_sanity_check();
     boundary_tag_sanity_check();
 }
 
-void Mesh::reorder_nodes_edges(std::set<Edge> &edgeset, std::set<Face> &faceset){
+void Mesh::reorder_nodes_edges(){
     /*******************************************
-     * Find a node reordering that minimises
-     * bandwidth
+     * Find the node reordering: p[i] is the
+     * node that becomes node i.  Only the local
+     * nodes are reordered, the external nodes
+     * stay in the order of nodes_ext
      *******************************************/
-    // generate the edgeset pairs
-    int Nedges = edgeset.size();
-    std::vector<std::pair<int, int> > edges;
-
-    for(std::set<Edge>::const_iterator it = edgeset.begin(); it != edgeset.end(); ++it)
-        edges.push_back(std::make_pair((*it).front().id(), (*it).back().id()));
+    std::vector<int> p(nodes());
     for(int i=0; i<nodes(); i++)
-        edges.push_back(std::make_pair(i, i));
+        p[i] = i;
+
+    if( ordering_==ordering_rcm ){
+        // generate the edge pairs, ordered by their node ids
+        std::vector<std::pair<std::pair<int, int>, int> > edgekeys(edgevec.size());
+        for(int i=0; i<edgevec.size(); i++){
+            int a = edgevec[i].front_id;
+            int b = edgevec[i].back_id;
+            edgekeys[i] = std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), i);
+        }
+        std::sort(edgekeys.begin(), edgekeys.end());
 
-    // allocate memory for the permutation vector
-    std::vector<int> p(nodes());
+        std::vector<std::pair<int, int> > edges;
+        edges.reserve(edgevec.size() + nodes());
+        for(int i=0; i<edgekeys.size(); i++){
+            const Edge& e = edgevec[edgekeys[i].second];
+            edges.push_back(std::make_pair(e.front_id, e.back_id));
+        }
+        for(int i=0; i<nodes(); i++)
+            edges.push_back(std::make_pair(i, i));
+
+        // find the RCM ordering of the whole graph, then take the local
+        // nodes in that order
+        std::vector<int> rcm(nodes());
+        find_RCM_from_edges( edges, rcm );
+        int next = 0;
+        for(int i=0; i<nodes(); i++)
+            if( rcm[i]<local_nodes() )
+                p[next++] = rcm[i];
+    }
+    else if( ordering_==ordering_hilbert || ordering_==ordering_morton ){
+        // order the local nodes along a curve through their coordinates
+        std::vector<Point> points(local_nodes());
+        for(int i=0; i<local_nodes(); i++)
+            points[i] = nodevec[i].point();
+        std::vector<int> sfc(local_nodes());
+        find_SFC_from_points( points, dim(), ordering_==ordering_hilbert, sfc );
+        std::copy(sfc.begin(), sfc.end(), p.begin());
+    }
 
-    // find the RCM ordering
-    std::pair<int, int> bw = find_RCM_from_edges( edges, p );
+    /*******************************************
+     * Move the local nodes whose control volumes
+     * only involve local nodes to the front,
+     * keeping the chosen ordering within each
+     * block.  An element that has an external
+     * node makes all of its nodes, edges and CV
+     * faces halo-dependent.
+     *******************************************/
+    std::vector<char> element_halo(elements(), 0);
+    std::vector<char> node_halo(nodes(), 0);
+    for(int i=0; i<elements(); i++){
+        for(int j=0; j<element_nodes_.size(i); j++)
+            if( element_nodes_(i, j)>=local_nodes() )
+                element_halo[i] = 1;
+        if( element_halo[i] )
+            for(int j=0; j<element_nodes_.size(i); j++)
+                node_halo[element_nodes_(i, j)] = 1;
+    }
+    std::stable_partition(p.begin(), p.begin()+local_nodes(), NodeIsIndependent(node_halo));
+    n_nodes_indep_ = 0;
+    for(int i=0; i<local_nodes(); i++)
+        if( !node_halo[i] )
+            ++n_nodes_indep_;
+
+    // remember where the local nodes came from, so that the node
+    // pattern can be matched up with the neighbouring domains
+    node_file_index_.assign(p.begin(), p.begin()+local_nodes());
+    if( !node_source_id_.empty() ){
+        std::vector<int> source_id(local_nodes());
+        for(int i=0; i<local_nodes(); i++)
+            source_id[i] = node_source_id_[p[i]];
+        node_source_id_.swap(source_id);
+    }
 
     /*******************************************
      * relabel the nodes and any references to
@@ -148,26 +1740,33 @@ void Mesh::reorder_nodes_edges(std::set<Edge> &edgeset, std::set<Face> &faceset)
     std::vector<int> q(nodes());
     for(int i=0; i<nodes(); i++)
         q[p[i]] = i;
-    for(int i=0; i<elements(); i++)
-        for(int j=0; j<elementvec[i].nodes(); j++)
-            elementvec[i].nodevec[j] = q[elementvec[i].nodevec[j]];
+    element_nodes_.renumber(q);
 
     /*******************************************
      * sort edges to reduce bandwidth
      *******************************************/
-    // make a list of the edge - index pairs
-    std::vector<std::pair<Edge,int> > edgesort;
-    std::set<Edge>::const_iterator edge_it = edgeset.begin();
-    for( int i=0; edge_it!=edgeset.end(); ++i, ++edge_it)
-        edgesort.push_back(std::make_pair(*edge_it,edge_it->id()));
+    // an edge is halo-dependent if any element that it belongs to is
+    std::vector<char> edge_halo(edges(), 0);
+    for(int i=0; i<elements(); i++)
+        if( element_halo[i] )
+            for(int j=0; j<element_edges_.size(i); j++)
+                edge_halo[element_edges_(i, j)] = 1;
+
+    // make a list of the (halo flag, edge) - index pairs
+    std::vector<std::pair<std::pair<char,Edge>,int> > edgesort;
+    edgesort.reserve(edgevec.size());
+    for( int i=0; i<edgevec.size(); ++i)
+        edgesort.push_back(std::make_pair(std::make_pair(edge_halo[i],edgevec[i]),i));
 
     // update the edge information
     for( int i=0; i<edgesort.size(); ++i){
-        edgesort[i].first.front_id = q[edgesort[i].first.front_id];
-        edgesort[i].first.back_id  = q[edgesort[i].first.back_id];
+        Edge& e = edgesort[i].first.second;
+        e.front_id = q[e.front_id];
+        e.back_id  = q[e.back_id];
     }
-    // sort the edges by node id
+    // sort the edges by node id, with the halo-independent edges first
     std::sort(edgesort.begin(), edgesort.end());
+    n_edges_indep_ = edges() - std::count(edge_halo.begin(), edge_halo.end(), 1);
 
     // find the inverse permutation for the edges
     std::vector<int> qedges(edgesort.size());
@@ -176,36 +1775,26 @@ void Mesh::reorder_nodes_edges(std::set<Edge> &edgeset, std::set<Face> &faceset)
 
     // update the edge information
     for( int i=0; i<edgesort.size(); ++i)
-        edgesort[i].first.my_id = i;
+        edgesort[i].first.second.my_id = i;
 
     // update the element edge references
-    for(int i=0; i<elements(); i++)
-        for(int j=0; j<elementvec[i].edges(); j++){
-            elementvec[i].edgevec[j] = qedges[elementvec[i].edgevec[j]];
-        }
+    element_edges_.renumber(qedges);
 
     // store the sorted edges in edgevec
-    edgevec.resize(edgeset.size());
     for( int i=0; i<edgesort.size(); i++)
-        edgevec[i] = edgesort[i].first;
+        edgevec[i] = edgesort[i].first.second;
 
-    // copy over faces in id order
-    facevec.resize(faceset.size());
-    for (std::set<Face>::const_iterator it = faceset.begin(); it != faceset.end(); ++it) {
-        facevec[it->id()] = *it;
-        if (it->boundary() == 0)
+    // count the interior and boundary faces (which are already in id order)
+    for (int i = 0; i < facevec.size(); ++i) {
+        if (facevec[i].boundary() == 0)
             ++n_faces_int;
         else
             ++n_faces_bnd;
     }
 
     // update the node and edge references for each face
-    for(int i=0; i<facevec.size(); i++){
-        for(int j=0; j<facevec[i].nodevec.size(); j++)
-            facevec[i].nodevec[j] = q[facevec[i].nodevec[j]];
-        for(int j=0; j<facevec[i].edgevec.size(); j++)
-            facevec[i].edgevec[j] = qedges[facevec[i].edgevec[j]];
-    }
+    face_nodes_.renumber(q);
+    face_edges_.renumber(qedges);
 }
 
 void Mesh::read_header_data(std::ifstream& infile,
@@ -276,51 +1865,20 @@ void Mesh::read_nodes(std::ifstream& infile, int n_nodes) {
 
 void Mesh::read_elements(
     std::ifstream& infile, int n_elements,
-    std::set<Edge>& edgeset, std::set<Face>& faceset)
+    EntityTable& edgetable, EntityTable& facetable)
 {
     elementvec.reserve(n_elements);
     mesh_dim_ = 3;
     for (int element_id = 0; element_id < n_elements; ++element_id) {
 
-        // read number of nodes, edges, faces
-        int n_nodes, n_edges, n_faces, physical_tag, type;
+        // read number of nodes, faces
+        int n_nodes, n_faces, physical_tag, type;
         infile >> type >> physical_tag;
         physical_tag -= 100;
-        switch( type ) {
-            case 2: // triangle
-                n_nodes = 3;
-                n_edges = 3;
-                n_faces = 3;
-                mesh_dim_ = 2;
-                break;
-            case 3: // quadrilateral
-                n_nodes = 4;
-                n_edges = 4;
-                n_faces = 4;
-                mesh_dim_ = 2;
-                break;
-            case 4: // tetrahedron
-                n_nodes = 4;
-                n_edges = 6;
-                n_faces = 4;
-                break;
-            case 5: // hexahedron
-                n_nodes = 8;
-                n_edges = 12;
-                n_faces = 6;
-                break;
-            case 6: // prism
-                n_nodes = 6;
-                n_edges = 9;
-                n_faces = 5;
-                break;
-            default :
-                std::cout << "element type " << type << std::endl;
-                throw IOException("ERROR : invalid element type in .pmesh file");
-        }
 
         if (!infile)
             throw IOException("Couldn't read elements");
+        element_shape(type, n_nodes, n_faces);
 
         // read element's node ids
         std::vector<int> node_ids;
@@ -339,68 +1897,121 @@ void Mesh::read_elements(
         for (int i = 0; i < n_faces; ++i) {
             int id = 0;
             infile >> id;
-            boundary_tags.insert(id);
             boundary_ids.push_back(id);
         }
         if (!infile)
             throw IOException("Couldn't read elements");
 
+        add_element(type, element_id, physical_tag, node_ids, boundary_ids,
+                    edgetable, facetable);
+    }
+}
 
-        // construct edges and faces
-        std::vector<int> edge_ids;
-        std::vector<int> face_ids;
-        construct_edges_and_faces(
-            //n_faces,
-            type,
-            node_ids, boundary_ids,
-            edge_ids, face_ids,
-            edgeset, faceset
-        );
-
-        // construct element
-        elementvec.push_back(
-            //Element(*this, element_id, node_ids, edge_ids, face_ids)
-            //Element(*this, element_id, node_ids, edge_ids, face_ids, physical_tag)
-            Element(*this, type, element_id, node_ids, edge_ids, face_ids, physical_tag)
-        );
+// Returns the number of nodes and faces for an element type, and updates
+// the mesh dimension if the element is two dimensional.
+void Mesh::element_shape(int type, int& n_nodes, int& n_faces) {
+    switch( type ) {
+        case 2: // triangle
+            n_nodes = 3;
+            n_faces = 3;
+            mesh_dim_ = 2;
+            break;
+        case 3: // quadrilateral
+            n_nodes = 4;
+            n_faces = 4;
+            mesh_dim_ = 2;
+            break;
+        case 4: // tetrahedron
+            n_nodes = 4;
+            n_faces = 4;
+            break;
+        case 5: // hexahedron
+            n_nodes = 8;
+            n_faces = 6;
+            break;
+        case 6: // prism
+            n_nodes = 6;
+            n_faces = 5;
+            break;
+        default :
+            std::cout << "element type " << type << std::endl;
+            throw IOException("ERROR : invalid element type in .pmesh file");
     }
 }
 
+// Constructs the edges and faces of an element, then adds the element itself.
+void Mesh::add_element(
+    int type, int element_id, int physical_tag,
+    const std::vector<int>& node_ids, const std::vector<int>& boundary_ids,
+    EntityTable& edgetable, EntityTable& facetable)
+{
+    boundary_tags.insert(boundary_ids.begin(), boundary_ids.end());
+
+    // construct edges and faces
+    std::vector<int> edge_ids;
+    std::vector<int> face_ids;
+    construct_edges_and_faces(
+        //n_faces,
+        type,
+        node_ids, boundary_ids,
+        edge_ids, face_ids,
+        edgetable, facetable
+    );
+
+    // record the element's connectivity
+    for (int i = 0; i < int(node_ids.size()); ++i)
+        element_nodes_.append(node_ids[i]);
+    element_nodes_.finish_row();
+    for (int i = 0; i < int(edge_ids.size()); ++i)
+        element_edges_.append(edge_ids[i]);
+    element_edges_.finish_row();
+    for (int i = 0; i < int(face_ids.size()); ++i)
+        element_faces_.append(face_ids[i]);
+    element_faces_.finish_row();
+
+    // construct element
+    elementvec.push_back(
+        //Element(*this, element_id, node_ids, edge_ids, face_ids)
+        //Element(*this, element_id, node_ids, edge_ids, face_ids, physical_tag)
+        Element(*this, type, element_id, physical_tag)
+    );
+}
+
 void Mesh::construct_edges_and_faces(
     //int n_faces,
     int type,
     const std::vector<int>& node_ids, const std::vector<int>& boundary_ids,
     std::vector<int>& edge_ids, std::vector<int>& face_ids,
-    std::set<Edge>& edgeset, std::set<Face>& faceset)
+    EntityTable& edgetable, EntityTable& facetable)
 
     // Computes edges and faces for an element.
     // The edges and faces are compared to those already computed for previous
-    // elements, and if they're duplicates they aren't added to the set (rather,
+    // elements, and if they're duplicates they aren't added to the mesh (rather,
     // the id of the existing, equivalent edge/face is used instead).
 {
     switch(type) {
 
     case 2: // triangle
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[0], node_ids[1]) ));
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[1], node_ids[2]) ));
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[2], node_ids[0]) ));
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[0], node_ids[0], node_ids[1], edge_ids[0] )) );
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[1], node_ids[1], node_ids[2], edge_ids[1] )) );
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[2], node_ids[2], node_ids[0], edge_ids[2] )) );
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[1]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[2]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[0]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[0], node_ids[0], node_ids[1], edge_ids[0]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[1], node_ids[1], node_ids[2], edge_ids[1]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[2], node_ids[2], node_ids[0], edge_ids[2]));
         break;
 
     case 3: // quadrilateral
         //   id:  0   1   2   3
         // -----------------------------
         // edge: 0-1 1-2 2-3 3-0
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[0], node_ids[1]) ));
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[1], node_ids[2]) ));
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[2], node_ids[3]) ));
-        edge_ids.push_back(insert_edge( edgeset, Edge(*this, edgeset.size(), node_ids[3], node_ids[0]) ));
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[0], node_ids[0], node_ids[1], edge_ids[0] )) );
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[1], node_ids[1], node_ids[2], edge_ids[1] )) );
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[2], node_ids[2], node_ids[3], edge_ids[2] )) );
-        face_ids.push_back(insert_face( faceset, Face::line( *this, faceset.size(), boundary_ids[3], node_ids[3], node_ids[0], edge_ids[3] )) );
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[1]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[2]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[3], node_ids[0]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[0], node_ids[0], node_ids[1], edge_ids[0]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[1], node_ids[1], node_ids[2], edge_ids[1]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[2], node_ids[2], node_ids[3], edge_ids[2]));
+        face_ids.push_back(insert_line_face(facetable, boundary_ids[3], node_ids[3], node_ids[0], edge_ids[3]));
         break;
 
     case 4: // tetrahedron
@@ -409,72 +2020,37 @@ void Mesh::construct_edges_and_faces(
         // -----------------------------
         // edge: 0-1 1-2 2-0 0-3 1-3 2-3
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[1])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[2])
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[1]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[2]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[0]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[3]));
+
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[0],
+            node_ids[0], node_ids[1], node_ids[2],
+            edge_ids[0], edge_ids[1], edge_ids[2]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[0])
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[1],
+            node_ids[0], node_ids[1], node_ids[3],
+            edge_ids[0], edge_ids[4], edge_ids[3]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[3])
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[2],
+            node_ids[0], node_ids[2], node_ids[3],
+            edge_ids[2], edge_ids[5], edge_ids[3]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[3])
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[3],
+            node_ids[1], node_ids[2], node_ids[3],
+            edge_ids[1], edge_ids[5], edge_ids[4]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[3])
-        ));
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[0],
-                node_ids[0], node_ids[1], node_ids[2],
-                edge_ids[0], edge_ids[1], edge_ids[2]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[1],
-                node_ids[0], node_ids[1], node_ids[3],
-                edge_ids[0], edge_ids[4], edge_ids[3]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[2],
-                node_ids[0], node_ids[2], node_ids[3],
-                edge_ids[2], edge_ids[5], edge_ids[3]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[3],
-                node_ids[1], node_ids[2], node_ids[3],
-                edge_ids[1], edge_ids[5], edge_ids[4]
-            ))
-        );
-
         break;
 
         case 6: // triangular prism
@@ -483,96 +2059,46 @@ void Mesh::construct_edges_and_faces(
         // -----------------------------------------
         // edge: 0-1 1-2 2-0 3-4 4-5 5-3 0-3 1-4 2-5
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[1])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[2])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[0])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[3], node_ids[4])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[4], node_ids[5])
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[1]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[2]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[0]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[3], node_ids[4]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[4], node_ids[5]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[5], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[4]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[5]));
+
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[0],
+            node_ids[0], node_ids[1], node_ids[2],
+            edge_ids[0], edge_ids[1], edge_ids[2]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[5], node_ids[3])
+        face_ids.push_back(insert_triangular_face(
+            facetable, boundary_ids[1],
+            node_ids[3], node_ids[4], node_ids[5],
+            edge_ids[3], edge_ids[4], edge_ids[5]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[3])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[2],
+            node_ids[0], node_ids[1], node_ids[4], node_ids[3],
+            edge_ids[0], edge_ids[7], edge_ids[3], edge_ids[6]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[4])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[3],
+            node_ids[1], node_ids[2], node_ids[5], node_ids[4],
+            edge_ids[1], edge_ids[8], edge_ids[4], edge_ids[7]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[5])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[4],
+            node_ids[2], node_ids[0], node_ids[3], node_ids[5],
+            edge_ids[2], edge_ids[6], edge_ids[5], edge_ids[8]
         ));
 
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[0],
-                node_ids[0], node_ids[1], node_ids[2],
-                edge_ids[0], edge_ids[1], edge_ids[2]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::triangular(
-                *this, faceset.size(), boundary_ids[1],
-                node_ids[3], node_ids[4], node_ids[5],
-                edge_ids[3], edge_ids[4], edge_ids[5]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[2],
-                node_ids[0], node_ids[1], node_ids[4], node_ids[3],
-                edge_ids[0], edge_ids[7], edge_ids[3], edge_ids[6]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[3],
-                node_ids[1], node_ids[2], node_ids[5], node_ids[4],
-                edge_ids[1], edge_ids[8], edge_ids[4], edge_ids[7]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[4],
-                node_ids[2], node_ids[0], node_ids[3], node_ids[5],
-                edge_ids[2], edge_ids[6], edge_ids[5], edge_ids[8]
-            ))
-        );
-
         break;
 
         case 5: // hexahedron
@@ -581,120 +2107,55 @@ void Mesh::construct_edges_and_faces(
         // -----------------------------------------------------
         // edge: 0-1 1-2 2-3 3-0 4-5 5-6 6-7 7-4 0-4 1-5 2-6 3-7
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[1])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[2])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[3])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[3], node_ids[0])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[4], node_ids[5])
-        ));
-
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[5], node_ids[6])
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[1]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[2]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[3]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[3], node_ids[0]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[4], node_ids[5]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[5], node_ids[6]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[6], node_ids[7]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[7], node_ids[4]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[0], node_ids[4]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[1], node_ids[5]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[2], node_ids[6]));
+        edge_ids.push_back(insert_edge(edgetable, node_ids[3], node_ids[7]));
+
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[0],
+            node_ids[1], node_ids[0], node_ids[3], node_ids[2],
+            edge_ids[0], edge_ids[3], edge_ids[2], edge_ids[1]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[6], node_ids[7])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[1],
+            node_ids[4], node_ids[5], node_ids[6], node_ids[7],
+            edge_ids[4], edge_ids[5], edge_ids[6], edge_ids[7]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[7], node_ids[4])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[2],
+            node_ids[0], node_ids[1], node_ids[5], node_ids[4],
+            edge_ids[0], edge_ids[9], edge_ids[4], edge_ids[8]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[0], node_ids[4])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[3],
+            node_ids[1], node_ids[2], node_ids[6], node_ids[5],
+            edge_ids[1], edge_ids[10],edge_ids[5], edge_ids[9]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[1], node_ids[5])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[4],
+            node_ids[2], node_ids[3], node_ids[7], node_ids[6],
+            edge_ids[2], edge_ids[11],edge_ids[6], edge_ids[10]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[2], node_ids[6])
+        face_ids.push_back(insert_rectangular_face(
+            facetable, boundary_ids[5],
+            node_ids[3], node_ids[0], node_ids[4], node_ids[7],
+            edge_ids[3], edge_ids[8], edge_ids[7], edge_ids[11]
         ));
 
-        edge_ids.push_back(insert_edge(
-            edgeset,
-            Edge(*this, edgeset.size(), node_ids[3], node_ids[7])
-        ));
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[0],
-                node_ids[1], node_ids[0], node_ids[3], node_ids[2],
-                edge_ids[0], edge_ids[3], edge_ids[2], edge_ids[1]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[1],
-                node_ids[4], node_ids[5], node_ids[6], node_ids[7],
-                edge_ids[4], edge_ids[5], edge_ids[6], edge_ids[7]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[2],
-                node_ids[0], node_ids[1], node_ids[5], node_ids[4],
-                edge_ids[0], edge_ids[9], edge_ids[4], edge_ids[8]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[3],
-                node_ids[1], node_ids[2], node_ids[6], node_ids[5],
-                edge_ids[1], edge_ids[10],edge_ids[5], edge_ids[9]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[4],
-                node_ids[2], node_ids[3], node_ids[7], node_ids[6],
-                edge_ids[2], edge_ids[11],edge_ids[6], edge_ids[10]
-            ))
-        );
-
-        face_ids.push_back(insert_face(
-            faceset,
-            Face::rectangular(
-                *this, faceset.size(), boundary_ids[5],
-                node_ids[3], node_ids[0], node_ids[4], node_ids[7],
-                edge_ids[3], edge_ids[8], edge_ids[7], edge_ids[11]
-            ))
-        );
-
         break;
 
     default:
@@ -702,55 +2163,36 @@ void Mesh::construct_edges_and_faces(
     }
 }
 
-void Mesh::populate_edges_and_faces(
-    const std::set<Edge>& edgeset, const std::set<Face>& faceset)
-{
-    // copy over edges in id order
-    edgevec.resize(edgeset.size());
-    for (std::set<Edge>::const_iterator it = edgeset.begin(); it != edgeset.end(); ++it) {
-        edgevec[it->id()] = *it;
-    }
-
-    // copy over faces in id order
-    facevec.resize(faceset.size());
-    for (std::set<Face>::const_iterator it = faceset.begin();
-         it != faceset.end(); ++it) {
-        facevec[it->id()] = *it;
-        if (it->boundary() == 0)
-            ++n_faces_int;
-        else
-            ++n_faces_bnd;
-    }
-}
-
 void Mesh::set_element_neighbours() {
 
-    std::multimap<int,int> elements_with_same_face;
-
     // record which elements share each face
+    std::vector<int> face_ids, element_ids;
+    face_ids.reserve(element_faces_.entries());
+    element_ids.reserve(element_faces_.entries());
     for (int element_id = 0; element_id < elements(); ++element_id) {
         const Element& e = element(element_id);
         for (int i = 0; i < e.faces(); ++i) {
-            const Face& f = e.face(i);
-            elements_with_same_face.insert(std::make_pair(f.id(), e.id()));
+            face_ids.push_back(e.face_id(i));
+            element_ids.push_back(e.id());
         }
     }
-
-    // update the elements to record their neighbours
-    typedef std::multimap<int,int>::const_iterator iterator;
-    iterator it = elements_with_same_face.begin();
-    iterator end = elements_with_same_face.end();
-
-    while(it != end) {
-        iterator next_it = it; ++next_it;
-        if (next_it == end) break;
-        if (it->first == next_it->first) {
-            elementvec[it->second].add_neighbour(next_it->second);
-            elementvec[next_it->second].add_neighbour(it->second);
-            ++next_it;
+    Connectivity face_elements;
+    face_elements.assign(faces(), face_ids, element_ids);
+
+    // pair up the elements that share each face, in order of face id
+    std::vector<int> from, to;
+    for (int f = 0; f < faces(); ++f) {
+        IndexRange shared = face_elements.row(f);
+        for (int i = 0; i+1 < shared.size(); i += 2) {
+            from.push_back(shared[i]);
+            to.push_back(shared[i+1]);
+            from.push_back(shared[i+1]);
+            to.push_back(shared[i]);
         }
-        it = next_it;
     }
+
+    // update the elements to record their neighbours
+    element_neighbours_.assign(elements(), from, to);
 }
 
 void Mesh::face_edge_sanity_check() {
@@ -785,21 +2227,36 @@ void Mesh::boundary_tag_sanity_check() {
 
 void Mesh::construct_control_volumes() {
     initialise_volumes_and_faces();
+    std::vector<int> interior_offset, boundary_offset;
     if( dim()==3 ){
-        construct_scv_faces_internal_3D();
-        construct_scv_faces_boundary_3D();
+        construct_scv_faces_internal_3D(interior_offset);
+        construct_scv_faces_boundary_3D(boundary_offset);
     }
     else{
-        construct_scv_faces_internal_2D();
-        construct_scv_faces_boundary_2D();
+        construct_scv_faces_internal_2D(interior_offset);
+        construct_scv_faces_boundary_2D(boundary_offset);
     }
+    link_cvfaces(interior_offset, boundary_offset);
+    element_cvface_sanity_check();
+
     /**************************
      * reorganise the CV faces
      * to minimise bandwidth
      **************************/
     // sort the CV faces
-    // this sorts by edge id then element id
-    std::sort(cvfacevec.begin(), cvfacevec.begin()+interior_cvfaces());
+    // this sorts by edge id then element id, with the CV faces of elements
+    // that only involve local nodes first
+    std::vector<char> element_halo(elements(), 0);
+    for(int i=0; i<elements(); i++)
+        for(int j=0; j<element_nodes_.size(i); j++)
+            if( element_nodes_(i, j)>=local_nodes() )
+                element_halo[i] = 1;
+    std::sort(cvfacevec.begin(), cvfacevec.begin()+interior_cvfaces(),
+              CVFaceIsIndependentFirst(element_halo));
+    n_cvfaces_indep_ = 0;
+    while( n_cvfaces_indep_<interior_cvfaces()
+           && !element_halo[cvfacevec[n_cvfaces_indep_].element().id()] )
+        ++n_cvfaces_indep_;
     std::vector<int> q(cvfaces());
     for(int i=0; i<interior_cvfaces(); i++){
         q[cvfacevec[i].my_id] = i;
@@ -808,17 +2265,10 @@ void Mesh::construct_control_volumes() {
     for(int i=interior_cvfaces(); i<cvfaces(); i++)
         q[i] = i; // the boundary CV faces are not reordered
 
-    // update the SCV and element references to CV faces
-    for(int i=0; i<elements(); i++)
-        for(int j=0; j<elementvec[i].cvfacevec.size(); j++)
-            elementvec[i].cvfacevec[j] = q[elementvec[i].cvfacevec[j]];
-    for(int i=0; i<scvs(); i++)
-        for(int j=0; j<scvvec[i].cvfacevec.size(); j++)
-            scvvec[i].cvfacevec[j] = q[scvvec[i].cvfacevec[j]];
-
-    for(int i=0; i<edge_cvfaces.size(); i++)
-        for(int j=0; j<edge_cvfaces[i].size(); j++)
-            edge_cvfaces[i][j] = q[edge_cvfaces[i][j]];
+    // update the SCV, element and edge references to CV faces
+    element_cvfaces_.renumber(q);
+    scv_cvfaces_.renumber(q);
+    edge_cvfaces_.renumber(q);
 
     // finish of the CVs
     construct_volumes();
@@ -829,33 +2279,46 @@ void Mesh::initialise_volumes_and_faces() {
     for (int i = 0; i < nodes(); ++i) {
         volumevec.push_back(Volume(*this, i));
     }
-    // Create empty SCVs for each node of each element
-    // Record the ids in elements and volumes
+    // Create empty SCVs for each node of each element, numbered in the
+    // same order as the element nodes
+    scvvec.reserve(element_nodes_.entries());
     for (int i = 0; i < elements(); ++i) {
-        Element& e = elementvec[i]; // non-const
-        for (int j = 0; j < e.nodes(); ++j) {
-            e.add_scv(scvvec.size());
-            volumevec[e.node(j).id()].add_scv(scvvec.size());
-            scvvec.push_back(SCV(*this, scvvec.size(), i, e.node(j).id()));
-        }
+        const Element& e = elementvec[i];
+        for (int j = 0; j < e.nodes(); ++j)
+            scvvec.push_back(SCV(*this, scvvec.size(), i, e.node_id(j)));
     }
+    scv_vertices_.resize(scvs()*scv_vertex_count());
+
+    // Record the SCV ids in the volumes
+    std::vector<int> scv_ids(scvs());
+    for (int i = 0; i < scvs(); ++i)
+        scv_ids[i] = i;
+    volume_scvs_.assign(nodes(), element_nodes_.indices_, scv_ids);
 }
 
-void Mesh::construct_scv_faces_internal_3D() {
+void Mesh::construct_scv_faces_internal_3D(std::vector<int>& offset) {
 
     // Constructs non-boundary SCV faces, and also updates the volumes of
     // the corresponding SCVs.
-    edge_cvfaces.resize(edges());
+    //
+    // Each element only modifies its own SCVs, so the elements are processed
+    // in parallel.  The CV faces of element i are written to the range
+    // [offset[i], offset[i+1]) of cvfacevec, which is fixed up front so that
+    // the ids are the same as for a serial construction.
+    interior_cvface_offsets(offset);
 
     // for each element
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < elements(); ++i) {
-        Element& e = elementvec[i]; // non-const
+        const Element& e = elementvec[i];
+        bool has_vertices[8] = {false};
 
         // for each of its edges
         // (the CV face will use the edge midpoint as a vertex, and will be the
         // face separating the SCVS for the two nodes of the edge)
         for (int j = 0; j < e.edges(); ++j) {
             const Edge& edge = e.edge(j);
+            int id = offset[i] + j;
 
             // find the two element faces that share this edge
             // (the CV face will use both face centroids as vertices)
@@ -863,14 +2326,8 @@ void Mesh::construct_scv_faces_internal_3D() {
             const Face& face1 = e.face(facepair.first);
             const Face& face2 = e.face(facepair.second);
 
-            // add the CV face id to the element
-            e.add_cvface(cvfacevec.size());
-
-            // add the CV face id to the SCVs of both nodes
             int front_id = e.node_id(edge.front());
             int back_id = e.node_id(edge.back());
-            scvvec[e.scv(front_id).id()].add_cvface(cvfacevec.size());
-            scvvec[e.scv(back_id).id()].add_cvface(cvfacevec.size());
 
             // create the CV face quadrilateral
             CVFace_shape q(
@@ -908,59 +2365,58 @@ void Mesh::construct_scv_faces_internal_3D() {
             // of the two SCVs.  This was not part of the original
             // specification, and was only added as an afterthought.  Thus it is
             // not particularly elegant - but it works.
+            // The vertices are taken from the first edge of each SCV.
             const CVFace_shape& b1 = back_faces.first;
-            scvvec[e.scv(front_id).id()].set_vertices3D(
-                 q.point(0),  q.point(1),  q.point(2),  q.point(3),
-                b1.point(0), b1.point(1), b1.point(2), b1.point(3)
-            );
+            if (!has_vertices[front_id]) {
+                set_scv_vertices(e.scv(front_id).id(),
+                     q.point(0),  q.point(1),  q.point(2),  q.point(3),
+                    b1.point(0), b1.point(1), b1.point(2), b1.point(3)
+                );
+                has_vertices[front_id] = true;
+            }
             const CVFace_shape& b2 = back_faces.second;
-            scvvec[e.scv(back_id).id()].set_vertices3D(
-                 q.point(0),  q.point(1),  q.point(2),  q.point(3),
-                b2.point(0), b2.point(1), b2.point(2), b2.point(3)
-            );
+            if (!has_vertices[back_id]) {
+                set_scv_vertices(e.scv(back_id).id(),
+                     q.point(0),  q.point(1),  q.point(2),  q.point(3),
+                    b2.point(0), b2.point(1), b2.point(2), b2.point(3)
+                );
+                has_vertices[back_id] = true;
+            }
 
             // create the CV face itself
-            CVFace cvface(
-                *this, cvfacevec.size(), i,
+            cvfacevec[id] = CVFace(
+                *this, id, i,
                 edge.front().id(), edge.back().id(), 0, q, j, edge.id()
             );
 
-            // add CV face to mesh vector
-            cvfacevec.push_back(cvface);
-
-            // add the new cv face to the list of faces attached to the edge
-            edge_cvfaces[edge.id()].push_back(cvfacevec.size()-1);
-
-            ++n_cvfaces_int;
-
         } // end for each of its edges
 
     } // end for each element
+
+    n_cvfaces_int += offset[elements()] - offset[0];
 }
 
-void Mesh::construct_scv_faces_internal_2D() {
+void Mesh::construct_scv_faces_internal_2D(std::vector<int>& offset) {
 
     // Constructs non-boundary SCV faces, and also updates the volumes of
     // the corresponding SCVs.
-    edge_cvfaces.resize(edges());
+    // The elements are processed in parallel, as in the 3D case.
+    interior_cvface_offsets(offset);
 
     // for each element
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < elements(); ++i) {
-        Element& e = elementvec[i]; // non-const
+        const Element& e = elementvec[i];
+        bool has_vertices[4] = {false};
 
         // for each of its edges
         // (the CV face will use the edge midpoint and element centroid as vertices
         for (int j = 0; j < e.edges(); ++j) {
             const Edge& edge = e.edge(j);
+            int id = offset[i] + j;
 
-            // add the CV face id to the element
-            e.add_cvface(cvfacevec.size());
-
-            // add the CV face id to the SCVs of both nodes
             int front_id = e.node_id(edge.front());
             int back_id = e.node_id(edge.back());
-            scvvec[e.scv(front_id).id()].add_cvface(cvfacevec.size());
-            scvvec[e.scv(back_id).id()].add_cvface(cvfacevec.size());
 
             // create the CV face line (in 2D)
             CVFace_shape f( edge.midpoint(), e.centroid() );
@@ -989,29 +2445,96 @@ void Mesh::construct_scv_faces_internal_2D() {
             // of the two SCVs.  This was not part of the original
             // specification, and was only added as an afterthought.  Thus it is
             // not particularly elegant - but it works.
+            // The vertices are taken from the first edge of each SCV.
             const CVFace_shape& b1 = back_faces.first;
-            scvvec[e.scv(front_id).id()].set_vertices2D( e.centroid(), edge.midpoint(), b1.point(0), b1.point(1) );
+            if (!has_vertices[front_id]) {
+                set_scv_vertices( e.scv(front_id).id(), e.centroid(), edge.midpoint(), b1.point(0), b1.point(1) );
+                has_vertices[front_id] = true;
+            }
             const CVFace_shape& b2 = back_faces.second;
-            scvvec[e.scv(back_id).id()].set_vertices2D( e.centroid(),  edge.midpoint(), b2.point(0), b2.point(1) );
+            if (!has_vertices[back_id]) {
+                set_scv_vertices( e.scv(back_id).id(), e.centroid(),  edge.midpoint(), b2.point(0), b2.point(1) );
+                has_vertices[back_id] = true;
+            }
 
             // create the CV face itself
-            CVFace cvface( *this, cvfacevec.size(), i, edge.front().id(), edge.back().id(), 0, f, j, edge.id() );
+            cvfacevec[id] = CVFace( *this, id, i, edge.front().id(), edge.back().id(), 0, f, j, edge.id() );
+        } // end for each of its edges
 
-            // add CV face to mesh vector
-            cvfacevec.push_back(cvface);
+    } // end for each element
 
-            // add the new cv face to the list of faces attached to the edge
-            edge_cvfaces[edge.id()].push_back(cvfacevec.size()-1);
+    n_cvfaces_int += offset[elements()] - offset[0];
+}
 
-            ++n_cvfaces_int;
-        } // end for each of its edges
+// Computes the range [offset[i], offset[i+1]) of cvfacevec that will hold the
+// interior CV faces of element i (one for each edge), and resizes cvfacevec
+// to hold them.
+void Mesh::interior_cvface_offsets(std::vector<int>& offset) {
+    offset.assign(elements()+1, cvfaces());
+    for (int i = 0; i < elements(); ++i)
+        offset[i+1] = offset[i] + elementvec[i].edges();
+    cvfacevec.resize(offset[elements()]);
+}
 
-    } // end for each element
+// Records the CV faces of each element, SCV and edge.  The interior and
+// boundary CV faces of element i are those in the ranges
+// [interior[i], interior[i+1]) and [boundary[i], boundary[i+1]) of cvfacevec.
+// This is done serially after the CV faces have been constructed, so that
+// the CV faces of each are in order of id, with interior CV faces first.
+void Mesh::link_cvfaces(const std::vector<int>& interior,
+                        const std::vector<int>& boundary) {
+    std::vector<int> scv_ids, scv_cvface_ids, edge_ids, edge_cvface_ids;
+    scv_ids.reserve(2*cvfaces());
+    scv_cvface_ids.reserve(2*cvfaces());
+    edge_ids.reserve(interior_cvfaces());
+    edge_cvface_ids.reserve(interior_cvfaces());
+    for (int i = 0; i < elements(); ++i) {
+        const Element& e = elementvec[i];
+
+        // interior CV faces separate the SCVs of the nodes of an edge
+        for (int id = interior[i]; id < interior[i+1]; ++id) {
+            const CVFace& f = cvfacevec[id];
+            element_cvfaces_.append(id);
+            scv_ids.push_back(e.scv(e.node_id(f.front())).id());
+            scv_cvface_ids.push_back(id);
+            scv_ids.push_back(e.scv(e.node_id(f.back())).id());
+            scv_cvface_ids.push_back(id);
+            edge_ids.push_back(f.edge().id());
+            edge_cvface_ids.push_back(id);
+        }
+
+        // boundary CV faces belong to the SCV of their back node
+        for (int id = boundary[i]; id < boundary[i+1]; ++id) {
+            const CVFace& f = cvfacevec[id];
+            element_cvfaces_.append(id);
+            int scv_id = e.scv(e.node_id(f.back())).id();
+            scv_ids.push_back(scv_id);
+            scv_cvface_ids.push_back(id);
+            ++scvvec[scv_id].boundary_faces;
+        }
+        element_cvfaces_.finish_row();
+    }
+    scv_cvfaces_.assign(scvs(), scv_ids, scv_cvface_ids);
+    edge_cvfaces_.assign(edges(), edge_ids, edge_cvface_ids);
+}
+
+void Mesh::set_scv_vertices(int id, Point p1, Point p2, Point p3, Point p4) {
+    Point* v = &scv_vertices_[id*scv_vertex_count()];
+    v[0] = p1; v[1] = p2; v[2] = p3; v[3] = p4;
+}
+
+void Mesh::set_scv_vertices(int id, Point p1, Point p2, Point p3, Point p4,
+                            Point p5, Point p6, Point p7, Point p8) {
+    Point* v = &scv_vertices_[id*scv_vertex_count()];
+    v[0] = p1; v[1] = p2; v[2] = p3; v[3] = p4;
+    v[4] = p5; v[5] = p6; v[6] = p7; v[7] = p8;
 }
 
 void Mesh::construct_volumes() {
     // Compute the centroids of each SCV.  This was an afterthought.
+    // The SCVs and CVs are independent of one another, so are computed in parallel.
     if( dim()==3 ){
+        #pragma omp parallel for schedule(static)
         for (int i = 0; i < scvs(); ++i) {
             const SCV& s = scv(i);
             util::Quadrature3D I1(
@@ -1025,6 +2548,7 @@ void Mesh::construct_volumes() {
         }
     }
     else{
+        #pragma omp parallel for schedule(static)
         for (int i = 0; i < scvs(); ++i) {
             const SCV& s = scv(i);
 
@@ -1037,20 +2561,80 @@ void Mesh::construct_volumes() {
     }
 
     // Compute the volumes and centroids of each CV
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < nodes(); ++i) {
         volumevec[i].compute_volume();
         volumevec[i].compute_centroid();
     }
 }
 
-void Mesh::construct_scv_faces_boundary_2D() {
+// Copies the CV face and control volume geometry into the geometry tables.
+// These are not saved in snapshots, because they are cheap to recompute.
+void Mesh::construct_geometry_tables() {
+    int n = cvfaces();
+    cvface_area_.resize(n);
+    cvface_normal_x_.resize(n);
+    cvface_normal_y_.resize(n);
+    cvface_normal_z_.resize(n);
+    cvface_centroid_x_.resize(n);
+    cvface_centroid_y_.resize(n);
+    cvface_centroid_z_.resize(n);
+    cvface_front_id_.resize(n);
+    cvface_back_id_.resize(n);
+    cvface_element_id_.resize(n);
+    cvface_boundary_.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const CVFace& f = cvfacevec[i];
+        Point normal = f.normal();
+        Point centroid = f.centroid();
+        cvface_area_[i] = f.area();
+        cvface_normal_x_[i] = normal.x;
+        cvface_normal_y_[i] = normal.y;
+        cvface_normal_z_[i] = normal.z;
+        cvface_centroid_x_[i] = centroid.x;
+        cvface_centroid_y_[i] = centroid.y;
+        cvface_centroid_z_[i] = centroid.z;
+        cvface_front_id_[i] = f.front_id;
+        cvface_back_id_[i] = f.back_id;
+        cvface_element_id_[i] = f.element_id;
+        cvface_boundary_[i] = f.boundary_id;
+    }
+
+    volume_vol_.resize(nodes());
+    for (int i = 0; i < nodes(); ++i)
+        volume_vol_[i] = volumevec[i].vol();
+
+    construct_colourings();
+}
+
+// Colours the CV faces and edges so that the entities of a colour share no
+// node.  Like the geometry tables these are not saved in snapshots.
+void Mesh::construct_colourings() {
+    colour_by_nodes(cvface_front_id_, cvface_back_id_, nodes(), cvface_colours_);
+
+    std::vector<int> front(edges()), back(edges());
+    for (int i = 0; i < edges(); ++i) {
+        front[i] = edgevec[i].front_id;
+        back[i] = edgevec[i].back_id;
+    }
+    colour_by_nodes(front, back, nodes(), edge_colours_);
+}
+
+void Mesh::construct_scv_faces_boundary_2D(std::vector<int>& offset) {
     // Construct any boundary SCV faces
     // for 2D meshes
     assert( dim()==2 );
 
+    // The elements are processed in parallel, with the CV faces of each
+    // element written to a range of cvfacevec fixed up front.
+    boundary_cvface_offsets(offset);
+
     // for each element
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < elements(); ++i) {
-        Element& e = elementvec[i]; // non-const
+        const Element& e = elementvec[i];
+        int cvface_id = offset[i];
 
         // for each of its faces
         for (int j = 0; j < e.faces(); ++j) {
@@ -1074,34 +2658,31 @@ void Mesh::construct_scv_faces_boundary_2D() {
                     }
                     assert(dot(q.normal(), outwards) > 0.0);
 
-                    int id = e.node_id(n);
-
-                    CVFace cvface(  // note: no front face
-                        *this, cvfacevec.size(), i, -1, n.id(), f.boundary(), q, -1, -1
+                    // add the CV face to the mesh
+                    cvfacevec[cvface_id] = CVFace(  // note: no front face
+                        *this, cvface_id, i, -1, n.id(), f.boundary(), q, -1, -1
                     );
 
-                    // add the CV face id to the element
-                    e.add_cvface(cvfacevec.size());
-
-                    // add the CV face id to the SCV
-                    scvvec[e.scv(id).id()].add_boundary_cvface(cvfacevec.size());
-
-                    // add CV face to mesh vector
-                    cvfacevec.push_back(cvface);
-
-                    ++n_cvfaces_bnd;
+                    ++cvface_id;
                 }
             }
         }
     }
+    n_cvfaces_bnd += offset[elements()] - offset[0];
 }
 
-void Mesh::construct_scv_faces_boundary_3D() {
+void Mesh::construct_scv_faces_boundary_3D(std::vector<int>& offset) {
     // Construct any boundary SCV faces
 
+    // The elements are processed in parallel, with the CV faces of each
+    // element written to a range of cvfacevec fixed up front.
+    boundary_cvface_offsets(offset);
+
     // for each element
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < elements(); ++i) {
-        Element& e = elementvec[i]; // non-const
+        const Element& e = elementvec[i];
+        int cvface_id = offset[i];
 
         // for each of its faces
         for (int j = 0; j < e.faces(); ++j) {
@@ -1131,26 +2712,33 @@ void Mesh::construct_scv_faces_boundary_3D() {
                     }
                     assert(dot(q.normal(), outwards) > 0.0);
 
-                    int id = e.node_id(n);
-
-                    CVFace cvface(  // note: no front face
-                        *this, cvfacevec.size(), i, -1, n.id(), f.boundary(), q, -1, -1
+                    // add the CV face to the mesh
+                    cvfacevec[cvface_id] = CVFace(  // note: no front face
+                        *this, cvface_id, i, -1, n.id(), f.boundary(), q, -1, -1
                     );
 
-                    // add the CV face id to the element
-                    e.add_cvface(cvfacevec.size());
-
-                    // add the CV face id to the SCV
-                    scvvec[e.scv(id).id()].add_boundary_cvface(cvfacevec.size());
-
-                    // add CV face to mesh vector
-                    cvfacevec.push_back(cvface);
-
-                    ++n_cvfaces_bnd;
+                    ++cvface_id;
                 }
             }
         }
     }
+    n_cvfaces_bnd += offset[elements()] - offset[0];
+}
+
+// Computes the range [offset[i], offset[i+1]) of cvfacevec that will hold the
+// boundary CV faces of element i (one for each node of each boundary face),
+// and resizes cvfacevec to hold them.
+void Mesh::boundary_cvface_offsets(std::vector<int>& offset) {
+    offset.assign(elements()+1, cvfaces());
+    for (int i = 0; i < elements(); ++i) {
+        const Element& e = elementvec[i];
+        int n = 0;
+        for (int j = 0; j < e.faces(); ++j)
+            if (e.face(j).boundary())
+                n += e.face(j).nodes();
+        offset[i+1] = offset[i] + n;
+    }
+    cvfacevec.resize(offset[elements()]);
 }
 
 // generate the Pattern that describes the distribution of nodes
@@ -1241,28 +2829,131 @@ void Mesh::construct_node_pattern() {
     mpicomm_->Waitall(send_request, status);
     mpicomm_->Waitall(recv_request, status);
 
+    // The neighbours refer to nodes by their global id in the mesh files,
+    // which has to be mapped to the reordered local node.
+    std::vector<int> q(local_nodes());
+    for( int i=0; i<local_nodes(); i++ )
+        q[node_file_index_[i]] = i;
+    int startIndex = vtx_dist[mpicomm_->rank()];
     for( int i=0; i<neighbours.size(); i++ ){
         int n = neighbours[i];
-        int startIndex = vtx_dist[mpicomm_->rank()];
         for( int j=0; j<boundary_node_index[n].size(); j++)
-            boundary_node_index[n][j] -= startIndex;
+            boundary_node_index[n][j] = q[boundary_node_index[n][j] - startIndex];
+    }
+
+    // Local node i has global id vtxdist[rank]+i, so reordering the local
+    // nodes changes their global ids.  Send the new global ids back to the
+    // neighbours, which update their external node ids to match.
+    std::map<int,std::vector<int> > new_global_index;
+    for( int i=0; i<neighbours.size(); i++ ){
+        int n = neighbours[i];
+        new_global_index[n].resize(boundary_node_index[n].size());
+        for( int j=0; j<boundary_node_index[n].size(); j++)
+            new_global_index[n][j] = boundary_node_index[n][j] + startIndex;
+        send_request[i] = mpicomm_->Isend( new_global_index[n], n, 3 );
+        recv_request[i] = mpicomm_->Irecv( external_node_index_global[n], n, 3 );
+    }
+    mpicomm_->Waitall(send_request, status);
+    mpicomm_->Waitall(recv_request, status);
+    for( int i=0; i<neighbours.size(); i++ ){
+        int n = neighbours[i];
+        for( int j=0; j<external_node_index_local[n].size(); j++)
+            nodes_ext[external_node_index_local[n][j] - n_nodes_loc_] = external_node_index_global[n][j];
+    }
+
+    for( int i=0; i<neighbours.size(); i++ ){
+        int n = neighbours[i];
         node_pattern_.add_neighbour( n, boundary_node_index[n], external_node_index_local[n] );
     }
     mpicomm_->log_stream() << "Mesh::construct_node_pattern() FINISHED" << std::endl << "-----------------------------" << std::endl;
 }
 
-// Attempts to insert an edge into the domain set.  If an equivalent edge exists
+// The node pattern of a domain of a ThreadPartition is made from the halo of
+// the domain, without messages.  The halo numbers the local nodes and the
+// external nodes as the domain did before reorder_nodes_edges(), and sends
+// and receives the nodes of each neighbour in the same order on both sides,
+// as construct_node_pattern() does.  The new global ids of the external
+// nodes are taken from the partition once the neighbours have ordered their
+// nodes.
+void Mesh::construct_thread_node_pattern(ThreadPartition& partition) {
+    // the neighbours number their external nodes from ours, so this comes
+    // first, or they would wait forever if this domain failed the checks
+    partition.number_nodes(dom_id, node_source_id_);
+
+    const DomainHalo& halo = partition.halo(dom_id);
+    std::string mismatch = "Mesh: the thread partition does not match the halo of domain "
+                         + to_string(dom_id);
+    if (halo.local_nodes != local_nodes() || int(halo.nodes.size()) != nodes())
+        throw IOException(mismatch);
+    for (int k = 0; k < external_nodes(); ++k)
+        if (partition.global_ids()[halo.nodes[n_nodes_loc_+k]] != nodes_ext[k])
+            throw IOException(mismatch);
+
+    node_pattern_ = Pattern(mpicomm_);
+    std::vector<int> q(local_nodes());
+    for (int i = 0; i < local_nodes(); ++i)
+        q[node_file_index_[i]] = i;
+    for (int i = 0; i < int(halo.neighbours.size()); ++i) {
+        std::vector<int> send_index(halo.send[i].size());
+        for (int j = 0; j < int(send_index.size()); ++j)
+            send_index[j] = q[halo.send[i][j]];
+        std::vector<int> recv_index(halo.recv[i]);
+        node_pattern_.add_neighbour(halo.neighbours[i], send_index, recv_index);
+    }
+
+    for (int k = 0; k < external_nodes(); ++k)
+        nodes_ext[k] = partition.node_id(halo.nodes[n_nodes_loc_+k]);
+}
+
+// Attempts to insert an edge into the domain.  If an equivalent edge exists
 // then no insertion is made.  Either way, the id of the edge is returned.
-int Mesh::insert_edge(std::set<Edge>& edgeset, const Edge& edge) {
-    std::pair<std::set<Edge>::iterator, bool> pr = edgeset.insert(edge);
-    return pr.first->id();
+int Mesh::insert_edge(EntityTable& edgetable, int front, int back) {
+    int nodes[2] = {front, back};
+    std::pair<int, bool> pr = edgetable.insert(2, nodes);
+    if (pr.second)
+        edgevec.push_back(Edge(*this, pr.first, front, back));
+    return pr.first;
 }
 
-// Attempts to insert a face into the domain set.  If an equivalent face exists
+// Attempts to insert a face into the domain.  If an equivalent face exists
 // then no insertion is made.  Either way, the id of the face is returned.
-int Mesh::insert_face(std::set<Face>& faceset, const Face& face) {
-    std::pair<std::set<Face>::iterator, bool> pr = faceset.insert(face);
-    return pr.first->id();
+int Mesh::insert_face(EntityTable& facetable, int boundary, int n,
+                      const int* node_ids, const int* edge_ids) {
+    std::pair<int, bool> pr = facetable.insert(n, node_ids);
+    if (pr.second) {
+        for (int i = 0; i < n; ++i)
+            face_nodes_.append(node_ids[i]);
+        face_nodes_.finish_row();
+        // a line face has a single edge
+        for (int i = 0; i < (n == 2 ? 1 : n); ++i)
+            face_edges_.append(edge_ids[i]);
+        face_edges_.finish_row();
+        facevec.push_back(Face(*this, pr.first, boundary));
+    }
+    return pr.first;
+}
+
+int Mesh::insert_line_face(EntityTable& facetable, int boundary,
+                           int node0, int node1, int edge0) {
+    int nodes[2] = {node0, node1};
+    int edges[1] = {edge0};
+    return insert_face(facetable, boundary, 2, nodes, edges);
+}
+
+int Mesh::insert_triangular_face(EntityTable& facetable, int boundary,
+                                 int node0, int node1, int node2,
+                                 int edge0, int edge1, int edge2) {
+    int nodes[3] = {node0, node1, node2};
+    int edges[3] = {edge0, edge1, edge2};
+    return insert_face(facetable, boundary, 3, nodes, edges);
+}
+
+int Mesh::insert_rectangular_face(EntityTable& facetable, int boundary,
+                                  int node0, int node1, int node2, int node3,
+                                  int edge0, int edge1, int edge2, int edge3) {
+    int nodes[4] = {node0, node1, node2, node3};
+    int edges[4] = {edge0, edge1, edge2, edge3};
+    return insert_face(facetable, boundary, 4, nodes, edges);
 }
 
 // Returns the index of the edges that share a given node
@@ -1568,6 +3259,29 @@ std::string to_string(const T& t) {
     return oss.str();
 }
 
+// name of the file holding the part of the mesh for domain rank of size
+std::string domain_file_name(const std::string& meshname, int size, int rank,
+                             const std::string& extension) {
+    return meshname + "_" + to_string(size) + "_" + to_string(rank) + extension;
+}
+
+// true if filename exists
+bool file_exists(const std::string& filename) {
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0;
+}
+
+// true if filename exists and was modified no earlier than than, or than
+// does not exist
+bool file_is_newer(const std::string& filename, const std::string& than) {
+    struct stat st, st_than;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+    if (stat(than.c_str(), &st_than) != 0)
+        return true;
+    return st.st_mtime >= st_than.st_mtime;
+}
+
 std::pair<int, int> find_RCM_from_edges( const std::vector<std::pair<int, int> > &edges, std::vector<int> &p )
 {
     using namespace boost;
@@ -1614,4 +3328,122 @@ std::pair<int, int> find_RCM_from_edges( const std::vector<std::pair<int, int> >
     return std::make_pair(bw_init, bw_perm);
 }
 
+// Orders points along a Hilbert or Morton space filling curve through their
+// bounding box, so that points that are close in space are close in the
+// ordering.  On return p[i] is the index of the ith point along the curve.
+void find_SFC_from_points( const std::vector<Point> &points, int dim, bool hilbert, std::vector<int> &p )
+{
+    // number of bits per coordinate, so that the key fits in 63 bits
+    const int bits = 21;
+    const unsigned int top = 1u << bits;
+
+    int n = points.size();
+    p.resize(n);
+    if( n==0 )
+        return;
+
+    // bounding box of the points
+    Point lo = points[0];
+    Point hi = points[0];
+    for( int i=1; i<n; i++ ){
+        lo.x = std::min(lo.x, points[i].x);
+        lo.y = std::min(lo.y, points[i].y);
+        lo.z = std::min(lo.z, points[i].z);
+        hi.x = std::max(hi.x, points[i].x);
+        hi.y = std::max(hi.y, points[i].y);
+        hi.z = std::max(hi.z, points[i].z);
+    }
+    // use the same scale in every direction, so that the cells are cubes
+    double extent = std::max(hi.x-lo.x, std::max(hi.y-lo.y, hi.z-lo.z));
+    double scale = extent>0. ? (top-1)/extent : 0.;
+
+    std::vector<std::pair<unsigned long long, int> > keys(n);
+    for( int i=0; i<n; i++ ){
+        unsigned int X[3];
+        X[0] = static_cast<unsigned int>((points[i].x-lo.x)*scale);
+        X[1] = static_cast<unsigned int>((points[i].y-lo.y)*scale);
+        X[2] = static_cast<unsigned int>((points[i].z-lo.z)*scale);
+
+        if( hilbert ){
+            // convert the coordinates to the transpose of the Hilbert index
+            // (J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707, 2004)
+            for( unsigned int Q=top>>1; Q>1; Q>>=1 ){
+                unsigned int P = Q-1;
+                for( int d=0; d<dim; d++ ){
+                    if( X[d] & Q )
+                        X[0] ^= P;
+                    else{
+                        unsigned int t = (X[0]^X[d]) & P;
+                        X[0] ^= t;
+                        X[d] ^= t;
+                    }
+                }
+            }
+            for( int d=1; d<dim; d++ )
+                X[d] ^= X[d-1];
+            unsigned int t = 0;
+            for( unsigned int Q=top>>1; Q>1; Q>>=1 )
+                if( X[dim-1] & Q )
+                    t ^= Q-1;
+            for( int d=0; d<dim; d++ )
+                X[d] ^= t;
+        }
+
+        // interleave the bits, most significant first
+        unsigned long long key = 0;
+        for( int b=bits-1; b>=0; b-- )
+            for( int d=0; d<dim; d++ )
+                key = (key<<1) | ((X[d]>>b) & 1u);
+        keys[i] = std::make_pair(key, i);
+    }
+
+    // ties are broken by the original index
+    std::sort(keys.begin(), keys.end());
+    for( int i=0; i<n; i++ )
+        p[i] = keys[i].second;
+}
+
+// Greedy colouring of entities with two nodes front[i] and back[i] (front[i]
+// is -1 for boundary CV faces), so that no two entities of a colour share a
+// node.  Each entity takes the first colour that neither of its nodes has
+// yet, in order of id, so the ids of each colour are ascending and the
+// number of colours is at most one less than twice the largest number of
+// entities at a node.
+void colour_by_nodes(const std::vector<int>& front, const std::vector<int>& back,
+                     int nodes, Connectivity& colours) {
+    int n = front.size();
+    std::vector<std::vector<int> > used(nodes); // colours taken at each node
+    std::vector<int> colour(n);
+    std::vector<char> taken(1, 0); // one longer than the number of colours
+    const std::vector<int> none;
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        const std::vector<int>& b = used[back[i]];
+        const std::vector<int>& f = front[i] >= 0 ? used[front[i]] : none;
+        for (int k = 0; k < int(b.size()); ++k)
+            taken[b[k]] = 1;
+        for (int k = 0; k < int(f.size()); ++k)
+            taken[f[k]] = 1;
+        int c = 0;
+        while (taken[c])
+            ++c;
+        for (int k = 0; k < int(b.size()); ++k)
+            taken[b[k]] = 0;
+        for (int k = 0; k < int(f.size()); ++k)
+            taken[f[k]] = 0;
+
+        colour[i] = c;
+        if (c == count)
+            taken.resize(++count + 1, 0);
+        used[back[i]].push_back(c);
+        if (front[i] >= 0)
+            used[front[i]].push_back(c);
+    }
+
+    std::vector<int> ids(n);
+    for (int i = 0; i < n; ++i)
+        ids[i] = i;
+    colours.assign(count, colour, ids);
+}
+
 } // end namespace mesh
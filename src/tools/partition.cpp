@@ -0,0 +1,222 @@
+/****************************************************************
+ * partition
+ *
+ * Partitions the global mesh meshname.mesh (or meshname.msh) into
+ * domains by recursive coordinate or inertial bisection of the node
+ * coordinates, and writes the partition to meshname_<n>.perm in the
+ * format written by decomp.  It also writes the compiled global
+ * mesh meshname_<n>.bmesh that decomp writes, so that split makes
+ * the .pmesh files from the two without decomp or ParMETIS.  The
+ * edge cut, halo size and load imbalance of the partition are
+ * printed, e.g.
+ *
+ *   partition cassion 16                  (RCB)
+ *   partition -inertial cassion 16
+ *   partition -weights cassion.weights cassion 16
+ *   partition -check cassion 16           (quality of an existing
+ *                                          .perm, e.g. from decomp)
+ *
+ * A weights file holds one weight for each node of the global mesh,
+ * in node order, for example the measured cost of each node saved by
+ * Mesh::save_node_weights() at the end of a calibration run.
+ *
+ * usage : partition [-inertial] [-weights file] [-check] meshname domains
+ ***************************************************************/
+#include <fvm/impl/mesh/global_mesh.h>
+#include <fvm/impl/mesh/partition.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mesh;
+
+namespace {
+
+void print_quality(const std::string& name, const PartitionQuality& q) {
+    std::cout << std::setw(10) << name
+              << std::setw(12) << q.edge_cut
+              << std::setw(12) << q.halo
+              << std::setw(12) << q.max_halo
+              << std::setw(12) << std::setprecision(4) << q.imbalance << std::endl;
+}
+
+template<typename T>
+void write_values(std::FILE* f, const T* values, std::size_t n) {
+    if (n && std::fwrite(values, sizeof(T), n, f) != n)
+        throw IOException("Couldn't write compiled mesh file");
+}
+
+template<typename T>
+void write_values(std::FILE* f, const std::vector<T>& values) {
+    write_values(f, values.empty() ? 0 : &values[0], values.size());
+}
+
+// Writes the compiled global mesh in the format of mesh_compiled_save() in
+// decomp/fileio.c, which split reads: the coordinates, boundary tags and
+// elements of each node, the node adjacency (every node that shares an
+// element with a node, itself included, in ascending order), then the
+// elements, each tagged with its index.
+void write_compiled_mesh(const std::string& filename, const GlobalMesh& m) {
+    int n_nodes = m.nodes();
+    int n_elements = m.elements();
+
+    std::vector<int> node_elements_start(n_nodes + 1, 0);
+    for (int e = 0; e < n_elements; ++e) {
+        IndexRange nodes = m.element_nodes(e);
+        for (int j = 0; j < nodes.size(); ++j)
+            ++node_elements_start[nodes[j] + 1];
+    }
+    for (int i = 0; i < n_nodes; ++i)
+        node_elements_start[i+1] += node_elements_start[i];
+    std::vector<int> node_elements(node_elements_start[n_nodes]);
+    std::vector<int> next(node_elements_start.begin(), node_elements_start.end() - 1);
+    for (int e = 0; e < n_elements; ++e) {
+        IndexRange nodes = m.element_nodes(e);
+        for (int j = 0; j < nodes.size(); ++j)
+            node_elements[next[nodes[j]]++] = e;
+    }
+
+    std::vector<int> rindx(1, 0), cindx, neighbours;
+    for (int i = 0; i < n_nodes; ++i) {
+        neighbours.clear();
+        for (int k = node_elements_start[i]; k < node_elements_start[i+1]; ++k) {
+            IndexRange nodes = m.element_nodes(node_elements[k]);
+            neighbours.insert(neighbours.end(), nodes.begin(), nodes.end());
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        cindx.insert(cindx.end(), neighbours.begin(), neighbours.end());
+        rindx.push_back(cindx.size());
+    }
+
+    std::FILE* f = std::fopen(filename.c_str(), "wb");
+    if (!f)
+        throw IOException("Couldn't open file: " + filename);
+    try {
+        write_values(f, &n_nodes, 1);
+        write_values(f, &n_elements, 1);
+
+        std::vector<double> x(n_nodes);
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < n_nodes; ++i)
+                x[i] = c == 0 ? m.point(i).x : c == 1 ? m.point(i).y : m.point(i).z;
+            write_values(f, x);
+        }
+        std::vector<int> counts(n_nodes);
+        for (int i = 0; i < n_nodes; ++i)
+            counts[i] = m.node_boundaries(i).size();
+        write_values(f, counts);
+        for (int i = 0; i < n_nodes; ++i)
+            counts[i] = node_elements_start[i+1] - node_elements_start[i];
+        write_values(f, counts);
+        for (int i = 0; i < n_nodes; ++i)
+            write_values(f, m.node_boundaries(i).begin(), m.node_boundaries(i).size());
+        write_values(f, node_elements);
+
+        int nnz = cindx.size();
+        write_values(f, &nnz, 1);
+        write_values(f, rindx);
+        write_values(f, cindx);
+
+        for (int e = 0; e < n_elements; ++e) {
+            int header[3] = {m.element_type(e), m.element_tag(e), e};
+            write_values(f, header, 3);
+            write_values(f, m.element_nodes(e).begin(), m.element_nodes(e).size());
+            write_values(f, m.element_boundaries(e).begin(), m.element_boundaries(e).size());
+        }
+    } catch (...) {
+        std::fclose(f);
+        throw;
+    }
+    if (std::fclose(f) != 0)
+        throw IOException("Couldn't write file: " + filename);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    bool inertial = false, check = false;
+    std::string weightname;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "-inertial")
+            inertial = true;
+        else if (arg == "-check")
+            check = true;
+        else if (arg == "-weights" && i+1 < argc)
+            weightname = argv[++i];
+        else
+            args.push_back(arg);
+    }
+    if (args.size() != 2 || std::atoi(args[1].c_str()) < 1) {
+        std::cerr << "usage : " << argv[0]
+                  << " [-inertial] [-weights file] [-check] meshname domains" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(args[0]);
+    int domains = std::atoi(args[1].c_str());
+    std::ostringstream permname;
+    permname << meshname << "_" << domains << ".perm";
+
+    try {
+        // decomp numbers the nodes as in the .mesh file
+        std::string filename = meshname + ".mesh";
+        if (!std::ifstream(filename.c_str()))
+            filename = meshname + ".msh";
+        std::cout << "reading " << filename << std::endl;
+        GlobalMesh m(filename);
+        std::cout << "  " << m.nodes() << " nodes, " << m.elements() << " elements" << std::endl;
+
+        std::vector<double> weights;
+        if (!weightname.empty())
+            read_node_weights(weightname, m.nodes(), weights);
+
+        std::vector<int> part(m.nodes());
+        std::string method = "perm";
+        if (check) {
+            int parts;
+            read_partition(permname.str(), part, parts);
+            if (parts != domains)
+                throw IOException("Wrong number of domains in file: " + permname.str());
+        } else {
+            std::vector<Point> points(m.nodes());
+            for (int i = 0; i < m.nodes(); ++i)
+                points[i] = m.point(i);
+            std::clock_t start = std::clock();
+            rcb_partition(points, m.dim(), weights, domains, inertial, part);
+            double t = double(std::clock() - start) / CLOCKS_PER_SEC;
+            method = inertial ? "inertial" : "rcb";
+            std::cout << "partitioned into " << domains << " domains in "
+                      << std::setprecision(4) << t << " s" << std::endl;
+            write_partition(permname.str(), part, domains);
+            std::cout << "wrote " << permname.str() << std::endl;
+
+            std::ostringstream bmeshname;
+            bmeshname << meshname << "_" << domains << ".bmesh";
+            write_compiled_mesh(bmeshname.str(), m);
+            std::cout << "wrote " << bmeshname.str() << std::endl;
+        }
+
+        Connectivity graph;
+        node_graph(m, graph);
+        std::cout << std::setw(10) << "method"
+                  << std::setw(12) << "edge cut"
+                  << std::setw(12) << "halo"
+                  << std::setw(12) << "max halo"
+                  << std::setw(12) << "imbalance" << std::endl;
+        print_quality(method, partition_quality(graph, part, domains, weights));
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR : " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/****************************************************************
+ * pmesh2bpmesh
+ *
+ * Converts the per-domain text mesh files meshname_<n>_<i>.pmesh
+ * written by split into the binary format meshname_<n>_<i>.bpmesh,
+ * which mesh::Mesh memory maps in preference to the text files.
+ *
+ * usage : pmesh2bpmesh meshname domains
+ ***************************************************************/
+#include <fvm/impl/mesh/binary_mesh.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mesh;
+
+namespace {
+
+// number of nodes and faces for each element type
+void element_shape(int type, int& n_nodes, int& n_faces) {
+    switch( type ) {
+        case 2: // triangle
+            n_nodes = 3; n_faces = 3;
+            break;
+        case 3: // quadrilateral
+            n_nodes = 4; n_faces = 4;
+            break;
+        case 4: // tetrahedron
+            n_nodes = 4; n_faces = 4;
+            break;
+        case 5: // hexahedron
+            n_nodes = 8; n_faces = 6;
+            break;
+        case 6: // prism
+            n_nodes = 6; n_faces = 5;
+            break;
+        default :
+            std::ostringstream oss;
+            oss << "invalid element type " << type << " in .pmesh file";
+            throw IOException(oss.str());
+    }
+}
+
+void read_ints(std::ifstream& infile, int n, std::vector<int>& v,
+               const std::string& what) {
+    for (int i = 0; i < n; ++i) {
+        int val = 0;
+        infile >> val;
+        v.push_back(val);
+    }
+    if (!infile)
+        throw IOException("Couldn't read " + what);
+}
+
+void convert(const std::string& inname, const std::string& outname) {
+    std::ifstream infile(inname.c_str());
+    if (!infile)
+        throw IOException("Couldn't open file: " + inname);
+
+    BinaryMeshHeader h;
+
+    // header
+    infile >> h.n_dom >> h.dom_id;
+    if (!infile)
+        throw IOException("Couldn't read domain info in file");
+    std::vector<int> vtxdist;
+    read_ints(infile, h.n_dom+1, vtxdist, "vtxdist info");
+    infile >> h.n_nodes_gbl >> h.n_nodes_int >> h.n_nodes_bnd >> h.n_nodes_ext;
+    if (!infile)
+        throw IOException("Couldn't read node count info");
+    infile >> h.n_elements_int >> h.n_elements_bnd;
+    if (!infile)
+        throw IOException("Couldn't read element count info");
+
+    // external nodes
+    std::vector<int> external_nodes;
+    read_ints(infile, h.n_nodes_ext, external_nodes, "external node ids");
+
+    // nodes
+    std::vector<double> coordinates;
+    std::vector<int> node_boundary_offsets(1, 0);
+    std::vector<int> node_boundaries;
+    coordinates.reserve(3*h.nodes());
+    node_boundary_offsets.reserve(h.nodes()+1);
+    for (int i = 0; i < h.nodes(); ++i) {
+        double x, y, z;
+        int nbc;
+        infile >> x >> y >> z >> nbc;
+        if (!infile)
+            throw IOException("Couldn't read nodes");
+        coordinates.push_back(x);
+        coordinates.push_back(y);
+        coordinates.push_back(z);
+        read_ints(infile, nbc, node_boundaries, "nodes");
+        node_boundary_offsets.push_back(node_boundaries.size());
+    }
+
+    // elements
+    std::vector<int> element_offsets(1, 0);
+    std::vector<int> element_entries;
+    element_offsets.reserve(h.elements()+1);
+    for (int i = 0; i < h.elements(); ++i) {
+        int type, physical_tag, n_nodes, n_faces;
+        infile >> type >> physical_tag;
+        if (!infile)
+            throw IOException("Couldn't read elements");
+        element_shape(type, n_nodes, n_faces);
+        element_entries.push_back(type);
+        element_entries.push_back(physical_tag);
+        read_ints(infile, n_nodes + n_faces, element_entries, "elements");
+        element_offsets.push_back(element_entries.size());
+    }
+
+    write_binary_mesh(outname, h, coordinates, vtxdist, external_nodes,
+                      node_boundary_offsets, node_boundaries,
+                      element_offsets, element_entries);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage : " << argv[0] << " meshname domains" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string meshname(argv[1]);
+    int domains = std::atoi(argv[2]);
+
+    try {
+        for (int i = 0; i < domains; ++i) {
+            std::ostringstream base;
+            base << meshname << "_" << domains << "_" << i;
+            std::cout << "converting " << base.str() << ".pmesh" << std::endl;
+            convert(base.str() + ".pmesh", base.str() + ".bpmesh");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR : " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,10 @@
 #include <util/doublevector.h>
 #include <math.h>
 
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
 namespace util {
 
 DoubleVector& DoubleVector::operator=(double d) {
@@ -276,4 +280,42 @@ void DoubleVector::permute_add_weighted_inverse(const DoubleVector &v, const Int
     }
 }
 
+#ifdef VECTOR_DEBUG
+namespace {
+
+bool indices_are_distinct(const IntVector &p){
+    std::vector<int> sorted(p.begin(), p.end());
+    std::sort(sorted.begin(), sorted.end());
+    return std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+}
+
+} // end anonymous namespace
+#endif
+
+void DoubleVector::permute_add_weighted_inverse_distinct(const DoubleVector &v, const IntVector &p, const DoubleVector &w){
+    #ifdef VECTOR_DEBUG
+    if (!indices_are_distinct(p)) throw std::logic_error("DoubleVector::permute_add_weighted_inverse_distinct(v): p has a repeated index");
+    #endif
+    double* lhs = data();
+    const double* rhs = v.data();
+    difference_type sz = p.size();
+    #pragma omp parallel for schedule(static)
+    for (difference_type i = 0; i < sz; ++i) {
+        lhs[p[i]] += w[i]*rhs[i];
+    }
+}
+
+void DoubleVector::permute_add_weighted_pqr_distinct(const DoubleVector &v, const IntVector &lhs_p, const IntVector &rhs_p, const IntVector &w_p, const DoubleVector &w){
+    #ifdef VECTOR_DEBUG
+    if (!indices_are_distinct(lhs_p)) throw std::logic_error("DoubleVector::permute_add_weighted_pqr_distinct(v): lhs_p has a repeated index");
+    #endif
+    double* lhs = data();
+    const double* rhs = v.data();
+    difference_type sz = lhs_p.size();
+    #pragma omp parallel for schedule(static)
+    for (difference_type i = 0; i < sz; ++i) {
+        lhs[lhs_p[i]] += w[w_p[i]]*rhs[rhs_p[i]];
+    }
+}
+
 } // end namespace util